@@ -0,0 +1,31 @@
+// Measures JS-thread time spent per execAsync result, by result size. Calls are issued one at a
+// time so worker threads don't compete with the JS thread for CPU during the measurement.
+// Run with: node bench/async-result.bench.js
+const { performance } = require('perf_hooks');
+const nativeJq = require('bindings')('jq-node-bindings');
+
+const FILTER = 'def env: {}; {} as $ENV | .';
+const CONCURRENCY = 1;
+
+const record = (i) => ({ id: `entity-${i}`, title: `Entity ${i}`, count: i, tags: ['a', 'b'], meta: { created: '2024-01-01' } });
+
+const run = async (json, rounds) => {
+  const before = performance.eventLoopUtilization();
+  const start = process.hrtime.bigint();
+  for (let r = 0; r < rounds; r++) {
+    await Promise.all(Array.from({ length: CONCURRENCY }, () => nativeJq.execAsync(json, FILTER)));
+  }
+  const elu = performance.eventLoopUtilization(before);
+  return { activeUs: (elu.active * 1e3) / (rounds * CONCURRENCY), wallMs: Number(process.hrtime.bigint() - start) / 1e6 };
+};
+
+(async () => {
+  console.log('records   bytes      js-thread(us/result)  wall(ms)');
+  for (const n of [1, 10, 100, 1000, 10000]) {
+    const json = JSON.stringify(Array.from({ length: n }, (_, i) => record(i)));
+    const rounds = Math.max(1, Math.floor(4000 / n));
+    await run(json, 1);
+    const { activeUs, wallMs } = await run(json, rounds);
+    console.log(`${String(n).padStart(7)}  ${String(json.length).padStart(7)}  ${activeUs.toFixed(1).padStart(20)}  ${wallMs.toFixed(0).padStart(8)}`);
+  }
+})();
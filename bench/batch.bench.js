@@ -0,0 +1,39 @@
+// Compares running one filter over many inputs with Promise.all(inputs.map(execAsync)) and with
+// execBatchAsync / execBatch.
+// Run with: node bench/batch.bench.js
+const jq = require('../lib');
+
+const FILTER = '{id: .identifier, title: .title, tags: [.tags[] | ascii_upcase], total: (.values | add)}';
+
+const entity = (i) => ({
+  identifier: `entity-${i}`,
+  title: `Entity ${i}`,
+  tags: ['a', 'b', 'c'],
+  values: [i, i + 1, i + 2],
+});
+
+const timeAsync = async (fn, minMs = 500) => {
+  await fn();
+  let iterations = 0;
+  const start = process.hrtime.bigint();
+  let elapsed = 0;
+  while (elapsed < minMs * 1e6) {
+    await fn();
+    iterations++;
+    elapsed = Number(process.hrtime.bigint() - start);
+  }
+  return elapsed / iterations / 1e6;
+};
+
+(async () => {
+  console.log('inputs  Promise.all(execAsync)(ms)  execBatchAsync(ms)  execBatch(ms)  speedup(async)');
+  for (const n of [10, 100, 1000, 10000]) {
+    const inputs = Array.from({ length: n }, (_, i) => entity(i));
+    const each = await timeAsync(() => Promise.all(inputs.map((input) => jq.execAsync(input, FILTER))));
+    const batchAsync = await timeAsync(() => jq.execBatchAsync(inputs, FILTER));
+    const batch = await timeAsync(async () => jq.execBatch(inputs, FILTER));
+    console.log(
+      `${String(n).padStart(6)}  ${each.toFixed(2).padStart(26)}  ${batchAsync.toFixed(2).padStart(18)}  ${batch.toFixed(2).padStart(13)}  ${(each / batchAsync).toFixed(1).padStart(14)}`,
+    );
+  }
+})();
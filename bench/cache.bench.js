@@ -0,0 +1,57 @@
+// Filter cache lookups: every call in the first two cases is a cache hit on one of many cached filters.
+// The async case runs the calls concurrently on the thread pool (set UV_THREADPOOL_SIZE to vary the
+// thread count). The last case mixes filters that are slow to compile with one-off filters.
+// Run with: node bench/cache.bench.js
+const jq = require('../lib');
+
+const filters = Array.from({ length: 256 }, (_, i) => `.a + ${i}`);
+const input = Buffer.from('{"a":1}');
+const calls = 200000;
+
+const run = async (name, fn) => {
+  await fn(filters.length);
+  const start = process.hrtime.bigint();
+  await fn(calls);
+  const elapsed = Number(process.hrtime.bigint() - start);
+  console.log(`${name.padEnd(28)} ${(elapsed / calls).toFixed(0).padStart(8)} ns/call`);
+};
+
+(async () => {
+  await run('exec', (n) => {
+    for (let i = 0; i < n; i++) {
+      jq.exec(input, filters[i % filters.length]);
+    }
+  });
+  await run('execAsync, 64 in flight', async (n) => {
+    let next = 0;
+    const worker = async () => {
+      while (next < n) {
+        await jq.execAsync(input, filters[next++ % filters.length]);
+      }
+    };
+    await Promise.all(Array.from({ length: 64 }, worker));
+  });
+  const { hits, misses, evictions } = jq.getCacheStats();
+  console.log({ hits, misses, evictions });
+
+  // A few generated filters that are slow to compile, used all the time, between bursts of one-off
+  // filters that don't fit in the cache
+  jq.setCacheSize(64);
+  const generated = Array.from({ length: 8 }, (_, g) =>
+    `{${Array.from({ length: 300 }, (_, i) => `k${i}: (.a + ${g * 1000 + i} | tostring)`).join(', ')}}`);
+  const before = jq.getCacheStats().misses;
+  let generatedNs = 0;
+  let oneOffNs = 0;
+  for (let round = 0; round < 20; round++) {
+    let start = process.hrtime.bigint();
+    generated.forEach((filter) => jq.exec(input, filter));
+    generatedNs += Number(process.hrtime.bigint() - start);
+    start = process.hrtime.bigint();
+    for (let i = 0; i < 50; i++) {
+      jq.exec(input, `.a + ${round * 100 + i + 0.5}`);
+    }
+    oneOffNs += Number(process.hrtime.bigint() - start);
+  }
+  console.log(`generated + one-off mix: ${(generatedNs / 1e6).toFixed(0)} ms in generated filters, ` +
+    `${(oneOffNs / 1e6).toFixed(0)} ms in one-offs, ${jq.getCacheStats().misses - before} misses for ${20 * 58} calls`);
+})();
@@ -0,0 +1,42 @@
+// Measures fan-out: the same template filter over the same entity requested by many callers at once,
+// with identical calls in flight sharing one run (setAsyncCoalescing(true)) and each queueing its own (the
+// default). Then the same number of calls over distinct entities, where nothing can be shared and turning
+// coalescing on only adds the fingerprint of every input.
+// Run with: node bench/coalesce.bench.js [rounds] [callers]
+const jq = require('../lib');
+
+const ROUNDS = Number(process.argv[2] || 50);
+const CALLERS = Number(process.argv[3] || 32);
+const entity = (n) => ({
+  identifier: `svc-${n}`,
+  properties: { checks: Array.from({ length: 500 }, (_, i) => ({ id: i, passed: i % 3 !== 0, tags: [`t${i % 7}`] })) },
+});
+const json = Buffer.from(JSON.stringify(entity(0)));
+const distinct = Array.from({ length: CALLERS }, (_, n) => entity(n));
+const filter = '{id: .identifier, passed: [.properties.checks[] | select(.passed)] | length, tags: [.properties.checks[].tags[]] | unique}';
+
+const time = async (input) => {
+  await jq.execAsync(input(0), filter);
+  const start = process.hrtime.bigint();
+  for (let i = 0; i < ROUNDS; i++) {
+    await Promise.all(Array.from({ length: CALLERS }, (_, n) => jq.execAsync(input(n), filter)));
+  }
+  return Number(process.hrtime.bigint() - start) / 1e3 / ROUNDS;
+};
+
+const compare = async (input) => {
+  const separate = await time(input);
+  jq.setAsyncCoalescing(true);
+  const shared = await time(input);
+  jq.setAsyncCoalescing(false);
+  return [separate, shared];
+};
+
+(async () => {
+  const identical = await compare(() => json);
+  const different = await compare((n) => distinct[n]);
+  console.log(`${ROUNDS} rounds of ${CALLERS} calls, per round(us)`);
+  console.log('calls          default   coalescing');
+  console.log(`identical ${identical[0].toFixed(1).padStart(12)} ${identical[1].toFixed(1).padStart(12)}  (${(identical[0] / identical[1]).toFixed(1)}x)`);
+  console.log(`distinct  ${different[0].toFixed(1).padStart(12)} ${different[1].toFixed(1).padStart(12)}  (${(different[0] / different[1]).toFixed(2)}x)`);
+})();
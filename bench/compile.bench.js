@@ -0,0 +1,45 @@
+// Measures a cache miss: running a stream of unique generated filters, with filters that differ only in
+// literals sharing one compiled program (the default) and compiled one by one (setLiteralHoisting(false)).
+// Filters differing in field names can't share a program and cost a full compile either way.
+// Run with: node bench/compile.bench.js [filters]
+const jq = require('../lib');
+
+const COUNT = Number(process.argv[2] || 200);
+const input = { items: [{ id: 'id-1', tier: 1, name: 'one' }, { id: 'id-2', tier: 2, name: 'two' }] };
+const shapes = {
+  literals: (i) => `.items[] | select(.id == "id-${i}") | {name, tier: (.tier + ${i})}`,
+  fields: (i) => `.items[] | select(.id${i} == "id") | {name, tier: .tier}`,
+};
+
+let round = 0;
+const time = (shape) => {
+  // Filters no earlier round compiled
+  const first = ++round * COUNT;
+  const start = process.hrtime.bigint();
+  for (let i = first; i < first + COUNT; i++) {
+    jq.exec(input, shape(i));
+  }
+  return Number(process.hrtime.bigint() - start) / 1e3 / COUNT;
+};
+
+const cached = () => {
+  const filter = shapes.literals(0);
+  jq.exec(input, filter);
+  const start = process.hrtime.bigint();
+  for (let i = 0; i < COUNT; i++) {
+    jq.exec(input, filter);
+  }
+  return Number(process.hrtime.bigint() - start) / 1e3 / COUNT;
+};
+
+jq.setCacheSize(COUNT * 8);
+console.log(`${COUNT} unique filters per case`);
+console.log('filters        shared(us)  as written(us)  speedup');
+for (const [name, shape] of Object.entries(shapes)) {
+  const shared = time(shape);
+  jq.setLiteralHoisting(false);
+  const written = time(shape);
+  jq.setLiteralHoisting(true);
+  console.log(`${name.padEnd(12)} ${shared.toFixed(1).padStart(12)} ${written.toFixed(1).padStart(15)} ${(written / shared).toFixed(1).padStart(8)}x`);
+}
+console.log(`${'cached'.padEnd(12)} ${cached().toFixed(1).padStart(12)}`);
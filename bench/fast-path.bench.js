@@ -0,0 +1,43 @@
+// Compares simple path filters run by the native path walker with the same filters on the jq VM,
+// for exec on JS objects (only the picked value is converted) and for a template of paths.
+// Run with: node bench/fast-path.bench.js
+const jq = require('../lib');
+
+const entity = (fields) => ({
+  identifier: 'service-1',
+  title: 'Service',
+  properties: Object.fromEntries(Array.from({ length: fields }, (_, i) => [`field${i}`, { value: i, tags: ['a', 'b'] }])),
+  relations: { owner: ['team-a'] },
+});
+const template = {
+  id: '{{.identifier}}',
+  name: '{{.title // "untitled"}}',
+  first: '{{.properties.field0.value}}',
+  tag: '{{.properties.field1.tags[0]}}',
+  owner: '{{.relations.owner[0]}}',
+};
+
+const time = (rounds, fn) => {
+  fn();
+  const start = process.hrtime.bigint();
+  for (let i = 0; i < rounds; i++) {
+    fn();
+  }
+  return Number(process.hrtime.bigint() - start) / 1e3 / rounds;
+};
+
+const measure = (fn, rounds) => {
+  const fast = time(rounds, fn);
+  jq.setFastPath(false);
+  const vm = time(rounds, fn);
+  jq.setFastPath(true);
+  return `${fast.toFixed(1).padStart(10)} ${vm.toFixed(1).padStart(10)} ${(vm / fast).toFixed(1).padStart(8)}x`;
+};
+
+console.log('case                         fast(us)     vm(us)  speedup');
+for (const fields of [10, 1000]) {
+  const input = entity(fields);
+  const rounds = fields > 100 ? 500 : 20000;
+  console.log(`exec .properties.field0 ${String(fields).padStart(4)} ${measure(() => jq.exec(input, '.properties.field0.value'), rounds)}`);
+  console.log(`template            ${String(fields).padStart(8)} ${measure(() => jq.renderRecursively(input, template), rounds)}`);
+}
@@ -0,0 +1,42 @@
+// Compares handing execSync a JSON string (JSON.stringify + jv_parse) with walking the JS value natively.
+// Run with: node bench/input.bench.js
+const nativeJq = require('bindings')('jq-node-bindings');
+
+const FILTER = 'def env: {}; {} as $ENV | .id';
+
+const record = (i) => ({ id: `entity-${i}`, title: `Entity ${i}`, count: i, active: i % 2 === 0, tags: ['a', 'b'] });
+const shapes = {
+  flat: (n) => Object.fromEntries(Array.from({ length: n }, (_, i) => [`key${i}`, `value ${i}`])),
+  records: (n) => ({ id: 'root', items: Array.from({ length: Math.ceil(n / 8) }, (_, i) => record(i)) }),
+  numbers: (n) => ({ id: 'root', values: Array.from({ length: n }, (_, i) => i * 1.5) }),
+  deep: (n) => {
+    let node = { id: 'leaf' };
+    for (let i = 0; i < Math.min(n, 100); i++) node = { id: `level-${i}`, child: node, pad: 'x'.repeat(32) };
+    return node;
+  },
+};
+
+const time = (fn, minMs = 200) => {
+  let iterations = 0;
+  const start = process.hrtime.bigint();
+  let elapsed = 0;
+  while (elapsed < minMs * 1e6) {
+    fn();
+    iterations++;
+    elapsed = Number(process.hrtime.bigint() - start);
+  }
+  return elapsed / iterations / 1e3;
+};
+
+console.log('shape    nodes   bytes      stringify(us)  walk(us)  ratio');
+for (const [name, make] of Object.entries(shapes)) {
+  for (const n of [10, 100, 1000, 10000, 100000]) {
+    const input = make(n);
+    const bytes = JSON.stringify(input).length;
+    const stringify = time(() => nativeJq.execSync(JSON.stringify(input), FILTER));
+    const walk = time(() => nativeJq.execSync(input, FILTER, { valueInput: true, walkLimit: Infinity }));
+    console.log(
+      `${name.padEnd(8)} ${String(n).padStart(6)}  ${String(bytes).padStart(9)}  ${stringify.toFixed(1).padStart(13)}  ${walk.toFixed(1).padStart(8)}  ${(walk / stringify).toFixed(2)}`,
+    );
+  }
+}
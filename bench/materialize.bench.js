@@ -0,0 +1,38 @@
+// Measures the cost of turning jq results into JS values, by result shape. The input is converted
+// once into a document, so running '.' minus running 'null' on it is the materialization cost.
+// Run with: node bench/materialize.bench.js
+const jq = require('../lib');
+
+const record = (i) => Object.fromEntries(Array.from({ length: 15 }, (_, k) => [`field_${k}`, k % 3 ? `value ${i}-${k}` : i + k]));
+const shapes = {
+  'records 10k x 15': () => Array.from({ length: 10000 }, (_, i) => record(i)),
+  'wide object 10k keys': () => Object.fromEntries(Array.from({ length: 10000 }, (_, i) => [`key_${i}`, i])),
+  'numbers 100k': () => Array.from({ length: 100000 }, (_, i) => i * 1.5),
+  'strings 50k': () => Array.from({ length: 50000 }, (_, i) => `string number ${i}`),
+  'deep 100 x 1k': () => Array.from({ length: 1000 }, () => {
+    let node = { leaf: true };
+    for (let d = 0; d < 100; d++) node = { child: node };
+    return node;
+  }),
+};
+
+const time = (fn, minMs = 500) => {
+  fn();
+  let iterations = 0;
+  const start = process.hrtime.bigint();
+  let elapsed = 0;
+  while (elapsed < minMs * 1e6) {
+    fn();
+    iterations++;
+    elapsed = Number(process.hrtime.bigint() - start);
+  }
+  return elapsed / iterations / 1e6;
+};
+
+console.log('shape                   materialize(ms)');
+for (const [name, make] of Object.entries(shapes)) {
+  const doc = jq.document(make());
+  const full = time(() => doc.exec('.'));
+  const empty = time(() => doc.exec('null'));
+  console.log(`${name.padEnd(22)}  ${(full - empty).toFixed(2).padStart(15)}`);
+}
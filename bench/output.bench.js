@@ -0,0 +1,32 @@
+// Compares getting a result as a JS value and serializing it again with getting it as raw JSON.
+// Reports the wall time per call and the time spent on the JS thread (the worker runs the filter).
+// Run with: node bench/output.bench.js
+const { performance } = require('perf_hooks');
+const jq = require('../lib');
+
+const input = {
+  items: Array.from({ length: 20000 }, (_, i) => ({ id: `item-${i}`, rank: i * 1.5, tags: ['a', 'b'], ok: i % 2 === 0 })),
+};
+const runs = 20;
+
+const measure = async (name, run) => {
+  await run();
+  const loop = performance.eventLoopUtilization();
+  const start = process.hrtime.bigint();
+  for (let i = 0; i < runs; i++) {
+    await run();
+  }
+  const wall = Number(process.hrtime.bigint() - start) / 1e6 / runs;
+  const { active } = performance.eventLoopUtilization(loop);
+  console.log(`${name.padEnd(32)} ${wall.toFixed(2).padStart(9)} ${(active / runs).toFixed(2).padStart(12)}`);
+};
+
+(async () => {
+  const doc = jq.document(input);
+  console.log('case                              wall(ms)  js thread(ms)');
+  await measure('execAsync + JSON.stringify', async () => JSON.stringify(await jq.execAsync(input, '.items')));
+  await measure('execAsync output json', () => jq.execAsync(input, '.items', { output: 'json' }));
+  await measure('execAsync output buffer', () => jq.execAsync(input, '.items', { output: 'buffer' }));
+  await measure('doc.execAsync + JSON.stringify', async () => JSON.stringify(await doc.execAsync('.items')));
+  await measure('doc.execAsync output buffer', () => doc.execAsync('.items', { output: 'buffer' }));
+})();
@@ -0,0 +1,45 @@
+// Measures parsing JSON inputs with jq's parser, the vectorized one and the same without vector instructions
+// (setJsonParser), in MB/s of input for payloads heavy in objects, strings and floats. Counts the parse phase only.
+// Run with: node bench/parse.bench.js [megabytes]
+const jq = require('../lib');
+
+const MEGABYTES = Number(process.argv[2] || 8);
+const payloads = {
+  entities: (i) => ({ identifier: `svc-${i}`, title: `Service ${i}`, active: i % 2 === 0, team: null,
+    properties: { tier: i % 4, tags: ['a', 'b', 'c'], owner: { name: 'team', id: i } } }),
+  strings: (i) => ({ description: `${'Lorem ipsum dolor sit amet, consectetur adipiscing elit. '.repeat(8)}"${i}"\n\tend ✓` }),
+  floats: (i) => ({ point: [i * 0.1, -i / 7, 1e-7 * i, 123456.789], score: Math.PI * i }),
+};
+const build = (item) => {
+  const items = [];
+  let size = 0;
+  for (let i = 0; size < MEGABYTES * 1024 * 1024; i++) {
+    items.push(item(i));
+    size += JSON.stringify(items[i]).length + 1;
+  }
+  return Buffer.from(JSON.stringify(items));
+};
+
+// Parse time only, from the parse phase of getStats
+const parseUs = () => jq.getStats().latency.parse.totalUs;
+
+const rate = (json, parser) => {
+  jq.setJsonParser(parser);
+  jq.exec(json, 'length');
+  const rounds = 5;
+  const start = parseUs();
+  for (let i = 0; i < rounds; i++) {
+    jq.exec(json, 'length');
+  }
+  const seconds = (parseUs() - start) / 1e6;
+  return json.length * rounds / seconds / 1024 / 1024;
+};
+
+console.log(`payloads of ${MEGABYTES} MB, MB/s`);
+console.log('payload          jq     simd   scalar');
+for (const [name, item] of Object.entries(payloads)) {
+  const json = build(item);
+  const [base, simd, scalar] = ['jq', 'simd', 'scalar'].map((parser) => rate(json, parser));
+  console.log(`${name.padEnd(10)} ${base.toFixed(0).padStart(6)} ${simd.toFixed(0).padStart(8)} ${scalar.toFixed(0).padStart(8)}   (${(simd / base).toFixed(1)}x)`);
+}
+jq.setJsonParser('jq');
@@ -0,0 +1,43 @@
+// Compares filters and a template run on a large JS object converting only the fields they read with
+// the same calls converting the whole input (setInputProjection(false)).
+// Run with: node bench/projection.bench.js
+const jq = require('../lib');
+
+const entity = (fields) => ({
+  identifier: 'service-1',
+  title: 'Service',
+  properties: { title: 'Service one', tier: 2, ...Object.fromEntries(Array.from({ length: fields }, (_, i) => [`field${i}`, { value: i, tags: ['a', 'b'] }])) },
+  relations: { owner: ['team-a', 'team-b'] },
+});
+const FILTER = '{id: .identifier, title: .properties.title, critical: (.properties.tier < 3), owners: (.relations.owner | join(","))}';
+const template = {
+  id: '{{.identifier}}',
+  title: '{{.properties.title | ascii_upcase}}',
+  owners: '{{.relations.owner | length}}',
+};
+
+const time = (rounds, fn) => {
+  fn();
+  const start = process.hrtime.bigint();
+  for (let i = 0; i < rounds; i++) {
+    fn();
+  }
+  return Number(process.hrtime.bigint() - start) / 1e3 / rounds;
+};
+
+const measure = (fn, rounds) => {
+  const a = time(rounds, fn);
+  jq.setInputProjection(false);
+  const b = time(rounds, fn);
+  jq.setInputProjection(true);
+  return `${a.toFixed(1).padStart(12)} ${b.toFixed(1).padStart(10)} ${(b / a).toFixed(1).padStart(8)}x`;
+};
+
+console.log('case                 projected(us)   whole(us)  speedup');
+for (const fields of [10, 1000, 10000]) {
+  const input = entity(fields);
+  const rounds = fields > 1000 ? 50 : fields > 100 ? 500 : 20000;
+  const compiled = jq.compileTemplate(template);
+  console.log(`exec     ${String(fields).padStart(8)} ${measure(() => jq.exec(input, FILTER), rounds)}`);
+  console.log(`template ${String(fields).padStart(8)} ${measure(() => compiled.render(input), rounds)}`);
+}
@@ -0,0 +1,38 @@
+// Measures re-rendering a template for entities that did not change, with the result cache on and off.
+// Run with: node bench/result-cache.bench.js [iterations] [entities]
+const jq = require('../lib');
+
+const ITERATIONS = Number(process.argv[2] || 2000);
+const ENTITIES = Number(process.argv[3] || 50);
+const template = {
+  identifier: '{{.identifier}}',
+  title: '{{.properties.name | ascii_upcase}}',
+  team: '{{[.relations.owners[] | select(.active) | .team] | unique | join(",")}}',
+  score: '{{[.properties.checks[] | select(.passed)] | length}}',
+};
+const entities = Array.from({ length: ENTITIES }, (_, i) => ({
+  identifier: `svc-${i}`,
+  properties: { name: `service ${i}`, checks: Array.from({ length: 20 }, (_, j) => ({ id: j, passed: (i + j) % 3 !== 0 })) },
+  relations: { owners: Array.from({ length: 5 }, (_, j) => ({ team: `team-${(i + j) % 4}`, active: j % 2 === 0 })) },
+}));
+const compiled = jq.compileTemplate(template);
+
+const time = () => {
+  entities.forEach((entity) => compiled.render(entity));
+  const start = process.hrtime.bigint();
+  for (let i = 0; i < ITERATIONS; i++) {
+    compiled.render(entities[i % ENTITIES]);
+  }
+  return Number(process.hrtime.bigint() - start) / 1e3 / ITERATIONS;
+};
+
+const off = time();
+jq.setResultCache({ maxBytes: 16 * 1024 * 1024 });
+const on = time();
+const { hits, misses } = jq.getStats().resultCache;
+jq.setResultCache(null);
+
+console.log(`${ITERATIONS} renders of ${ENTITIES} entities`);
+console.log('cache   per render(us)');
+console.log(`off     ${off.toFixed(1).padStart(14)}`);
+console.log(`on      ${on.toFixed(1).padStart(14)}  (${(off / on).toFixed(1)}x, ${hits} hits, ${misses} misses)`);
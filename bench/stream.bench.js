@@ -0,0 +1,43 @@
+// Compares running a filter over an NDJSON file line by line (JSON.parse + execAsync per record)
+// with streamFile, which parses and filters on a worker thread.
+// Run with: node bench/stream.bench.js [records]
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+const readline = require('readline');
+const jq = require('../lib');
+
+const RECORDS = Number(process.argv[2] || 200000);
+const FILTER = 'select(.value % 2 == 0) | {id, title}';
+
+const file = path.join(os.tmpdir(), `jq-stream-bench-${process.pid}.ndjson`);
+const out = fs.openSync(file, 'w');
+for (let i = 0; i < RECORDS; i++) {
+  fs.writeSync(out, JSON.stringify({ id: `entity-${i}`, title: `Entity ${i}`, value: i, tags: ['a', 'b'], props: { x: i } }) + '\n');
+}
+fs.closeSync(out);
+const bytes = fs.statSync(file).size;
+
+const measure = async (name, fn) => {
+  const start = process.hrtime.bigint();
+  const count = await fn();
+  const ms = Number(process.hrtime.bigint() - start) / 1e6;
+  console.log(`${name.padEnd(24)} ${String(count).padStart(8)} outputs  ${ms.toFixed(0).padStart(6)}ms  ${(bytes / 1048576 / (ms / 1000)).toFixed(1)}MB/s`);
+};
+
+(async () => {
+  console.log(`${RECORDS} records, ${(bytes / 1048576).toFixed(1)}MB`);
+  await measure('readline + execAsync', async () => {
+    let count = 0;
+    for await (const line of readline.createInterface({ input: fs.createReadStream(file) })) {
+      if (line && (await jq.execAsync(JSON.parse(line), FILTER)) !== undefined) count++;
+    }
+    return count;
+  });
+  await measure('streamFile', async () => {
+    let count = 0;
+    for await (const batch of jq.streamFile(file, FILTER)) count += batch.length;
+    return count;
+  });
+  fs.unlinkSync(file);
+})();
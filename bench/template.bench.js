@@ -0,0 +1,76 @@
+// Compares rendering a template one expression at a time (one exec per expression) with renderRecursively
+// (all expressions in one native call) and a template compiled once with compileTemplate.
+// Run with: node bench/template.bench.js
+const jq = require('../lib');
+
+const entity = (n) => ({
+  identifier: 'entity-1',
+  title: 'Entity 1',
+  properties: Object.fromEntries(Array.from({ length: n }, (_, i) => [`prop${i}`, `value ${i}`])),
+  relations: { owner: 'team-a' },
+});
+const template = (n) => ({
+  identifier: '{{.identifier}}',
+  title: 'Title: {{.title}}',
+  properties: Object.fromEntries(Array.from({ length: n }, (_, i) => [`p${i}`, `{{.properties.prop${i}}}`])),
+  relations: { owner: '{{.relations.owner}}' },
+});
+
+// The per-expression rendering renderRecursively used before
+const renderEach = (input, node) => {
+  if (typeof node === 'string') {
+    return node.startsWith('{{') && node.endsWith('}}')
+      ? jq.exec(input, node.slice(2, -2))
+      : node.replace(/\{\{(.*?)\}\}/g, (_, filter) => {
+        const r = jq.exec(input, filter);
+        return typeof r === 'string' ? r : JSON.stringify(r);
+      });
+  }
+  if (typeof node === 'object' && node !== null) {
+    return Object.fromEntries(Object.entries(node).map(([k, v]) => [k, renderEach(input, v)]));
+  }
+  return node;
+};
+
+const time = (fn, minMs = 300) => {
+  fn(); // compile the filters outside of the measurement
+  let iterations = 0;
+  const start = process.hrtime.bigint();
+  let elapsed = 0;
+  while (elapsed < minMs * 1e6) {
+    fn();
+    iterations++;
+    elapsed = Number(process.hrtime.bigint() - start);
+  }
+  return elapsed / iterations / 1e3;
+};
+
+const timeAsync = async (fn, minMs = 300) => {
+  await fn();
+  let iterations = 0;
+  const start = process.hrtime.bigint();
+  let elapsed = 0;
+  while (elapsed < minMs * 1e6) {
+    await fn();
+    iterations++;
+    elapsed = Number(process.hrtime.bigint() - start);
+  }
+  return elapsed / iterations / 1e3;
+};
+
+(async () => {
+  console.log('exprs  each(us)  renderRecursively(us)  compiled(us)  renderRecursivelyAsync(us)  compiledAsync(us)');
+  for (const n of [1, 10, 50, 200]) {
+    const input = entity(n);
+    const tpl = template(n);
+    const compiled = jq.compileTemplate(tpl);
+    const each = time(() => renderEach(input, tpl));
+    const recursive = time(() => jq.renderRecursively(input, tpl));
+    const compiledSync = time(() => compiled.render(input));
+    const recursiveAsync = await timeAsync(() => jq.renderRecursivelyAsync(input, tpl));
+    const compiledAsync = await timeAsync(() => compiled.renderAsync(input));
+    console.log(
+      `${String(n + 3).padStart(5)}  ${each.toFixed(1).padStart(8)}  ${recursive.toFixed(1).padStart(21)}  ${compiledSync.toFixed(1).padStart(12)}  ${recursiveAsync.toFixed(1).padStart(26)}  ${compiledAsync.toFixed(1).padStart(17)}`,
+    );
+  }
+})();
@@ -0,0 +1,33 @@
+// Measures how long a small fs.readFile waits while a burst of slow filters runs, with the filters on
+// the libuv pool (shared with fs) and on the dedicated worker pool.
+// Run with: node bench/worker-pool.bench.js [burst]
+const fs = require('fs');
+const jq = require('../lib');
+
+const BURST = Number(process.argv[2] || 16);
+const FILTER = '[range(100000)] | length';
+const rounds = 5;
+
+const measure = async (name) => {
+  let total = 0;
+  let worst = 0;
+  for (let i = 0; i < rounds; i++) {
+    const burst = Promise.all(Array.from({ length: BURST }, () => jq.execAsync({}, FILTER)));
+    const start = process.hrtime.bigint();
+    await fs.promises.readFile(__filename);
+    const ms = Number(process.hrtime.bigint() - start) / 1e6;
+    await burst;
+    total += ms;
+    worst = Math.max(worst, ms);
+  }
+  console.log(`${name.padEnd(14)} ${(total / rounds).toFixed(1).padStart(10)} ${worst.toFixed(1).padStart(10)}`);
+};
+
+(async () => {
+  console.log(`readFile during a burst of ${BURST} filters`);
+  console.log('pool              mean(ms)   max(ms)');
+  await measure('libuv');
+  jq.setWorkerPool({ threads: 4 });
+  await measure('worker pool');
+  jq.setWorkerPool(null);
+})();
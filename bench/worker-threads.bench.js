@@ -0,0 +1,53 @@
+// Measures sync render throughput with the bindings loaded on 1, 2, 4 and one worker_thread per CPU. All
+// workers run the same template, compiled once for the whole process.
+// Run with: node bench/worker-threads.bench.js [renders per worker]
+const os = require('os');
+const path = require('path');
+const { Worker } = require('worker_threads');
+
+const RENDERS = Number(process.argv[2] || 20000);
+
+const code = `
+const { parentPort, workerData } = require('worker_threads');
+const jq = require(${JSON.stringify(path.resolve(__dirname, '../lib'))});
+const template = {
+  identifier: '{{.id}}',
+  title: '{{.name | ascii_upcase}}',
+  owners: '{{[.team[] | select(.active) | .name]}}',
+  tier: '{{.tier // 3}}',
+};
+const input = { id: 'svc-1', name: 'service', tier: 1, team: [{ name: 'a', active: true }, { name: 'b', active: false }] };
+parentPort.once('message', () => {
+  for (let i = 0; i < workerData; i++) {
+    jq.renderRecursively(input, template);
+  }
+  parentPort.postMessage('done');
+});
+parentPort.postMessage('ready');
+`;
+
+const run = async (count) => {
+  const workers = Array.from({ length: count }, () => new Worker(code, { eval: true, workerData: RENDERS }));
+  const next = (worker) => new Promise((resolve) => worker.once('message', resolve));
+  await Promise.all(workers.map(next));
+  const start = process.hrtime.bigint();
+  const done = Promise.all(workers.map(next));
+  workers.forEach((worker) => worker.postMessage('go'));
+  await done;
+  const seconds = Number(process.hrtime.bigint() - start) / 1e9;
+  await Promise.all(workers.map((worker) => worker.terminate()));
+  return (count * RENDERS) / seconds;
+};
+
+(async () => {
+  const cpus = os.cpus().length;
+  const counts = [...new Set([1, 2, 4, cpus])].sort((a, b) => a - b);
+  console.log(`${RENDERS} renders per worker, ${cpus} CPUs`);
+  console.log('workers   renders/s  scaling');
+  let base;
+  for (const count of counts) {
+    const rate = await run(count);
+    base = base || rate;
+    console.log(`${String(count).padStart(7)} ${rate.toFixed(0).padStart(11)} ${(rate / base).toFixed(2).padStart(8)}x`);
+  }
+})();
@@ -3,7 +3,15 @@
         {
             "target_name": "jq-node-bindings",
             "sources": [
-                "src/binding.cc"
+                "src/binding.cc",
+                "src/cancel.cc",
+                "src/convert.cc",
+                "src/filter_analysis.cc",
+                "src/filter_cache.cc",
+                "src/json_parser.cc",
+                "src/result_cache.cc",
+                "src/stats.cc",
+                "src/worker_pool.cc"
             ],
             "include_dirs": [
                 "<!(node -p \"require('node-addon-api').include_dir\")",
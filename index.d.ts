@@ -1,6 +1,34 @@
 declare module '@port-labs/jq-node-bindings' {
-  type ExecOptions = { enableEnv?: boolean, throwOnError?: boolean };
-  type ExecAsyncOptions = { enableEnv?: boolean, throwOnError?: boolean, timeoutSec?: number };
+  import { Transform } from 'stream';
+
+  type OutputFormat = 'value' | 'json' | 'buffer';
+  type Priority = 'high' | 'normal' | 'low';
+  type ExecOptions = { enableEnv?: boolean, throwOnError?: boolean, walkLimit?: number, output?: OutputFormat };
+  type ExecAsyncOptions = { enableEnv?: boolean, throwOnError?: boolean, timeoutSec?: number, timeoutMs?: number, signal?: AbortSignal, walkLimit?: number, output?: OutputFormat, priority?: Priority };
+  type TemplateOptions = { enableEnv?: boolean, throwOnError?: boolean, timeoutSec?: number, timeoutMs?: number, walkLimit?: number, output?: OutputFormat, priority?: Priority };
+  type CancelOptions = { signal?: AbortSignal };
+  type IterateOptions = { enableEnv?: boolean, timeoutSec?: number, walkLimit?: number, batchSize?: number, output?: OutputFormat, priority?: Priority };
+  type StreamOptions = { enableEnv?: boolean, timeoutSec?: number, output?: OutputFormat, priority?: Priority, highWaterMark?: number, readableHighWaterMark?: number, writableHighWaterMark?: number };
+  type BatchResult = { value?: any, error?: string };
+  type CacheShardStats = { entries: number, bytes: number, hits: number, misses: number, evictions: number };
+  type CacheStats = { cacheSize: number, entries: number, poolSize: number, states: number, idleStates: number, bytes: number, maxBytes: number, hits: number, misses: number, evictions: number, shards: Array<CacheShardStats> };
+  type CachedFilterStats = { filter: string, compileUs: number, bytes: number, states: number, idleStates: number };
+  type LatencyHistogram = { count: number, totalUs: number, maxUs: number, p50Us: number, p90Us: number, p99Us: number, p999Us: number, buckets: Array<{ upToUs: number, count: number }> };
+  type Stats = {
+    cache: CacheStats,
+    filters: Array<CachedFilterStats>,
+    stateWaits: { count: number, totalUs: number },
+    latency: { parse: LatencyHistogram, execute: LatencyHistogram, serialize: LatencyHistogram, materialize: LatencyHistogram },
+    asyncInFlight: number,
+    asyncCoalesced: number,
+    workerPool: WorkerPoolStats | null,
+    resultCache: ResultCacheStats,
+  };
+  type WorkerPoolOptions = { threads?: number, affinity?: Array<number>, maxQueue?: number, maxWaitMs?: number, overflow?: 'reject' | 'shed' };
+  type WorkerPoolStats = { threads: number, queued: number, rejected: number, shed: number, expired: number };
+  type JsonParser = 'jq' | 'simd' | 'scalar';
+  type ResultCacheOptions = { maxBytes?: number, ttlMs?: number };
+  type ResultCacheStats = { entries: number, bytes: number, maxBytes: number, ttlMs: number, hits: number, misses: number, evictions: number, expired: number };
 
   export class JqExecError extends Error {
   }
@@ -8,10 +36,48 @@ declare module '@port-labs/jq-node-bindings' {
   export class JqExecCompileError extends Error {
   }
 
-  export function exec(json: object, input: string, options?: ExecOptions): object | Array<any> | string | number | boolean | null;
-  export function execAsync(json: object, input: string, options?: ExecAsyncOptions): Promise<object | Array<any> | string | number | boolean | null>;
+  export function exec(json: object | Uint8Array, input: string, options?: ExecOptions): object | Array<any> | string | number | boolean | null;
+  export function execAsync(json: object | Uint8Array, input: string, options?: ExecAsyncOptions): Promise<object | Array<any> | string | number | boolean | null>;
+  export function execAll(json: object, input: string, options?: ExecOptions): Array<any> | null;
+  export function execAllAsync(json: object, input: string, options?: ExecAsyncOptions): Promise<Array<any> | null>;
+  export function iterate(json: object, input: string, options?: IterateOptions): Generator<any, void, undefined>;
+  export function iterateAsync(json: object, input: string, options?: IterateOptions): AsyncGenerator<any, void, undefined>;
+  export function createFilterStream(input: string, options?: StreamOptions): Transform;
+  export function streamFile(source: string | number, input: string, options?: StreamOptions): Transform;
+  export function execBatch(json: Array<object>, input: string, options?: ExecOptions): Array<BatchResult>;
+  export function execBatchAsync(json: Array<object>, input: string, options?: ExecAsyncOptions): Promise<Array<BatchResult>>;
+  export function compile(input: string, options?: ExecAsyncOptions): CompiledFilter;
+  export function document(json: object, options?: { walkLimit?: number }): JqDocument;
   export function setCacheSize(cacheSize: number): void;
+  export function setCacheMaxBytes(maxBytes: number): number;
+  export function setFastPath(enabled: boolean): boolean;
+  export function setInputProjection(enabled: boolean): boolean;
+  export function setLiteralHoisting(enabled: boolean): boolean;
+  export function setResultCache(options?: ResultCacheOptions | null): number;
+  export function setAsyncCoalescing(enabled: boolean): boolean;
+  export function setJsonParser(parser: JsonParser): JsonParser;
+  export function setPoolSize(poolSize: number): number;
+  export function setWorkerPool(options?: WorkerPoolOptions | null): number;
+  export function getCacheStats(): CacheStats;
+  export function getStats(): Stats;
   export function renderRecursively(json: object, input: object | Array<any> | string | number | boolean | null, execOptions?: ExecOptions): object | Array<any> | string | number | boolean | null;
   export function renderRecursivelyAsync(json: object, input: object | Array<any> | string | number | boolean | null, execOptions?: ExecAsyncOptions): Promise<object | Array<any> | string | number | boolean | null>;
+  export function compileTemplate(input: object | Array<any> | string | number | boolean | null, options?: TemplateOptions): CompiledTemplate;
+
+  export interface CompiledFilter {
+    exec(json: object): object | Array<any> | string | number | boolean | null;
+    execAsync(json: object, options?: CancelOptions): Promise<object | Array<any> | string | number | boolean | null>;
+  }
 
+  export interface JqDocument {
+    exec(input: string, options?: ExecOptions): object | Array<any> | string | number | boolean | null;
+    execAsync(input: string, options?: ExecAsyncOptions): Promise<object | Array<any> | string | number | boolean | null>;
+    execMany(inputs: Array<string>, options?: ExecOptions): Array<BatchResult>;
+    execManyAsync(inputs: Array<string>, options?: ExecAsyncOptions): Promise<Array<BatchResult>>;
+  }
+
+  export interface CompiledTemplate {
+    render(json: object): object | Array<any> | string | number | boolean | null;
+    renderAsync(json: object, options?: CancelOptions): Promise<object | Array<any> | string | number | boolean | null>;
+  }
 }
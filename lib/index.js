@@ -1,14 +1,37 @@
 const jq = require('./jq');
 const template = require('./template');
 const templateAsync = require('./templateAsync');
+const stream = require('./stream');
 
 
 module.exports = {
   exec: jq.exec,
   execAsync: jq.execAsync,
+  execAll: jq.execAll,
+  execAllAsync: jq.execAllAsync,
+  iterate: jq.iterate,
+  iterateAsync: jq.iterateAsync,
+  execBatch: jq.execBatch,
+  execBatchAsync: jq.execBatchAsync,
+  compile: jq.compile,
+  createFilterStream: stream.createFilterStream,
+  streamFile: stream.streamFile,
+  document: jq.document,
   setCacheSize: jq.setCacheSize,
+  setCacheMaxBytes: jq.setCacheMaxBytes,
+  setFastPath: jq.setFastPath,
+  setInputProjection: jq.setInputProjection,
+  setLiteralHoisting: jq.setLiteralHoisting,
+  setResultCache: jq.setResultCache,
+  setAsyncCoalescing: jq.setAsyncCoalescing,
+  setJsonParser: jq.setJsonParser,
+  setPoolSize: jq.setPoolSize,
+  setWorkerPool: jq.setWorkerPool,
+  getCacheStats: jq.getCacheStats,
+  getStats: jq.getStats,
   renderRecursively: template.renderRecursively,
   renderRecursivelyAsync: templateAsync.renderRecursivelyAsync,
+  compileTemplate: template.compileTemplate,
   JqExecError: jq.JqExecError,
   JqExecCompileError: jq.JqExecCompileError,
 };
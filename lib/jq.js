@@ -15,34 +15,276 @@ class JqExecError extends Error {
 class JqExecCompileError extends JqExecError {
 }
 
-const exec = (object, filter, {enableEnv = false, throwOnError = false} = {}) => {
+const toJqExecError = (message) =>
+  new (message?.startsWith('jq: compile error') ? JqExecCompileError : JqExecError)(message);
+
+// Run call with a cancel token following signal (an AbortSignal, optional). Aborting it drops the call
+// if it is still queued and stops jq at its next step if it runs; the call fails with 'jq: error: aborted'
+const withSignal = async (signal, call) => {
+  if (!signal) {
+    return call(undefined);
+  }
+  const cancel = nativeJq.createCancelToken();
+  const abort = () => cancel.abort();
+  if (signal.aborted) {
+    abort();
+  } else {
+    signal.addEventListener('abort', abort, {once: true});
+  }
   try {
-    const data = nativeJq.execSync(JSON.stringify(object), formatFilter(filter, {enableEnv}))
+    return await call(cancel);
+  } finally {
+    signal.removeEventListener('abort', abort);
+  }
+}
+
+// output: 'json' or 'buffer' returns the result as the JSON text jq prints, for results that are only
+// serialized again; the JS value is never built
+const exec = (object, filter, {enableEnv = false, throwOnError = false, walkLimit, output} = {}) => {
+  try {
+    const data = nativeJq.execSync(object, formatFilter(filter, {enableEnv}), {valueInput: true, walkLimit, output})
 
     return data?.value;
   } catch (err) {
     if (throwOnError) {
-      throw new (err?.message?.startsWith('jq: compile error') ? JqExecCompileError : JqExecError)(err.message);
+      throw toJqExecError(err?.message);
     }
     return null
   }
 }
 
-const execAsync = async (object, filter, {enableEnv = false, throwOnError = false, timeoutSec} = {}) => {
+const execAsync = async (object, filter, {enableEnv = false, throwOnError = false, timeoutSec, timeoutMs, signal, walkLimit, output, priority} = {}) => {
   try {
-    const data = await nativeJq.execAsync(JSON.stringify(object), formatFilter(filter, {enableEnv}), timeoutSec)
+    const data = await withSignal(signal, (cancel) =>
+      nativeJq.execAsync(object, formatFilter(filter, {enableEnv}), {valueInput: true, timeoutSec, timeoutMs, cancel, walkLimit, output, priority}))
     return data?.value;
   } catch (err) {
     if (throwOnError) {
-      throw new (err?.message?.startsWith('jq: compile error') ? JqExecCompileError : JqExecError)(err.message);
+      throw toJqExecError(err?.message);
     }
     return null
   }
 }
+// Every output of the filter, where exec only returns the first one
+const execAll = (object, filter, {enableEnv = false, throwOnError = false, walkLimit, output} = {}) => {
+  try {
+    return nativeJq.execAll(object, formatFilter(filter, {enableEnv}), {valueInput: true, walkLimit, output});
+  } catch (err) {
+    if (throwOnError) {
+      throw toJqExecError(err?.message);
+    }
+    return null
+  }
+}
+
+const execAllAsync = async (object, filter, {enableEnv = false, throwOnError = false, timeoutSec, timeoutMs, signal, walkLimit, output, priority} = {}) => {
+  try {
+    return await withSignal(signal, (cancel) =>
+      nativeJq.execAllAsync(object, formatFilter(filter, {enableEnv}), {valueInput: true, timeoutSec, timeoutMs, cancel, walkLimit, output, priority}));
+  } catch (err) {
+    if (throwOnError) {
+      throw toJqExecError(err?.message);
+    }
+    return null
+  }
+}
+
+const DEFAULT_BATCH_SIZE = 100;
+
+const createIterator = (object, filter, {enableEnv = false, timeoutSec, walkLimit, output, priority} = {}) => {
+  try {
+    return nativeJq.createIterator(object, formatFilter(filter, {enableEnv}), {valueInput: true, timeoutSec, walkLimit, output, priority});
+  } catch (err) {
+    throw toJqExecError(err?.message);
+  }
+}
+
+const pull = (pullBatch) => {
+  try {
+    return pullBatch();
+  } catch (err) {
+    throw toJqExecError(err?.message);
+  }
+}
+
+const pullAsync = async (pullBatch) => {
+  try {
+    return await pullBatch();
+  } catch (err) {
+    throw toJqExecError(err?.message);
+  }
+}
+
+// Iterate over the outputs of the filter, pulling them from jq batchSize at a time. Errors are always
+// thrown, after the outputs before them. Breaking out of the loop stops the filter.
+function* iterate(object, filter, {batchSize = DEFAULT_BATCH_SIZE, ...options} = {}) {
+  const it = createIterator(object, filter, options);
+  try {
+    for (;;) {
+      const batch = pull(() => it.next(batchSize));
+      yield* batch;
+      if (batch.length < batchSize) {
+        // The filter is done, this only throws the error it may have ended with
+        pull(() => it.next(1));
+        return;
+      }
+    }
+  } finally {
+    it.close();
+  }
+}
+
+async function* iterateAsync(object, filter, {batchSize = DEFAULT_BATCH_SIZE, ...options} = {}) {
+  const it = createIterator(object, filter, options);
+  try {
+    for (;;) {
+      const batch = await pullAsync(() => it.nextAsync(batchSize));
+      yield* batch;
+      if (batch.length < batchSize) {
+        pull(() => it.next(1));
+        return;
+      }
+    }
+  } finally {
+    it.close();
+  }
+}
+
+// Run one filter on many inputs, one {value} or {error} per input. A filter that doesn't compile is
+// reported on every input, or thrown with throwOnError.
+const execBatch = (objects, filter, {enableEnv = false, throwOnError = false, walkLimit, output} = {}) => {
+  try {
+    return nativeJq.execBatch(objects, formatFilter(filter, {enableEnv}), {valueInput: true, walkLimit, output});
+  } catch (err) {
+    if (throwOnError || !Array.isArray(objects)) {
+      throw toJqExecError(err?.message);
+    }
+    return objects.map(() => ({error: err.message}));
+  }
+}
+
+const execBatchAsync = async (objects, filter, {enableEnv = false, throwOnError = false, timeoutSec, timeoutMs, signal, walkLimit, output, priority} = {}) => {
+  try {
+    return await withSignal(signal, (cancel) =>
+      nativeJq.execBatchAsync(objects, formatFilter(filter, {enableEnv}), {valueInput: true, timeoutSec, timeoutMs, cancel, walkLimit, output, priority}));
+  } catch (err) {
+    if (throwOnError || !Array.isArray(objects)) {
+      throw toJqExecError(err?.message);
+    }
+    return objects.map(() => ({error: err.message}));
+  }
+}
+
+const firstValue = ([result], throwOnError) => {
+  if (result.error !== undefined) {
+    if (throwOnError) {
+      throw toJqExecError(result.error);
+    }
+    return null;
+  }
+  return result.value;
+}
+
+// Format and compile a filter once. The handle owns its compiled states, so exec/execAsync skip
+// formatting and the filter cache; they are released when the handle is garbage collected.
+const compile = (filter, {enableEnv = false, throwOnError = false, timeoutSec, timeoutMs, walkLimit, output, priority} = {}) => {
+  const filterSet = nativeJq.compileFilters([formatFilter(filter, {enableEnv})]);
+
+  return {
+    exec: (object) => {
+      let results;
+      try {
+        results = filterSet.exec(object, {valueInput: true, walkLimit, output});
+      } catch (err) {
+        results = [{error: err.message}];
+      }
+      return firstValue(results, throwOnError);
+    },
+    execAsync: async (object, {signal} = {}) => {
+      let results;
+      try {
+        results = await withSignal(signal, (cancel) =>
+          filterSet.execAsync(object, {valueInput: true, timeoutSec, timeoutMs, cancel, walkLimit, output, priority}));
+      } catch (err) {
+        results = [{error: err.message}];
+      }
+      return firstValue(results, throwOnError);
+    },
+  };
+}
+
+// Convert an input once to run many filters on it. The converted input is kept natively until the
+// document is garbage collected; concurrent async runs each work on a copy of it.
+const document = (object, {walkLimit} = {}) => {
+  const doc = nativeJq.createDocument(object, {valueInput: true, walkLimit});
+  const format = (filters, enableEnv) => filters.map((filter) => formatFilter(filter, {enableEnv}));
+
+  return {
+    exec: (filter, {enableEnv = false, throwOnError = false, output} = {}) =>
+      firstValue(doc.execMany(format([filter], enableEnv), {output}), throwOnError),
+    execAsync: async (filter, {enableEnv = false, throwOnError = false, timeoutSec, timeoutMs, signal, output, priority} = {}) => {
+      let results;
+      try {
+        results = await withSignal(signal, (cancel) =>
+          doc.execManyAsync(format([filter], enableEnv), {timeoutSec, timeoutMs, cancel, output, priority}));
+      } catch (err) {
+        results = [{error: err.message}];
+      }
+      return firstValue(results, throwOnError);
+    },
+    execMany: (filters, {enableEnv = false, output} = {}) => doc.execMany(format(filters, enableEnv), {output}),
+    execManyAsync: (filters, {enableEnv = false, timeoutSec, timeoutMs, signal, output, priority} = {}) =>
+      withSignal(signal, (cancel) => doc.execManyAsync(format(filters, enableEnv), {timeoutSec, timeoutMs, cancel, output, priority})),
+  };
+}
+
+// Run already formatted filters on one input, one {value} or {error} per filter
+const execMany = (object, filters, {walkLimit, output} = {}) => {
+  try {
+    return nativeJq.execMany(object, filters, {valueInput: true, walkLimit, output});
+  } catch (err) {
+    return filters.map(() => ({error: err.message}));
+  }
+}
+
+const execManyAsync = async (object, filters, {timeoutSec, timeoutMs, signal, walkLimit, output, priority} = {}) => {
+  try {
+    return await withSignal(signal, (cancel) =>
+      nativeJq.execManyAsync(object, filters, {valueInput: true, timeoutSec, timeoutMs, cancel, walkLimit, output, priority}));
+  } catch (err) {
+    return filters.map(() => ({error: err.message}));
+  }
+}
+
 module.exports = {
   exec,
   execAsync,
+  execAll,
+  execAllAsync,
+  iterate,
+  iterateAsync,
+  execBatch,
+  execBatchAsync,
+  compile,
+  document,
+  execMany,
+  execManyAsync,
+  formatFilter,
+  toJqExecError,
+  withSignal,
+  compileFilters: nativeJq.compileFilters,
   setCacheSize: nativeJq.setCacheSize,
+  setCacheMaxBytes: nativeJq.setCacheMaxBytes,
+  setFastPath: nativeJq.setFastPath,
+  setInputProjection: nativeJq.setInputProjection,
+  setLiteralHoisting: nativeJq.setLiteralHoisting,
+  setResultCache: nativeJq.setResultCache,
+  setAsyncCoalescing: nativeJq.setAsyncCoalescing,
+  setJsonParser: nativeJq.setJsonParser,
+  setPoolSize: nativeJq.setPoolSize,
+  setWorkerPool: nativeJq.setWorkerPool,
+  getCacheStats: nativeJq.getCacheStats,
+  getStats: nativeJq.getStats,
   JqExecError,
   JqExecCompileError,
 };
@@ -0,0 +1,59 @@
+const fs = require('fs');
+const {Transform, pipeline} = require('stream');
+const nativeJq = require('bindings')('jq-node-bindings');
+const {formatFilter, toJqExecError} = require('./jq');
+
+// Transform stream running the filter on every JSON value of the bytes written to it (NDJSON or
+// concatenated JSON). Parsing and filtering happen on a worker thread; every written chunk is read in
+// place and pushed as one array with the outputs of the values it completed, so a slow reader
+// stops the writes.
+const createFilterStream = (filter, {enableEnv = false, timeoutSec, output, priority, ...streamOptions} = {}) => {
+  let native;
+  try {
+    native = nativeJq.createStream(formatFilter(filter, {enableEnv}), {timeoutSec, output, priority});
+  } catch (err) {
+    throw toJqExecError(err?.message);
+  }
+
+  const run = (transform, chunk, callback) => {
+    native.writeAsync(chunk).then(
+      (outputs) => {
+        if (outputs.length) {
+          transform.push(outputs);
+        }
+        callback();
+      },
+      (err) => callback(toJqExecError(err?.message)),
+    );
+  };
+
+  return new Transform({
+    ...streamOptions,
+    readableObjectMode: true,
+    transform(chunk, encoding, callback) {
+      run(this, typeof chunk === 'string' ? Buffer.from(chunk, encoding) : chunk, callback);
+    },
+    flush(callback) {
+      run(this, null, callback);
+    },
+    destroy(err, callback) {
+      native.close();
+      callback(err);
+    },
+  });
+}
+
+// Run the filter on every JSON value of a file, given by path or file descriptor
+const streamFile = (source, filter, {highWaterMark, ...options} = {}) => {
+  const input = typeof source === 'number'
+    ? fs.createReadStream(null, {fd: source, highWaterMark})
+    : fs.createReadStream(source, {highWaterMark});
+  const filterStream = createFilterStream(filter, options);
+  pipeline(input, filterStream, () => {});
+  return filterStream;
+}
+
+module.exports = {
+  createFilterStream,
+  streamFile,
+};
@@ -51,75 +51,251 @@ const findInsideDoubleBracesIndices = (input) => {
   return indices;
 }
 
-const render = (inputJson, template, execOptions = {}) => {
-  if (typeof template !== 'string') {
-    return null;
+const SPREAD_KEYWORD_PATTERN = /^\s*\{\{\s*spreadValue\(\s*\)\s*\}\}\s*$/;  // matches {{ <Keyword>() }} with white spaces where you'd expect them
+
+// A template is planned once into a tree of nodes; every jq expression in it becomes an index into
+// `filters`, so all of them can be run on the input in one native call and the result assembled after.
+const planString = (template, addFilter) => {
+  let indices;
+  try {
+    indices = findInsideDoubleBracesIndices(template);
+  } catch (err) {
+    // Thrown when the string is rendered, like an unplanned render would
+    return {type: 'error', message: err.message};
   }
-  const indices = findInsideDoubleBracesIndices(template);
   if (!indices.length) {
     // If no jq templates in string, return it
-    return template;
+    return {type: 'literal', value: template};
   }
 
   const firstIndex = indices[0];
   if (indices.length === 1 && template.trim().startsWith('{{') && template.trim().endsWith('}}')) {
     // If entire string is a template, evaluate and return the result with the original type
-    return jq.exec(inputJson, template.slice(firstIndex.start, firstIndex.end), execOptions);
+    return {type: 'expr', id: addFilter(template.slice(firstIndex.start, firstIndex.end))};
   }
 
-  let result = template.slice(0, firstIndex.start - '{{'.length); // Initiate result with string until first template start index
-  indices.forEach((index, i) => {
-    const jqResult = jq.exec(inputJson, template.slice(index.start, index.end), execOptions);
-    result +=
-      // Add to the result the stringified evaluated jq of the current template
-      (typeof jqResult === 'string' ? jqResult : JSON.stringify(jqResult)) +
-      // Add to the result from template end index. if last template index - until the end of string, else until next start index
-      template.slice(
+  return {
+    type: 'interp',
+    head: template.slice(0, firstIndex.start - '{{'.length),
+    parts: indices.map((index, i) => ({
+      id: addFilter(template.slice(index.start, index.end)),
+      // From template end index. if last template index - until the end of string, else until next start index
+      tail: template.slice(
         index.end + '}}'.length,
         i + 1 === indices.length ? template.length : indices[i + 1].start - '{{'.length,
-      );
-  });
-
-  return result;
+      ),
+    })),
+  };
 }
 
-const renderRecursively = (inputJson, template, execOptions = {}) => {
+const planTemplate = (template, addFilter) => {
   if (typeof template === 'string') {
-    return render(inputJson, template, execOptions);
+    return planString(template, addFilter);
   }
   if (Array.isArray(template)) {
-    return template.map((value) => renderRecursively(inputJson, value, execOptions));
+    return {type: 'array', items: template.map((value) => planTemplate(value, addFilter))};
   }
   if (typeof template === 'object' && template !== null) {
-    return Object.fromEntries(
-      Object.entries(template).flatMap(([key, value]) => {
-        const SPREAD_KEYWORD = "spreadValue";
-        const keywordMatcher = `^\\{\\{\\s*${SPREAD_KEYWORD}\\(\\s*\\)\\s*\\}\\}$`;  // matches {{ <Keyword>() }} with white spaces where you'd expect them
+    return {
+      type: 'object',
+      entries: Object.entries(template).map(([key, value]) => (
+        SPREAD_KEYWORD_PATTERN.test(key)
+          ? {spread: true, key, value, valueNode: planTemplate(value, addFilter)}
+          : {spread: false, key, keyNode: planTemplate(key, addFilter), valueNode: planTemplate(value, addFilter)}
+      )),
+    };
+  }
 
-        if (key.trim().match(keywordMatcher)) {
-          const evaluatedValue = renderRecursively(inputJson, value, execOptions);
+  return {type: 'literal', value: template};
+}
+
+const createPlan = (template, {enableEnv = false} = {}) => {
+  const filters = [];
+  const ids = new Map();
+  const addFilter = (filter) => {
+    const formatted = jq.formatFilter(filter, {enableEnv});
+    if (!ids.has(formatted)) {
+      ids.set(formatted, filters.length);
+      filters.push(formatted);
+    }
+    return ids.get(formatted);
+  };
+  return {root: planTemplate(template, addFilter), filters};
+}
+
+const resultValue = (result, throwOnError) => {
+  if (result.error !== undefined) {
+    if (throwOnError) {
+      throw jq.toJqExecError(result.error);
+    }
+    return null;
+  }
+  return result.value;
+}
+
+// Errors are raised in traversal order and only for the parts that an unplanned render would have evaluated.
+// resultOf(id) gives the {value} or {error} of filter id
+const assembleWith = (node, resultOf, throwOnError) => {
+  switch (node.type) {
+    case 'literal':
+      return node.value;
+    case 'error':
+      throw new Error(node.message);
+    case 'expr':
+      return resultValue(resultOf(node.id), throwOnError);
+    case 'interp':
+      return node.parts.reduce((result, part) => {
+        const jqResult = resultValue(resultOf(part.id), throwOnError);
+        // Add to the result the stringified evaluated jq of the current template
+        return result + (typeof jqResult === 'string' ? jqResult : JSON.stringify(jqResult)) + part.tail;
+      }, node.head);
+    case 'array':
+      return node.items.map((item) => assembleWith(item, resultOf, throwOnError));
+    default:
+      return Object.fromEntries(
+        node.entries.flatMap((entry) => {
+          if (entry.spread) {
+            const evaluatedValue = assembleWith(entry.valueNode, resultOf, throwOnError);
+            if (typeof evaluatedValue !== "object") {
+              throw new Error(
+                `Evaluated value should be an object if the key is ${entry.key}. Original value: ${entry.value}, evaluated to: ${JSON.stringify(evaluatedValue)}`
+              );
+            }
+            return Object.entries(evaluatedValue);
+          }
+
+          const evaluatedKey = assembleWith(entry.keyNode, resultOf, throwOnError);
+          if (typeof evaluatedKey !== 'string' && evaluatedKey != null) {
+            throw new Error(
+              `Evaluated object key should be undefined, null or string. Original key: ${entry.key}, evaluated to: ${JSON.stringify(evaluatedKey)}`,
+            );
+          }
+          return evaluatedKey ? [[evaluatedKey, assembleWith(entry.valueNode, resultOf, throwOnError)]] : [];
+        }),
+      );
+  }
+}
+
+const assemble = (node, results, throwOnError) => assembleWith(node, (id) => results[id], throwOnError);
+
+// Like JSON.stringify(assemble(...)) for results run with output 'json': whole-expression values are
+// copied as the JSON text jq printed, only interpolated strings, keys and spreads parse theirs.
+// undefined when the rendered value is undefined
+const assembleJsonWith = (node, results, resultOf, throwOnError) => {
+  switch (node.type) {
+    case 'expr': {
+      const json = resultValue(results[node.id], throwOnError);
+      return json === null ? 'null' : json;
+    }
+    case 'array':
+      return `[${node.items.map((item) => assembleJsonWith(item, results, resultOf, throwOnError) ?? 'null').join(',')}]`;
+    case 'object': {
+      // Collected in an object first so key order and duplicate keys work out like in assemble
+      const members = Object.create(null);
+      node.entries.forEach((entry) => {
+        if (entry.spread) {
+          const evaluatedValue = assembleWith(entry.valueNode, resultOf, throwOnError);
           if (typeof evaluatedValue !== "object") {
             throw new Error(
-              `Evaluated value should be an object if the key is ${key}. Original value: ${value}, evaluated to: ${JSON.stringify(evaluatedValue)}`
+              `Evaluated value should be an object if the key is ${entry.key}. Original value: ${entry.value}, evaluated to: ${JSON.stringify(evaluatedValue)}`
             );
           }
-          return Object.entries(evaluatedValue);
+          Object.entries(evaluatedValue).forEach(([key, value]) => {
+            members[key] = JSON.stringify(value);
+          });
+          return;
         }
 
-        const evaluatedKey = renderRecursively(inputJson, key, execOptions);
-        if (!['undefined', 'string'].includes(typeof evaluatedKey) && evaluatedKey !== null) {
+        const evaluatedKey = assembleWith(entry.keyNode, resultOf, throwOnError);
+        if (typeof evaluatedKey !== 'string' && evaluatedKey != null) {
           throw new Error(
-            `Evaluated object key should be undefined, null or string. Original key: ${key}, evaluated to: ${JSON.stringify(evaluatedKey)}`,
+            `Evaluated object key should be undefined, null or string. Original key: ${entry.key}, evaluated to: ${JSON.stringify(evaluatedKey)}`,
           );
         }
-        return evaluatedKey ? [[evaluatedKey, renderRecursively(inputJson, value, execOptions)]] : [];
-      }),
-    );
+        if (evaluatedKey) {
+          members[evaluatedKey] = assembleJsonWith(entry.valueNode, results, resultOf, throwOnError);
+        }
+      });
+      const json = Object.entries(members)
+        .filter(([, value]) => value !== undefined)
+        .map(([key, value]) => `${JSON.stringify(key)}:${value}`);
+      return `{${json.join(',')}}`;
+    }
+    default:
+      return JSON.stringify(assembleWith(node, resultOf, throwOnError));
+  }
+}
+
+const assembleJson = (node, results, throwOnError) => {
+  const parsed = [];
+  const resultOf = (id) => {
+    if (!(id in parsed)) {
+      const result = results[id];
+      parsed[id] = result.value === undefined ? result : {value: JSON.parse(result.value)};
+    }
+    return parsed[id];
+  };
+  return assembleJsonWith(node, results, resultOf, throwOnError);
+}
+
+// Rendered template for the output option: the value, or its JSON as a string or Buffer
+const assembleOutput = (node, results, {throwOnError, output} = {}) => {
+  if (output !== 'json' && output !== 'buffer') {
+    return assemble(node, results, throwOnError);
   }
+  const json = assembleJson(node, results, throwOnError);
+  return output === 'buffer' && json !== undefined ? Buffer.from(json) : json;
+}
+
+// Filters of a template rendered with a raw output format run with output 'json'
+const filterOutput = (output) => (output === 'json' || output === 'buffer' ? 'json' : output);
+
+const renderRecursively = (inputJson, template, execOptions = {}) => {
+  const plan = createPlan(template, execOptions);
+  const results = plan.filters.length
+    ? jq.execMany(inputJson, plan.filters, {...execOptions, output: filterOutput(execOptions.output)})
+    : [];
+  return assembleOutput(plan.root, results, execOptions);
+}
 
-  return template;
+// Plan the template and compile its expressions once, for templates rendered on many inputs
+const compileTemplate = (template, {enableEnv = false, throwOnError = false, timeoutSec, timeoutMs, walkLimit, output, priority} = {}) => {
+  const plan = createPlan(template, {enableEnv});
+  const filterSet = plan.filters.length ? jq.compileFilters(plan.filters) : null;
+  const failAll = (err) => plan.filters.map(() => ({error: err.message}));
+
+  return {
+    render: (inputJson) => {
+      let results = [];
+      if (filterSet) {
+        try {
+          results = filterSet.exec(inputJson, {valueInput: true, walkLimit, output: filterOutput(output)});
+        } catch (err) {
+          results = failAll(err);
+        }
+      }
+      return assembleOutput(plan.root, results, {throwOnError, output});
+    },
+    renderAsync: async (inputJson, {signal} = {}) => {
+      let results = [];
+      if (filterSet) {
+        try {
+          results = await jq.withSignal(signal, (cancel) =>
+            filterSet.execAsync(inputJson, {valueInput: true, timeoutSec, timeoutMs, cancel, walkLimit, output: filterOutput(output), priority}));
+        } catch (err) {
+          results = failAll(err);
+        }
+      }
+      return assembleOutput(plan.root, results, {throwOnError, output});
+    },
+  };
 }
 
 module.exports = {
-  renderRecursively
+  renderRecursively,
+  compileTemplate,
+  createPlan,
+  assemble,
+  assembleOutput,
+  filterOutput,
 };
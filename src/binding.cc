@@ -1,51 +1,17 @@
-#include <list>
-#include <unordered_map>
-#include <assert.h>
-#include <string>
-#include <stdio.h>
-#include <string.h>
-#include <pthread.h>
-
 #include "src/binding.h"
-
-
-// #ifdef DEBUG_MODE
-// static bool debug_enabled = true;
-// #else
-// static bool debug_enabled = false;
-// #endif
-
-// #define DEBUG_LOG(fmt, ...) \
-//     do { if (debug_enabled) printf("[DEBUG] " fmt "\n", ##__VA_ARGS__); } while (0)
-
-// #define ASYNC_DEBUG_LOG(work, fmt, ...) \
-//     do { if (debug_enabled) printf("[DEBUG][ASYNC][%p] " fmt "\n", (jv*)work, ##__VA_ARGS__); } while (0)
-
-// #define CACHE_DEBUG_LOG(cache, fmt, ...) \
-//     do { if (debug_enabled) printf("[DEBUG][CACHE][%p] " fmt "\n", (void*)cache, ##__VA_ARGS__); } while (0)
-
-// #define WRAPPER_DEBUG_LOG(wrapper, fmt, ...) \
-//     do { if (debug_enabled) printf("[DEBUG][WRAPPER:%p] " fmt "\n", (void*)wrapper, ##__VA_ARGS__); } while (0)
-#ifdef ENABLE_DEBUG  // We'll use ENABLE_DEBUG as our flag name
-#define DEBUG_ENABLED 1
-#else
-#define DEBUG_ENABLED 0
-#endif
-
-#ifdef ENABLE_DEBUG
-#define DEBUG_LOG(fmt, ...) fprintf(stderr, "[DEBUG] " fmt "\n", ##__VA_ARGS__)
-#define ASYNC_DEBUG_LOG(work, fmt, ...) fprintf(stderr, "[DEBUG][ASYNC][%p] " fmt "\n", (void*)work, ##__VA_ARGS__)
-#define CACHE_DEBUG_LOG(cache, fmt, ...) fprintf(stderr, "[DEBUG][CACHE][%p] " fmt "\n", (void*)cache, ##__VA_ARGS__)
-#define WRAPPER_DEBUG_LOG(wrapper, fmt, ...) fprintf(stderr, "[DEBUG][WRAPPER][%p] " fmt "\n", (void*)wrapper, ##__VA_ARGS__)
-#else
-#define DEBUG_LOG(fmt, ...) ((void)0)
-#define ASYNC_DEBUG_LOG(work, fmt, ...) ((void)0)
-#define CACHE_DEBUG_LOG(cache, fmt, ...) ((void)0)
-#define WRAPPER_DEBUG_LOG(wrapper, fmt, ...) ((void)0)
-#endif
-
-static size_t global_cache_size = 100;
-static unsigned int global_timeout_sec = 5;
+#include "src/stats.h"
+#include "src/filter_analysis.h"
+#include "src/filter_cache.h"
+#include "src/json_parser.h"
+#include "src/convert.h"
+#include "src/cancel.h"
+#include "src/result_cache.h"
+#include "src/worker_pool.h"
+
+size_t global_cache_size = 100;
+unsigned int global_timeout_sec = 5;
+/* threads of the dedicated worker pools of every env, 0 when async calls run on the libuv pool */
+std::atomic<size_t> global_worker_threads(0);
 
 static size_t get_uv_thread_pool_size() {
     const char* uv_threads = getenv("UV_THREADPOOL_SIZE");
@@ -55,23 +21,26 @@ static size_t get_uv_thread_pool_size() {
             return static_cast<size_t>(thread_count);
         }
     }
-    return global_cache_size;
+    /* libuv's default */
+    return 4;
+}
+
+/* threads running async calls */
+size_t get_worker_thread_count() {
+    size_t threads = global_worker_threads.load();
+    return threads > 0 ? threads : get_uv_thread_pool_size();
 }
 
 static size_t validate_cache_size(size_t requested_size) {
-    size_t min_size = get_uv_thread_pool_size();
+    size_t min_size = get_worker_thread_count();
     size_t new_size = std::max(requested_size, min_size);
     if(requested_size < min_size){
-        DEBUG_LOG("Requested cache size %zu adjusted to minimum %zu (UV thread pool size)",requested_size,min_size);
+        DEBUG_LOG("Requested cache size %zu adjusted to minimum %zu (worker thread count)",requested_size,min_size);
         return min_size;
     }
     return new_size;
 }
 
-/* err_data and throw_err_cb to get jq error message*/
-struct err_data {
-    char buf[4096];
-};
 void throw_err_cb(void* data, jv msg) {
   struct err_data *err_data = (struct err_data *)data;
   if (jv_get_kind(msg) != JV_KIND_STRING)
@@ -83,285 +52,239 @@ void throw_err_cb(void* data, jv msg) {
   jv_free(msg);
 }
 
-/* check napi status to throw error if napi_status is not ok */
-inline bool CheckNapiStatus(napi_env env, napi_status status, const char* message) {
-    if (status != napi_ok) {
-        napi_throw_error(env, nullptr, message);
-        return false;
-    }
-    return true;
+/* error sink for compiled states, jq only reports through it while compiling */
+struct err_data runtime_err;
+
+/* async works queued and not completed yet */
+std::atomic<int64_t> async_in_flight(0);
+
+EnvData* env_data(napi_env env) {
+    void* data = nullptr;
+    napi_get_instance_data(env, &data);
+    return static_cast<EnvData*>(data);
 }
 
-template <class KEY_T> class LRUCache;
+struct ExecOptions {
+    unsigned int timeout_sec;
+    /* input is a js value to convert instead of JSON text */
+    bool value_input;
+    size_t walk_limit;
+    OutputFormat output;
+    WorkPriority priority;
+    /* deadline of async calls in ms, 0 for none */
+    double timeout_ms;
+    /* control of the cancel token, borrowed */
+    ExecControl* cancel;
+};
 
-struct JqFilterWrapper {
-    friend class LRUCache<std::string>;
-public:
-    std::string filter_name;
-    std::list<JqFilterWrapper*>::iterator cache_pos;
-    /* init mutex and set filter_name */
-    explicit JqFilterWrapper(jq_state* jq_, std::string filter_name_) :
-        filter_name(filter_name_),
-        jq(jq_) {
-        DEBUG_LOG("[WRAPPER:%p] Creating wrapper for filter: %s", (void*)this, filter_name_.c_str());
-        pthread_mutex_init(&filter_mutex, nullptr);
+/* options are either a timeout in seconds (legacy) or an object */
+static bool ParseExecOptions(napi_env env, napi_value value, ExecOptions* options) {
+    options->timeout_sec = global_timeout_sec;
+    options->value_input = false;
+    options->walk_limit = global_walk_limit;
+    options->output = OUTPUT_VALUE;
+    options->priority = PRIORITY_NORMAL;
+    options->timeout_ms = 0;
+    options->cancel = nullptr;
+    if (value == nullptr) {
+        return true;
     }
 
-    /* free jq and destroy mutex */
-    ~JqFilterWrapper() {
-        WRAPPER_DEBUG_LOG(this, "Destroying wrapper: %s", filter_name.c_str());
-        if (jq) {
-            WRAPPER_DEBUG_LOG(this, "Tearing down jq state");
-            jq_teardown(&jq);
-        }
-        pthread_mutex_destroy(&filter_mutex);
-        WRAPPER_DEBUG_LOG(this, "Destroyed");
-    }
-    jq_state* get_jq(){
-        return jq;
+    napi_valuetype valuetype;
+    napi_status status = napi_typeof(env, value, &valuetype);
+    if (status != napi_ok) {
+        napi_throw_error(env, nullptr, "Invalid options input");
+        return false;
     }
-    void lock(){
-        WRAPPER_DEBUG_LOG(this, "Attempting to lock mutex");
-        pthread_mutex_lock(&filter_mutex);
-        WRAPPER_DEBUG_LOG(this, "Mutex locked");
+    if (valuetype == napi_number) {
+        status = napi_get_value_uint32(env, value, &options->timeout_sec);
+        if (status != napi_ok) {
+            napi_throw_error(env, nullptr, "Invalid timeout_sec input");
+            return false;
+        }
+        return true;
     }
-    void unlock(){
-        WRAPPER_DEBUG_LOG(this, "Unlocking mutex");
-        pthread_mutex_unlock(&filter_mutex);
-        WRAPPER_DEBUG_LOG(this, "Mutex unlocked");
+    if (valuetype != napi_object) {
+        return true;
     }
-private:
-    jq_state* jq;
-    pthread_mutex_t filter_mutex;
-
-};
-
-template <class KEY_T> class LRUCache {
-private:
-    pthread_mutex_t cache_mutex;
-    std::list<JqFilterWrapper*> item_list;
-    std::unordered_map<KEY_T,  JqFilterWrapper*> item_map;
-    std::unordered_map<JqFilterWrapper*,  size_t> item_refcnt;
 
-    size_t cache_size;
-
-    void clean() {
-        pthread_mutex_lock(&cache_mutex);
-        CACHE_DEBUG_LOG(nullptr, "Starting cleanup. Current size=%zu, target=%zu", item_map.size(), cache_size);
-        if(item_map.size() < cache_size){
-            pthread_mutex_unlock(&cache_mutex);
-            return;
-        }
-        while (item_list.size() > cache_size) {
-            auto last_it = item_list.end();
-            last_it--;
-            JqFilterWrapper* wrapper = *last_it;
-            CACHE_DEBUG_LOG((void*)wrapper, "Examining wrapper: name='%s', refcnt=%zu", wrapper->filter_name.c_str(), item_refcnt[wrapper]);
-            if(item_refcnt[wrapper]>0){
-                CACHE_DEBUG_LOG((void*)wrapper, "Wrapper is busy, skipping");
-                break;
-            }
-            if(wrapper->filter_name == ""){
-                CACHE_DEBUG_LOG((void*)wrapper, "WARNING: Empty filter name found");
-            }
-            CACHE_DEBUG_LOG((void*)wrapper, "attempting to remove wrapper from cache");
-            if(item_map.find(wrapper->filter_name)->second == wrapper){
-                CACHE_DEBUG_LOG((void*)wrapper, "Removing wrapper from cache");
-                item_map.erase(wrapper->filter_name);
-            };
-            item_refcnt.erase(wrapper);
-            item_list.pop_back();
-            CACHE_DEBUG_LOG((void*)wrapper, "Deleting wrapper");
-            delete wrapper;
-
-        }
-        CACHE_DEBUG_LOG(this, "Cleanup complete. New size=%zu", item_map.size());
-        pthread_mutex_unlock(&cache_mutex);
-    }
-
-public:
-    LRUCache(int cache_size_) : cache_size(global_cache_size) {
-        pthread_mutex_init(&cache_mutex, nullptr);
-        CACHE_DEBUG_LOG(this, "Created cache with size %zu", cache_size);
-    }
-      ~LRUCache() {
-        //clear cache
-        pthread_mutex_destroy(&cache_mutex);
-    }
-    void inc_refcnt(JqFilterWrapper* val){
-        CACHE_DEBUG_LOG((void*)val, "Incrementing refcnt for wrapper:%p", (void*)val);
-        item_refcnt[val]++;
-    }
-    void dec_refcnt(JqFilterWrapper* val){
-        pthread_mutex_lock(&cache_mutex);
-        CACHE_DEBUG_LOG((void*)val, "Decrementing refcnt for wrapper:%p", (void*)val);
-        item_refcnt[val]--;
-        pthread_mutex_unlock(&cache_mutex);
-    }
-    void put(const KEY_T &key, JqFilterWrapper* val) {
-        CACHE_DEBUG_LOG((void*)val, "Putting key='%s' wrapper:%p", key.c_str(), (void*)val);
-        pthread_mutex_lock(&cache_mutex);
-        inc_refcnt(val);
-        CACHE_DEBUG_LOG((void*)val, "Got cache lock for put operation");
-
-        auto it = item_map.find(key);
-        if (it != item_map.end()) {
-            CACHE_DEBUG_LOG((void*)val, "Replacing existing entry for key='%s', old_ptr=%p , new_ptr=%p", key.c_str(), (void*)it->second, (void*)val);
-            item_map.erase(it);
-        }
-        item_list.push_front(val);
-        val->cache_pos = item_list.begin();
-
-        item_map.insert(std::make_pair(key, val));
-        CACHE_DEBUG_LOG((void*)val, "Added wrapper:%p to cache", (void*)val);
-        pthread_mutex_unlock(&cache_mutex);
-        CACHE_DEBUG_LOG((void*)val, "Released cache lock after put");
-        clean();
-    }
-
-    JqFilterWrapper* get(const KEY_T &key) {
-        pthread_mutex_lock(&cache_mutex);
-        CACHE_DEBUG_LOG(nullptr, "Got cache lock for get operation, key='%s'", key.c_str());
-
-        if(!(item_map.count(key) > 0)){
-            CACHE_DEBUG_LOG(nullptr, "Cache miss for key='%s'", key.c_str());
-            pthread_mutex_unlock(&cache_mutex);
-            return nullptr;
+    napi_value field;
+    napi_valuetype field_type;
+    napi_get_named_property(env, value, "timeoutSec", &field);
+    napi_typeof(env, field, &field_type);
+    if (field_type == napi_number) {
+        if (napi_get_value_uint32(env, field, &options->timeout_sec) != napi_ok) {
+            napi_throw_error(env, nullptr, "Invalid timeout_sec input");
+            return false;
         }
-
-        auto it = item_map.find(key);
-        JqFilterWrapper* wrapper = it->second;
-        item_list.erase(wrapper->cache_pos);
-        item_list.push_front(wrapper);
-        wrapper->cache_pos = item_list.begin();
-        inc_refcnt(wrapper);
-        CACHE_DEBUG_LOG((void*)wrapper, "Cache hit for jq wrapper,pointer=%p,name=%s,refcnt=%zu",
-                 (void*)wrapper, wrapper->filter_name.c_str(),item_refcnt[wrapper]);
-        pthread_mutex_unlock(&cache_mutex);
-        CACHE_DEBUG_LOG((void*)wrapper, "Released cache lock after get");
-        return wrapper;
-    }
-    void resize(size_t new_size) {
-        pthread_mutex_lock(&cache_mutex);
-        CACHE_DEBUG_LOG(this, "Resizing cache from %zu to %zu", cache_size, new_size);
-        cache_size = new_size;
-        pthread_mutex_unlock(&cache_mutex);
-        clean();  // Trigger cleanup if needed
     }
-};
-
-LRUCache<std::string> cache(100);
-
-std::string FromNapiString(napi_env env, napi_value value) {
-    size_t str_size;
-    size_t str_size_out;
-    napi_status status;
-    status=napi_get_value_string_utf8(env, value, nullptr, 0, &str_size);
-    if(!CheckNapiStatus(env,status,"error loading string lenth")){
-        return "";
+    napi_get_named_property(env, value, "valueInput", &field);
+    napi_typeof(env, field, &field_type);
+    if (field_type == napi_boolean) {
+        napi_get_value_bool(env, field, &options->value_input);
     }
-    char* str = new char[str_size + 1];
-    status=napi_get_value_string_utf8(env, value, str, str_size + 1, &str_size_out);
-    if(!CheckNapiStatus(env,status,"error loading string")){
-        delete[] str;
-        return "";
+    napi_get_named_property(env, value, "walkLimit", &field);
+    napi_typeof(env, field, &field_type);
+    if (field_type == napi_number) {
+        double limit;
+        napi_get_value_double(env, field, &limit);
+        options->walk_limit = limit <= 0 ? 0 : (limit >= (double)SIZE_MAX ? SIZE_MAX : static_cast<size_t>(limit));
     }
-
-    std::string result(str);
-    delete[] str;
-    return result;
-}
-
-bool jv_object_to_napi(std::string key, napi_env env, jv actual, napi_value ret,std::string& err_msg) {
-    jv_kind kind = jv_get_kind(actual);
-    napi_value value;
-    napi_status status = napi_invalid_arg;
-    switch (kind) {
-        case JV_KIND_INVALID: {
-            jv msg = jv_invalid_get_msg(jv_copy(actual));
-
-            if (jv_get_kind(msg) == JV_KIND_STRING) {
-                err_msg = std::string("jq: error: ") + jv_string_value(msg);
-                jv_free(msg);
-                return false;
-            }
-            napi_get_undefined(env, &ret);
-            return true;
-        }
-        case JV_KIND_NULL: {
-            status=napi_get_null(env, &value);
-            break;
+    /* output: "value" (default), "json" for a JSON string or "buffer" for a Buffer of JSON */
+    napi_get_named_property(env, value, "output", &field);
+    napi_typeof(env, field, &field_type);
+    if (field_type == napi_string) {
+        std::string output = FromNapiString(env, field);
+        if (output == "json") {
+            options->output = OUTPUT_JSON;
+        } else if (output == "buffer") {
+            options->output = OUTPUT_BUFFER;
+        } else if (output != "value") {
+            napi_throw_type_error(env, nullptr, "Invalid output option, expected \"value\", \"json\" or \"buffer\"");
+            return false;
         }
-        case JV_KIND_TRUE: {
-            status=napi_get_boolean(env, true, &value);
-            break;
-        }
-        case JV_KIND_FALSE: {
-            status=napi_get_boolean(env, false, &value);
-            break;
+    }
+    /* priority: "high", "normal" (default) or "low" on the dedicated worker pool */
+    napi_get_named_property(env, value, "priority", &field);
+    napi_typeof(env, field, &field_type);
+    if (field_type == napi_string) {
+        std::string priority = FromNapiString(env, field);
+        if (priority == "high") {
+            options->priority = PRIORITY_HIGH;
+        } else if (priority == "low") {
+            options->priority = PRIORITY_LOW;
+        } else if (priority != "normal") {
+            napi_throw_type_error(env, nullptr, "Invalid priority option, expected \"high\", \"normal\" or \"low\"");
+            return false;
         }
-        case JV_KIND_NUMBER: {
-            double num = jv_number_value(actual);
-            status=napi_create_double(env, num, &value);
-            break;
+    }
+    napi_get_named_property(env, value, "timeoutMs", &field);
+    napi_typeof(env, field, &field_type);
+    if (field_type == napi_number) {
+        napi_get_value_double(env, field, &options->timeout_ms);
+        if (!(options->timeout_ms > 0)) {
+            napi_throw_type_error(env, nullptr, "Invalid timeoutMs option, expected a positive number");
+            return false;
         }
-        case JV_KIND_STRING: {
-            status=napi_create_string_utf8(env, jv_string_value(actual), NAPI_AUTO_LENGTH, &value);
-            break;
+    }
+    /* cancel: a JqCancelToken from createCancelToken, for one call */
+    napi_get_named_property(env, value, "cancel", &field);
+    napi_typeof(env, field, &field_type);
+    if (field_type == napi_object) {
+        napi_value constructor;
+        bool is_token = false;
+        void* control = nullptr;
+        napi_get_reference_value(env, env_data(env)->cancel_token_constructor, &constructor);
+        if (napi_instanceof(env, field, constructor, &is_token) != napi_ok || !is_token ||
+            napi_unwrap(env, field, &control) != napi_ok) {
+            napi_throw_type_error(env, nullptr, "Invalid cancel option, expected a cancel token");
+            return false;
         }
-        case JV_KIND_ARRAY: {
-            size_t arr_len = jv_array_length(jv_copy(actual));
-            status=napi_create_array_with_length(env, arr_len, &value);
-
-            for (size_t i = 0; i < arr_len; i++) {
-                jv v = jv_array_get(jv_copy(actual), i);
-                bool success = jv_object_to_napi(std::to_string(i), env, v, value,err_msg);
-                if(!success){
-                    jv_free(v);
-                    return false;
-                }
-                jv_free(v);
-            }
-            break;
+        options->cancel = static_cast<ExecControl*>(control);
+        if (options->cancel->used) {
+            napi_throw_error(env, nullptr, "Cancel token is already used by another call");
+            return false;
         }
-        case JV_KIND_OBJECT: {
-            status=napi_create_object(env, &value);
-
-            int iter = jv_object_iter(actual);
-            while (jv_object_iter_valid(actual, iter)) {
-
-                jv obj_key = jv_object_iter_key(actual, iter);
-                jv obj_value = jv_object_iter_value(actual, iter);
+    }
+    return true;
+}
 
-                bool success = jv_object_to_napi(jv_string_value(obj_key), env, obj_value, value,err_msg);
-                if(!success){
-                    jv_free(obj_key);
-                    jv_free(obj_value);
-                    return false;
-                }
+/* bytes of a Buffer or Uint8Array argument, false if it is neither */
+static bool get_bytes(napi_env env, napi_value value, const char** data, size_t* length) {
+    bool is_typedarray = false;
+    napi_typedarray_type type;
+    napi_value arraybuffer;
+    size_t offset;
+    void* bytes;
+    if (napi_is_typedarray(env, value, &is_typedarray) != napi_ok || !is_typedarray ||
+        napi_get_typedarray_info(env, value, &type, length, &bytes, &arraybuffer, &offset) != napi_ok ||
+        type != napi_uint8_array) {
+        return false;
+    }
+    /* a detached or empty buffer has no data */
+    *data = bytes != nullptr ? static_cast<const char*>(bytes) : "";
+    return true;
+}
 
-                jv_free(obj_key);
-                jv_free(obj_value);
+/* input read on the js thread, JSON text is parsed later (on the worker for async calls).
+   JSON in a Buffer/Uint8Array is parsed in place, async callers keep it alive with hold_input */
+struct ExecInput {
+    std::string json;
+    bool has_value;
+    jv value;
+    const char* bytes;
+    size_t bytes_length;
+    napi_ref buffer_ref;
+};
 
-                iter = jv_object_iter_next(actual, iter);
-            }
-            break;
+/* read the input argument, a js value only along projection if there is one (see project_input).
+   returns false with a pending exception */
+static bool prepare_input(napi_env env, napi_value arg, const ExecOptions& options, ExecInput* input,
+                          const ProjectionNode* projection = nullptr) {
+    input->has_value = false;
+    input->bytes = nullptr;
+    input->buffer_ref = nullptr;
+    if (get_bytes(env, arg, &input->bytes, &input->bytes_length)) {
+        return true;
+    }
+    if (options.value_input) {
+        if (!input_to_jv(env, projection, arg, options.walk_limit, &input->value)) {
+            return false;
         }
-        // default:
-        //     napi_throw_error(env, nullptr, "Unsupported jv type");
-        //     break;
+        input->has_value = true;
+        return true;
+    }
+    input->json = FromNapiString(env, arg);
+    if (input->json == "") {
+        napi_throw_error(env, nullptr, "Invalid JSON input");
+        return false;
+    }
+    return true;
+}
+
+/* hand out the input as a jv, parsing it if needed. false if it isn't valid JSON */
+static bool take_input(ExecInput* input, jv* out) {
+    if (input->has_value) {
+        input->has_value = false;
+        *out = input->value;
+        return true;
     }
-    if(status != napi_ok){
-        err_msg = "error creating napi object";
+    uint64_t start = stats_now();
+    if (input->bytes != nullptr) {
+        *out = parse_json(input->bytes, input->bytes_length);
+        input->bytes = nullptr;
+    } else {
+        *out = parse_json(input->json.c_str(), input->json.size());
+    }
+    stats_record(PHASE_PARSE, start);
+    if (!jv_is_valid(*out)) {
+        jv_free(*out);
         return false;
     }
-    napi_set_named_property(env, ret, key.c_str(), value);
     return true;
 }
 
+/* keep the Buffer arg of a prepared input alive until free_input */
+static void hold_input(napi_env env, napi_value arg, ExecInput* input) {
+    if (input->bytes != nullptr) {
+        napi_create_reference(env, arg, 1, &input->buffer_ref);
+    }
+}
+
+static void free_input(napi_env env, ExecInput* input) {
+    if (input->has_value) {
+        jv_free(input->value);
+        input->has_value = false;
+    }
+    if (input->buffer_ref != nullptr) {
+        napi_delete_reference(env, input->buffer_ref);
+        input->buffer_ref = nullptr;
+    }
+}
+
 napi_value ExecSync(napi_env env, napi_callback_info info) {
-    size_t argc = 2;
-    napi_value args[2];
+    size_t argc = 3;
+    napi_value args[3];
     napi_status status;
     status=napi_get_cb_info(env, info, &argc, args, nullptr, nullptr);
     CheckNapiStatus(env,status,"Error loading info");
@@ -371,11 +294,23 @@ napi_value ExecSync(napi_env env, napi_callback_info info) {
         return nullptr;
     }
 
-    std::string json = FromNapiString(env, args[0]);
-    if(json == ""){
-        napi_throw_error(env, nullptr, "Invalid JSON input");
+    ExecOptions options;
+    if (!ParseExecOptions(env, argc > 2 ? args[2] : nullptr, &options)) {
         return nullptr;
     }
+
+    std::string json;
+    const char* bytes = nullptr;
+    size_t bytes_length = 0;
+    if (get_bytes(env, args[0], &bytes, &bytes_length)) {
+        /* parsed in place below */
+    } else if (!options.value_input) {
+        json = FromNapiString(env, args[0]);
+        if(json == ""){
+            napi_throw_error(env, nullptr, "Invalid JSON input");
+            return nullptr;
+        }
+    }
     std::string filter = FromNapiString(env, args[1]);
     if(filter == ""){
         napi_throw_error(env, nullptr, "Invalid filter input");
@@ -387,71 +322,236 @@ napi_value ExecSync(napi_env env, napi_callback_info info) {
 
     DEBUG_LOG("[SYNC] ExecSync called with filter='%s'", filter.c_str());
 
-    wrapper = cache.get(filter);
+    wrapper = get_cached_wrapper(filter, &err_msg);
     if (wrapper == nullptr) {
-        DEBUG_LOG("[SYNC] Creating new wrapper for filter='%s'", filter.c_str());
-        jq_state* jq;
-        jq = jq_init();
-        jq_set_error_cb(jq, throw_err_cb, &err_msg);
-        if (!jq_compile(jq, filter.c_str())) {
-            napi_throw_error(env, nullptr, err_msg.buf);
-            return nullptr;
-        }
-        if (jq == nullptr) {
-            napi_throw_error(env, nullptr, "Failed to initialize jq");
-            return nullptr;
-        }
-        wrapper = new JqFilterWrapper(jq, filter);
-        cache.put(filter, wrapper );
+        napi_throw_error(env, nullptr, err_msg.buf);
+        return nullptr;
     }
 
-    jv input = jv_parse(json.c_str());
-    if (!jv_is_valid(input)) {
-        jv_free(input);
-        napi_throw_error(env, nullptr, "Invalid JSON input");
-        wrapper->unlock();
-        return nullptr;
+    const SimplePath* path = wrapper->fast_path();
+    napi_valuetype input_type = napi_undefined;
+    if (path != nullptr && options.value_input && bytes == nullptr && options.walk_limit > 0) {
+        napi_typeof(env, args[0], &input_type);
     }
+    jq_state* jq = nullptr;
+    jv result;
+    uint64_t start = stats_now();
+    if (input_type == napi_object) {
+        /* walk the js object itself, only what the path ends on is converted */
+        if (!simple_path_eval_napi(env, *path, args[0], options.walk_limit, &result)) {
+            cache.dec_refcnt(wrapper);
+            return nullptr;
+        }
+        stats_record(PHASE_EXECUTE, start);
+        result = prepare_output(result, options.output);
+    } else {
+        /* a memoized result skips parsing and running, see setResultCache */
+        bool memoize = path == nullptr && wrapper->deterministic && result_cache.enabled();
+        Fingerprint fingerprint;
+        FilterResult memoized;
+        bool hit = false;
+        jv input;
+        if (options.value_input && bytes == nullptr) {
+            if (!input_to_jv(env, wrapper->projection, args[0], options.walk_limit, &input)) {
+                cache.dec_refcnt(wrapper);
+                return nullptr;
+            }
+            if (memoize) {
+                fingerprint = input_fingerprint(nullptr, 0, &input);
+                hit = result_cache.lookup(wrapper->id, options.output, fingerprint, &memoized);
+            }
+            if (hit) {
+                jv_free(input);
+            }
+        } else {
+            if (memoize) {
+                fingerprint = bytes != nullptr ? input_fingerprint(bytes, bytes_length, nullptr)
+                                               : input_fingerprint(json.c_str(), json.size(), nullptr);
+                hit = result_cache.lookup(wrapper->id, options.output, fingerprint, &memoized);
+            }
+            if (!hit) {
+                input = bytes != nullptr ? parse_json(bytes, bytes_length) : parse_json(json.c_str(), json.size());
+                stats_record(PHASE_PARSE, start);
+                if (!jv_is_valid(input)) {
+                    jv_free(input);
+                    napi_throw_error(env, nullptr, "Invalid JSON input");
+                    cache.dec_refcnt(wrapper);
+                    return nullptr;
+                }
+            }
+        }
 
-    wrapper->lock();
-    jq_set_input_cb(wrapper->get_jq(), NULL, NULL);
+        if (hit) {
+            result = memoized.is_undefined ? jv_invalid() : memoized.value;
+        } else {
+            if (path == nullptr) {
+                jq = wrapper->acquire();
+                if (jq == nullptr) {
+                    jv_free(input);
+                    napi_throw_error(env, nullptr, "Failed to initialize jq");
+                    cache.dec_refcnt(wrapper);
+                    return nullptr;
+                }
+                jq_set_input_cb(jq, NULL, NULL);
+            }
 
-    jq_start(wrapper->get_jq(), input, 0);
-    jv result = jq_next(wrapper->get_jq(), global_timeout_sec);
+            start = stats_now();
+            if (path != nullptr) {
+                result = simple_path_eval(*path, input);
+            } else {
+                wrapper->start(jq, input);
+                result = jq_next(jq, options.timeout_sec);
+            }
+            stats_record(PHASE_EXECUTE, start);
+            result = prepare_output(result, options.output);
+            if (memoize) {
+                result_cache.store(wrapper->id, options.output, fingerprint, result);
+            }
+        }
+    }
 
     napi_value ret;
     napi_create_object(env, &ret);
     std::string err_msg_conversion;
-    bool success = jv_object_to_napi("value",env,result,ret,err_msg_conversion);
+    NapiConverter conv(env, false, options.output);
+    start = stats_now();
+    bool success = jv_object_to_napi("value",conv,result,ret,err_msg_conversion);
+    stats_record(PHASE_MATERIALIZE, start);
+    jv_free(result);
+    if (jq != nullptr) {
+        wrapper->release(jq);
+    }
+    cache.dec_refcnt(wrapper);
     if(!success){
         napi_throw_error(env, nullptr, err_msg_conversion.c_str());
-        jv_free(result);
-        wrapper->unlock();
-        cache.dec_refcnt(wrapper);
         return nullptr;
     }
-
-    jv_free(result);
-    wrapper->unlock();
-    cache.dec_refcnt(wrapper);
     return ret;
 }
 
+/* what makes two execAsync calls the same: their env, filter, input and the options shaping the result */
+struct CoalesceKey {
+    napi_env env;
+    std::string filter;
+    Fingerprint input;
+    OutputFormat output;
+    unsigned int timeout_sec;
+    WorkPriority priority;
+
+    bool operator==(const CoalesceKey& other) const {
+        return env == other.env && input.a == other.input.a && input.b == other.input.b && output == other.output &&
+               timeout_sec == other.timeout_sec && priority == other.priority && filter == other.filter;
+    }
+};
+
+struct CoalesceKeyHash {
+    size_t operator()(const CoalesceKey& key) const {
+        return key.input.a ^ std::hash<std::string>()(key.filter);
+    }
+};
+
 struct AsyncWork {
-    /* input */
+    /* input, either JSON text (in json, or in place in a referenced Buffer) or an already converted jv */
     std::string json;
+    const char* bytes;
+    size_t bytes_length;
+    napi_ref buffer_ref;
+    bool has_input;
+    jv input;
     std::string filter;
+    /* the cached filter when it was found on the js thread, with a cache reference the worker takes over */
+    JqFilterWrapper* wrapper;
     unsigned int timeout_sec;
+    OutputFormat output;
+    ExecControl* control;
     /* promise */
     napi_deferred deferred;
     napi_async_work async_work;
-    /* output */
+    /* identical calls made while this one was in flight, settled with its result */
+    bool coalescing;
+    CoalesceKey key;
+    std::vector<napi_deferred> waiters;
+    /* output, result is handed over to the js thread as a jv */
     bool is_undefined;
-    std::string result;
+    jv result;
     std::string error;
     bool success;
 };
 
+/* execAsync calls in flight by key. a call identical to one in flight waits for its result instead of
+   parsing and running the filter again. calls with a cancel token or deadline and filters that aren't
+   deterministic always get work of their own. off unless setAsyncCoalescing(true), since every call
+   then fingerprints its input on the js thread */
+static std::atomic<bool> coalescing_enabled(false);
+static std::unordered_map<CoalesceKey, AsyncWork*, CoalesceKeyHash> in_flight_works;
+static pthread_mutex_t in_flight_mutex = PTHREAD_MUTEX_INITIALIZER;
+/* calls that waited on one in flight */
+static std::atomic<uint64_t> async_coalesced(0);
+
+/* add deferred to the waiters of the call in flight with work's key. returns false if there is none,
+   work is then the call in flight */
+static bool join_in_flight(AsyncWork* work, napi_deferred deferred) {
+    pthread_mutex_lock(&in_flight_mutex);
+    auto found = in_flight_works.find(work->key);
+    bool joined = found != in_flight_works.end();
+    if (joined) {
+        /* waiters are only touched on the js thread of the env, which is in the key */
+        found->second->waiters.push_back(deferred);
+    } else {
+        in_flight_works.emplace(work->key, work);
+        work->coalescing = true;
+    }
+    pthread_mutex_unlock(&in_flight_mutex);
+    if (joined) {
+        async_coalesced.fetch_add(1, std::memory_order_relaxed);
+    }
+    return joined;
+}
+
+/* no more calls join work once it completes */
+static void leave_in_flight(AsyncWork* work) {
+    if (!work->coalescing) {
+        return;
+    }
+    pthread_mutex_lock(&in_flight_mutex);
+    auto found = in_flight_works.find(work->key);
+    if (found != in_flight_works.end() && found->second == work) {
+        in_flight_works.erase(found);
+    }
+    pthread_mutex_unlock(&in_flight_mutex);
+    work->coalescing = false;
+}
+
+/* env cleanup, a worker_thread exiting or the main thread shutting down. the env's async calls can't
+   complete anymore, so its pool stops and no later call may join them */
+static void CleanupEnv(void* arg) {
+    EnvData* env_state = static_cast<EnvData*>(arg);
+    stop_worker_pool(env_state);
+    pthread_mutex_lock(&in_flight_mutex);
+    for (auto it = in_flight_works.begin(); it != in_flight_works.end();) {
+        if (it->first.env == env_state->env) {
+            it->second->coalescing = false;
+            it = in_flight_works.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    pthread_mutex_unlock(&in_flight_mutex);
+}
+
+static void FinalizeEnvData(napi_env env, void* data, void* hint) {
+    EnvData* env_state = static_cast<EnvData*>(data);
+    napi_ref* refs[] = { &env_state->filter_set_constructor, &env_state->document_constructor,
+                         &env_state->iterator_constructor, &env_state->stream_constructor,
+                         &env_state->cancel_token_constructor };
+    for (napi_ref* ref : refs) {
+        if (*ref != nullptr) {
+            napi_delete_reference(env, *ref);
+        }
+    }
+    delete env_state;
+}
+
 void ExecuteAsync(napi_env env, void* data) {
     AsyncWork* work = static_cast<AsyncWork*>(data);
     ASYNC_DEBUG_LOG(work, "ExecuteAsync started for filter='%s'", work->filter.c_str());
@@ -459,24 +559,50 @@ void ExecuteAsync(napi_env env, void* data) {
     struct err_data err_msg;
     JqFilterWrapper* wrapper;
 
-    wrapper = cache.get(work->filter);
+    wrapper = work->wrapper;
+    work->wrapper = nullptr;
+    /* aborted while queued, drop it */
+    if (const char* aborted = control_error(work->control)) {
+        work->error = aborted;
+        work->success = false;
+        if (work->has_input) {
+            jv_free(work->input);
+            work->has_input = false;
+        }
+        if (wrapper != nullptr) {
+            cache.dec_refcnt(wrapper);
+        }
+        return;
+    }
     if (wrapper == nullptr) {
-        ASYNC_DEBUG_LOG(work, "Creating new jq wrapper for filter='%s'", work->filter.c_str());
-        jq_state* jq;
-        jq = jq_init();
-        jq_set_error_cb(jq, throw_err_cb, &err_msg);
-        if (!jq_compile(jq, work->filter.c_str())) {
-            ASYNC_DEBUG_LOG(work, "jq compilation failed");
-            work->error = err_msg.buf;
-            work->success = false;
-            return;
+        wrapper = get_cached_wrapper(work->filter, &err_msg);
+    }
+    if (wrapper == nullptr) {
+        ASYNC_DEBUG_LOG(work, "jq compilation failed");
+        work->error = err_msg.buf;
+        work->success = false;
+        if (work->has_input) {
+            jv_free(work->input);
+            work->has_input = false;
         }
-        wrapper=new JqFilterWrapper(jq, work->filter);
-        cache.put(work->filter, wrapper );
+        return;
     }
 
-    jv input = jv_parse_sized(work->json.c_str(), work->json.size());
-    ASYNC_DEBUG_LOG(work, "JSON input parsed");
+    jv input;
+    if (work->has_input) {
+        input = work->input;
+        work->has_input = false;
+    } else {
+        uint64_t start = stats_now();
+        if (work->bytes != nullptr) {
+            input = parse_json(work->bytes, work->bytes_length);
+            ASYNC_DEBUG_LOG(work, "JSON input parsed from buffer");
+        } else {
+            input = parse_json(work->json.c_str(), work->json.size());
+            ASYNC_DEBUG_LOG(work, "JSON input parsed");
+        }
+        stats_record(PHASE_PARSE, start);
+    }
 
     if (!jv_is_valid(input)) {
         ASYNC_DEBUG_LOG(work, "Invalid JSON input");
@@ -484,43 +610,75 @@ void ExecuteAsync(napi_env env, void* data) {
         work->success = false;
         jv_free(input);
         cache.dec_refcnt(wrapper);
-        wrapper->unlock();
 
         return;
     }
-    wrapper->lock();
-    jq_set_input_cb(wrapper->get_jq(), NULL, NULL);
-    jq_start(wrapper->get_jq(), input, 0);
-    ASYNC_DEBUG_LOG(work, "jq execution started");
+    const SimplePath* path = wrapper->fast_path();
+    jq_state* jq = nullptr;
+    jv result;
+    if (path != nullptr) {
+        /* the input is the work's own, nothing else shares the result */
+        uint64_t start = stats_now();
+        result = simple_path_eval(*path, input);
+        stats_record(PHASE_EXECUTE, start);
+        ASYNC_DEBUG_LOG(work, "simple path evaluated");
+    } else {
+        jq = wrapper->acquire();
+        if (jq == nullptr) {
+            work->error = "Failed to initialize jq";
+            work->success = false;
+            jv_free(input);
+            cache.dec_refcnt(wrapper);
+            return;
+        }
+        jq_set_input_cb(jq, NULL, NULL);
+        uint64_t start = stats_now();
+        wrapper->start(jq, input);
+        ASYNC_DEBUG_LOG(work, "jq execution started");
 
-    jv result=jq_next(wrapper->get_jq(), work->timeout_sec);
+        if (!control_begin(work->control)) {
+            work->error = control_error(work->control);
+            work->success = false;
+            wrapper->release(jq);
+            cache.dec_refcnt(wrapper);
+            return;
+        }
+        result = jq_next(jq, control_timeout(work->control, work->timeout_sec));
+        stats_record(PHASE_EXECUTE, start);
+        if (const char* aborted = control_end(work->control, jq)) {
+            ASYNC_DEBUG_LOG(work, "jq execution aborted");
+            work->error = aborted;
+            work->success = false;
+            jv_free(result);
+            wrapper->release(jq);
+            cache.dec_refcnt(wrapper);
+            return;
+        }
+    }
     if(jv_get_kind(result) == JV_KIND_INVALID){
         jv msg = jv_invalid_get_msg(jv_copy(result));
 
         if (jv_get_kind(msg) == JV_KIND_STRING) {
             work->error = std::string("jq: error: ") + jv_string_value(msg);
-            jv_free(msg);
             work->success=false;
         }else{
             work->is_undefined = true;
             work->success=true;
         }
+        jv_free(msg);
+        jv_free(result);
     }else{
-        jv dump  = jv_dump_string(result, JV_PRINT_INVALID);
-        if(jv_is_valid(dump)){
-            work->result = jv_string_value(dump);
-            work->success = true;
-        }else{
-            ASYNC_DEBUG_LOG(work, "failed to get result");
-            work->error = "failed to get result";
-            work->success = false;
-        }
-        jv_free(dump);
+        ASYNC_DEBUG_LOG(work, "jq execution finished - got result");
+        result = prepare_output(result, work->output);
+        work->result = jq != nullptr ? jq_detach_result(jq, result) : result;
+        work->success = true;
+    }
+    if (jq != nullptr) {
+        wrapper->release(jq);
     }
-    wrapper->unlock();
     cache.dec_refcnt(wrapper);
 
-    ASYNC_DEBUG_LOG(work, "jq execution finished - got result, %s", work->result.c_str());
+    ASYNC_DEBUG_LOG(work, "jq execution finished");
 }
 
 void reject_with_error_message(napi_env env, napi_deferred deferred, std::string error_message){
@@ -534,63 +692,75 @@ void reject_with_error_message(napi_env env, napi_deferred deferred, std::string
 
 void CompleteAsync(napi_env env, napi_status status, void* data) {
     AsyncWork* work = static_cast<AsyncWork*>(data);
-   bool cleanup_done = false;
+    leave_in_flight(work);
+    /* the call and the calls that waited on it */
+    std::vector<napi_deferred> deferreds(1, work->deferred);
+    deferreds.insert(deferreds.end(), work->waiters.begin(), work->waiters.end());
 
     auto cleanup = [&]() {
-        if (!cleanup_done) {
-            napi_delete_async_work(env, work->async_work);
-            ASYNC_DEBUG_LOG(work, "Deleting AsyncWork");
-            delete work;
-            cleanup_done = true;
+        if (work->buffer_ref != nullptr) {
+            napi_delete_reference(env, work->buffer_ref);
+        }
+        /* never ran */
+        if (work->wrapper != nullptr) {
+            cache.dec_refcnt(work->wrapper);
         }
+        finish_control(work->control);
+        delete_async_work(env, work->async_work);
+        ASYNC_DEBUG_LOG(work, "Deleting AsyncWork");
+        delete work;
     };
 
     if(status != napi_ok || !work->success){
         std::string error_message = work->error;
         if(error_message == ""){
-            error_message = "Got error from async work";
+            error_message = async_status_message(status);
+        }
+        for (napi_deferred deferred : deferreds) {
+            reject_with_error_message(env, deferred, error_message);
         }
-        reject_with_error_message(env, work->deferred, error_message);
         cleanup();
         return;
     }
     napi_handle_scope scope;
     status = napi_open_handle_scope(env, &scope);
     if (status != napi_ok) {
-        reject_with_error_message(env, work->deferred, "Failed to create handle scope");
+        if (!work->is_undefined) {
+            jv_free(work->result);
+        }
+        for (napi_deferred deferred : deferreds) {
+            reject_with_error_message(env, deferred, "Failed to create handle scope");
+        }
         cleanup();
         return;
     }
 
+    /* keep what a JSON round trip used to give: nan as null, infinities clamped */
+    NapiConverter conv(env, true, work->output);
+    for (napi_deferred deferred : deferreds) {
+        /* every caller gets a result of its own */
         napi_value ret;
+        napi_create_object(env, &ret);
 
-        status=napi_create_object(env, &ret);
-
-        jv result_jv;
-        if(work->is_undefined){
-            result_jv = jv_invalid();
-        }else{
-            result_jv= jv_parse(work->result.c_str());
-        }
         std::string err_msg_conversion;
-        bool success = jv_object_to_napi("value", env, result_jv, ret,err_msg_conversion);
-        jv_free(result_jv);
+        uint64_t start = stats_now();
+        bool success = jv_object_to_napi("value", conv, work->is_undefined ? jv_invalid() : work->result, ret, err_msg_conversion);
+        stats_record(PHASE_MATERIALIZE, start);
 
         if(!success){
-            reject_with_error_message(env, work->deferred, err_msg_conversion);
-            napi_close_handle_scope(env, scope);
-            return;
+            reject_with_error_message(env, deferred, err_msg_conversion);
+        } else {
+            napi_resolve_deferred(env, deferred, ret);
         }
-        napi_resolve_deferred(env, work->deferred, ret);
+    }
+    if (!work->is_undefined) {
+        jv_free(work->result);
+    }
     cleanup();
     napi_close_handle_scope(env, scope);
 }
 
-
-
 napi_value ExecAsync(napi_env env, napi_callback_info info) {
-    napi_handle_scope scope;
-
     size_t argc = 3;
     napi_value args[3];
     napi_value promise;
@@ -602,79 +772,2254 @@ napi_value ExecAsync(napi_env env, napi_callback_info info) {
         return nullptr;
     }
 
-    AsyncWork* work = new AsyncWork();
-    work->json = FromNapiString(env, args[0]);
-    if(work->json == ""){
-        napi_throw_error(env, nullptr, "Invalid JSON input");
+    ExecOptions options;
+    if (!ParseExecOptions(env, argc > 2 ? args[2] : nullptr, &options)) {
         return nullptr;
     }
+
+    AsyncWork* work = new AsyncWork();
+    work->has_input = false;
+    work->wrapper = nullptr;
+    work->coalescing = false;
+    if (get_bytes(env, args[0], &work->bytes, &work->bytes_length)) {
+        /* parsed in place on the worker */
+    } else if (!options.value_input) {
+        work->json = FromNapiString(env, args[0]);
+        if(work->json == ""){
+            napi_throw_error(env, nullptr, "Invalid JSON input");
+            delete work;
+            return nullptr;
+        }
+    }
     work->filter = FromNapiString(env, args[1]);
     if(work->filter == ""){
         napi_throw_error(env, nullptr, "Invalid filter input");
+        delete work;
         return nullptr;
     }
-
-    work->timeout_sec = global_timeout_sec;
-    if(argc > 2){
-      napi_valuetype valuetype;
-      napi_status status = napi_typeof(env, args[2], &valuetype);
-      if(status != napi_ok){
-        napi_throw_error(env, nullptr, "Invalid timeout_sec input");
-        return nullptr;
-      }
-      if(valuetype == napi_number){
-        status = napi_get_value_uint32(env, args[2], &work->timeout_sec);
-        if (status != napi_ok) {
-          napi_throw_error(env, nullptr, "Invalid timeout_sec input");
-          return nullptr;
+    if (options.value_input && work->bytes == nullptr) {
+        /* convert on the js thread, the worker only runs the filter. a filter already cached tells what
+           to convert, one that isn't is compiled on the worker and gets the whole input */
+        work->wrapper = cache.get(work->filter, FilterCache::hash(work->filter), false);
+        if (!input_to_jv(env, work->wrapper != nullptr ? work->wrapper->projection : nullptr, args[0],
+                         options.walk_limit, &work->input)) {
+            if (work->wrapper != nullptr) {
+                cache.dec_refcnt(work->wrapper);
+            }
+            delete work;
+            return nullptr;
         }
-      }
+        work->has_input = true;
     }
-    work->success = false;
 
     napi_create_promise(env, &work->deferred, &promise);
+    /* a call that can't be cancelled on its own may share the work of an identical one in flight */
+    if (coalescing_enabled.load(std::memory_order_relaxed) && options.cancel == nullptr && options.timeout_ms == 0 &&
+        (work->wrapper != nullptr ? work->wrapper->deterministic : filter_is_deterministic(work->filter))) {
+        if (work->has_input) {
+            work->key.input = input_fingerprint(nullptr, 0, &work->input);
+        } else if (work->bytes != nullptr) {
+            work->key.input = input_fingerprint(work->bytes, work->bytes_length, nullptr);
+        } else {
+            work->key.input = input_fingerprint(work->json.data(), work->json.size(), nullptr);
+        }
+        work->key.env = env;
+        work->key.filter = work->filter;
+        work->key.output = options.output;
+        work->key.timeout_sec = options.timeout_sec;
+        work->key.priority = options.priority;
+        if (join_in_flight(work, work->deferred)) {
+            if (work->has_input) {
+                jv_free(work->input);
+            }
+            if (work->wrapper != nullptr) {
+                cache.dec_refcnt(work->wrapper);
+            }
+            delete work;
+            return promise;
+        }
+    }
 
-    napi_value resource_name;
-    napi_create_string_utf8(env, "ExecAsync", NAPI_AUTO_LENGTH, &resource_name);
+    if (work->bytes != nullptr) {
+        /* keep the buffer alive until the worker is done with it */
+        napi_create_reference(env, args[0], 1, &work->buffer_ref);
+    }
+    work->timeout_sec = options.timeout_sec;
+    work->output = options.output;
+    work->control = start_control(options.cancel, options.timeout_ms);
+    work->success = false;
 
-    napi_create_async_work(env, nullptr, resource_name, ExecuteAsync, CompleteAsync, work, &work->async_work);
-    napi_queue_async_work(env, work->async_work);
+    queue_async_work(env, "ExecAsync", ExecuteAsync, CompleteAsync, work, &work->async_work, options.priority);
 
     return promise;
 }
 
-// napi_value SetDebugMode(napi_env env, napi_callback_info info) {
-//     size_t argc = 1;
-//     napi_value args[1];
-//     bool enable;
-
-//     napi_get_cb_info(env, info, &argc, args, nullptr, nullptr);
+/* the first output jq returned (consumed) as result */
+static void set_first_output(jv value, OutputFormat output, FilterResult* result) {
+    result->is_undefined = false;
+    if (jv_get_kind(value) == JV_KIND_INVALID) {
+        jv msg = jv_invalid_get_msg(jv_copy(value));
+        if (jv_get_kind(msg) == JV_KIND_STRING) {
+            result->error = std::string("jq: error: ") + jv_string_value(msg);
+            result->success = false;
+        } else {
+            result->is_undefined = true;
+            result->success = true;
+        }
+        jv_free(msg);
+        jv_free(value);
+        result->value = jv_invalid();
+        return;
+    }
+    result->success = true;
+    result->value = prepare_output(value, output);
+}
 
-//     if (argc < 1) {
-//         napi_throw_type_error(env, nullptr, "Wrong number of arguments");
-//         return nullptr;
-//     }
+/* read the first output of a started jq into result, failing it if control (may be null) aborts the call */
+static void take_first_output(jq_state* jq, unsigned int timeout_sec, OutputFormat output, ExecControl* control,
+                              FilterResult* result) {
+    result->is_undefined = false;
+    if (!control_begin(control)) {
+        result->success = false;
+        result->error = control_error(control);
+        result->value = jv_invalid();
+        return;
+    }
+    uint64_t start = stats_now();
+    jv value = jq_next(jq, control_timeout(control, timeout_sec));
+    stats_record(PHASE_EXECUTE, start);
+    if (const char* aborted = control_end(control, jq)) {
+        jv_free(value);
+        result->success = false;
+        result->error = aborted;
+        result->value = jv_invalid();
+        return;
+    }
+    set_first_output(value, output, result);
+}
 
-//     napi_get_value_bool(env, args[0], &enable);
-//     debug_enabled = enable;
-//     DEBUG_LOG("Debug mode %s", enable ? "enabled" : "disabled");
+/* run a simple path on input (consumed) into result, the fast path of take_first_output */
+static void take_simple_output(const SimplePath& path, jv input, OutputFormat output, FilterResult* result) {
+    uint64_t start = stats_now();
+    jv value = simple_path_eval(path, input);
+    stats_record(PHASE_EXECUTE, start);
+    set_first_output(value, output, result);
+}
 
-//     napi_value result;
-//     napi_get_boolean(env, debug_enabled, &result);
-//     return result;
-// }
+/* {value} or {error} object for one result of a multi filter call, frees the result value */
+static napi_value filter_result_to_napi(NapiConverter& conv, FilterResult* result) {
+    napi_env env = conv.env;
+    napi_value ret;
+    napi_create_object(env, &ret);
+    std::string err_msg = result->error;
+    bool success = result->success;
+    if (success && !result->is_undefined) {
+        uint64_t start = stats_now();
+        success = jv_object_to_napi("value", conv, result->value, ret, err_msg);
+        stats_record(PHASE_MATERIALIZE, start);
+    }
+    jv_free(result->value);
+    result->value = jv_invalid();
+    if (!success) {
+        napi_value error;
+        napi_create_string_utf8(env, err_msg.c_str(), NAPI_AUTO_LENGTH, &error);
+        napi_set_named_property(env, ret, "error", error);
+    }
+    return ret;
+}
+
+/* one filter of a multi filter call, wrapper is null when compiling failed */
+struct FilterEntry {
+    std::string filter;
+    JqFilterWrapper* wrapper;
+    std::string error;
+};
+
+/* run every entry on input (not consumed) and put the result in results */
+static void run_entries(std::vector<FilterEntry>& entries, jv input, unsigned int timeout_sec, OutputFormat output,
+                        ExecControl* control, bool detach, std::vector<FilterResult>& results) {
+    results.resize(entries.size());
+    for (size_t i = 0; i < entries.size(); i++) {
+        FilterEntry& entry = entries[i];
+        FilterResult& result = results[i];
+        result.value = jv_invalid();
+        if (entry.wrapper == nullptr) {
+            result.success = false;
+            result.error = entry.error;
+            continue;
+        }
+        if (const SimplePath* path = entry.wrapper->fast_path()) {
+            take_simple_output(*path, jv_copy(input), output, &result);
+            /* the result may be part of the input, which the next entries and other threads (for a document) use */
+            if (detach && result.success && !result.is_undefined) {
+                result.value = jv_detach(result.value);
+            }
+            continue;
+        }
+        jq_state* jq = entry.wrapper->acquire();
+        if (jq == nullptr) {
+            result.success = false;
+            result.error = "Failed to initialize jq";
+            continue;
+        }
+        jq_set_input_cb(jq, NULL, NULL);
+        entry.wrapper->start(jq, jv_copy(input));
+        take_first_output(jq, timeout_sec, output, control, &result);
+        if (detach && result.success && !result.is_undefined) {
+            result.value = jq_detach_result(jq, result.value);
+        } else {
+            /* the input is still used by the next entries, don't leave it referenced by the state */
+            jq_start(jq, jv_null(), 0);
+        }
+        entry.wrapper->release(jq);
+    }
+}
+
+/* read an array of filter strings */
+static bool read_filters(napi_env env, napi_value value, std::vector<std::string>* filters) {
+    bool is_array;
+    uint32_t len;
+    if (napi_is_array(env, value, &is_array) != napi_ok || !is_array) {
+        napi_throw_type_error(env, nullptr, "Filters must be an array of strings");
+        return false;
+    }
+    napi_get_array_length(env, value, &len);
+    filters->reserve(len);
+    for (uint32_t i = 0; i < len; i++) {
+        napi_value element;
+        napi_valuetype type;
+        napi_get_element(env, value, i, &element);
+        napi_typeof(env, element, &type);
+        /* a non string filter fails on its own, like in execSync */
+        filters->push_back(type == napi_string ? FromNapiString(env, element) : std::string());
+    }
+    return true;
+}
+
+/* look up (or compile) each filter in the cache, every entry with a wrapper holds a cache reference */
+static void lookup_entries(const std::vector<std::string>& filters, std::vector<FilterEntry>& entries) {
+    entries.resize(filters.size());
+    for (size_t i = 0; i < filters.size(); i++) {
+        entries[i].filter = filters[i];
+        entries[i].wrapper = nullptr;
+        if (filters[i] == "") {
+            entries[i].error = "Invalid filter input";
+            continue;
+        }
+        struct err_data err_msg;
+        entries[i].wrapper = get_cached_wrapper(filters[i], &err_msg);
+        if (entries[i].wrapper == nullptr) {
+            entries[i].error = err_msg.buf;
+        }
+    }
+}
+
+/* what any of the entries reads of the input, null if one may read all of it */
+static ProjectionNode* entries_projection(const std::vector<FilterEntry>& entries) {
+    ProjectionNode* projection = new ProjectionNode{"", false, {}};
+    for (const FilterEntry& entry : entries) {
+        if (entry.wrapper == nullptr) {
+            continue;
+        }
+        if (entry.wrapper->projection == nullptr) {
+            delete projection;
+            return nullptr;
+        }
+        projection_merge(projection, *entry.wrapper->projection);
+    }
+    return projection;
+}
+
+static void release_entries(std::vector<FilterEntry>& entries) {
+    for (FilterEntry& entry : entries) {
+        if (entry.wrapper != nullptr) {
+            cache.dec_refcnt(entry.wrapper);
+            entry.wrapper = nullptr;
+        }
+    }
+}
+
+/* run entries on the js thread, converting each result while its state is still checked out. with memoize,
+   results of deterministic entries go through the result cache */
+static napi_value exec_entries_sync(napi_env env, std::vector<FilterEntry>& entries, jv input, const ExecOptions& options,
+                                    bool memoize = false) {
+    napi_value ret;
+    NapiConverter conv(env, false, options.output);
+    napi_create_array_with_length(env, entries.size(), &ret);
+    /* taken once the first entry the result cache may hold is reached */
+    Fingerprint fingerprint;
+    bool fingerprinted = false;
+    for (size_t i = 0; i < entries.size(); i++) {
+        FilterResult result;
+        result.success = false;
+        result.is_undefined = false;
+        result.value = jv_invalid();
+        JqFilterWrapper* wrapper = entries[i].wrapper;
+        const SimplePath* path = wrapper != nullptr ? wrapper->fast_path() : nullptr;
+        if (path != nullptr) {
+            take_simple_output(*path, jv_copy(input), options.output, &result);
+            napi_set_element(env, ret, i, filter_result_to_napi(conv, &result));
+            continue;
+        }
+        bool memoized = memoize && wrapper != nullptr && wrapper->deterministic && result_cache.enabled();
+        if (memoized && !fingerprinted) {
+            fingerprint = input_fingerprint(nullptr, 0, &input);
+            fingerprinted = true;
+        }
+        if (memoized && result_cache.lookup(wrapper->id, options.output, fingerprint, &result)) {
+            napi_set_element(env, ret, i, filter_result_to_napi(conv, &result));
+            continue;
+        }
+        jq_state* jq = wrapper != nullptr ? wrapper->acquire() : nullptr;
+        if (jq == nullptr) {
+            result.error = wrapper != nullptr ? "Failed to initialize jq" : entries[i].error;
+            napi_set_element(env, ret, i, filter_result_to_napi(conv, &result));
+            continue;
+        }
+        jq_set_input_cb(jq, NULL, NULL);
+        wrapper->start(jq, jv_copy(input));
+        take_first_output(jq, options.timeout_sec, options.output, nullptr, &result);
+        if (memoized && result.success) {
+            result_cache.store(wrapper->id, options.output, fingerprint, result.is_undefined ? jv_invalid() : result.value);
+        }
+        napi_set_element(env, ret, i, filter_result_to_napi(conv, &result));
+        jq_start(jq, jv_null(), 0);
+        wrapper->release(jq);
+    }
+    return ret;
+}
+
+/* run entries that are all simple paths on the js object arg without converting it, like
+   exec_entries_sync. false if an entry needs the VM or arg isn't a js object to walk. true with *ret
+   null if a value couldn't be converted, the exception is pending */
+static bool exec_paths_on_value(napi_env env, std::vector<FilterEntry>& entries, napi_value arg,
+                                const ExecOptions& options, napi_value* ret) {
+    napi_valuetype type = napi_undefined;
+    const char* bytes;
+    size_t bytes_length;
+    *ret = nullptr;
+    if (!options.value_input || options.walk_limit == 0 || get_bytes(env, arg, &bytes, &bytes_length) ||
+        napi_typeof(env, arg, &type) != napi_ok || type != napi_object) {
+        return false;
+    }
+    std::vector<const SimplePath*> paths(entries.size(), nullptr);
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (entries[i].wrapper != nullptr && (paths[i] = entries[i].wrapper->fast_path()) == nullptr) {
+            return false;
+        }
+    }
+    napi_value results;
+    NapiConverter conv(env, false, options.output);
+    napi_create_array_with_length(env, entries.size(), &results);
+    for (size_t i = 0; i < entries.size(); i++) {
+        FilterResult result;
+        result.success = false;
+        result.is_undefined = false;
+        result.value = jv_invalid();
+        if (paths[i] == nullptr) {
+            result.error = entries[i].error;
+        } else {
+            jv value;
+            uint64_t start = stats_now();
+            if (!simple_path_eval_napi(env, *paths[i], arg, options.walk_limit, &value)) {
+                return true;
+            }
+            stats_record(PHASE_EXECUTE, start);
+            set_first_output(value, options.output, &result);
+        }
+        napi_set_element(env, results, i, filter_result_to_napi(conv, &result));
+    }
+    *ret = results;
+    return true;
+}
+
+/* filters compiled once by compileFilters, owned by the js object wrapping them */
+struct FilterSet {
+    std::vector<FilterEntry> entries;
+    /* what the filters read of an input, see entries_projection */
+    ProjectionNode* projection;
+    ~FilterSet() {
+        for (FilterEntry& entry : entries) {
+            delete entry.wrapper;
+        }
+        delete projection;
+    }
+};
+
+/* input converted once by createDocument and shared by every filter run on it.
+   jv refcounts aren't atomic, so the master copy is only touched under master_mutex: by runs on
+   the js thread and to deep copy it into replicas. async runs check out a replica of their own */
+struct Document {
+    jv master;
+    pthread_mutex_t master_mutex;
+    std::vector<jv> idle_replicas;
+    size_t total_replicas;
+    pthread_mutex_t replica_mutex;
+    pthread_cond_t replica_cond;
+
+    explicit Document(jv value) : master(value), total_replicas(0) {
+        pthread_mutex_init(&master_mutex, nullptr);
+        pthread_mutex_init(&replica_mutex, nullptr);
+        pthread_cond_init(&replica_cond, nullptr);
+    }
+
+    ~Document() {
+        jv_free(master);
+        for (jv replica : idle_replicas) {
+            jv_free(replica);
+        }
+        pthread_mutex_destroy(&master_mutex);
+        pthread_mutex_destroy(&replica_mutex);
+        pthread_cond_destroy(&replica_cond);
+    }
+
+    jv lock_master() {
+        pthread_mutex_lock(&master_mutex);
+        return master;
+    }
+
+    void unlock_master() {
+        pthread_mutex_unlock(&master_mutex);
+    }
+
+    /* check out a replica, copying the master up to get_pool_size() replicas before blocking */
+    jv acquire_replica() {
+        pthread_mutex_lock(&replica_mutex);
+        while (idle_replicas.empty()) {
+            if (total_replicas < get_pool_size()) {
+                total_replicas++;
+                pthread_mutex_unlock(&replica_mutex);
+                jv replica = jv_deep_copy(jv_copy(lock_master()));
+                unlock_master();
+                return replica;
+            }
+            pthread_cond_wait(&replica_cond, &replica_mutex);
+        }
+        jv replica = idle_replicas.back();
+        idle_replicas.pop_back();
+        pthread_mutex_unlock(&replica_mutex);
+        return replica;
+    }
+
+    void release_replica(jv replica) {
+        pthread_mutex_lock(&replica_mutex);
+        idle_replicas.push_back(replica);
+        pthread_cond_signal(&replica_cond);
+        pthread_mutex_unlock(&replica_mutex);
+    }
+};
+
+struct AsyncManyWork {
+    /* input */
+    ExecInput input;
+    std::vector<std::string> filters;
+    FilterSet* set;
+    Document* doc;
+    /* keeps the set or document alive until the work is done */
+    napi_ref owner_ref;
+    unsigned int timeout_sec;
+    OutputFormat output;
+    WorkPriority priority;
+    ExecControl* control;
+    /* promise */
+    napi_deferred deferred;
+    napi_async_work async_work;
+    /* output */
+    std::vector<FilterResult> results;
+    std::string error;
+    bool success;
+};
+
+void ExecuteManyAsync(napi_env env, void* data) {
+    AsyncManyWork* work = static_cast<AsyncManyWork*>(data);
+    ASYNC_DEBUG_LOG(work, "ExecuteManyAsync started for %zu filters", work->set ? work->set->entries.size() : work->filters.size());
+
+    if (const char* aborted = control_error(work->control)) {
+        work->error = aborted;
+        work->success = false;
+        return;
+    }
+    jv input;
+    if (work->doc != nullptr) {
+        input = work->doc->acquire_replica();
+    } else if (!take_input(&work->input, &input)) {
+        work->error = "Invalid JSON input";
+        work->success = false;
+        return;
+    }
+    if (work->set != nullptr) {
+        run_entries(work->set->entries, input, work->timeout_sec, work->output, work->control, true, work->results);
+    } else {
+        std::vector<FilterEntry> entries;
+        lookup_entries(work->filters, entries);
+        run_entries(entries, input, work->timeout_sec, work->output, work->control, true, work->results);
+        release_entries(entries);
+    }
+    /* results are detached, nothing else references the replica */
+    if (work->doc != nullptr) {
+        work->doc->release_replica(input);
+    } else {
+        jv_free(input);
+    }
+    /* an abort fails the whole call, not just the filters it stopped */
+    if (const char* aborted = control_error(work->control)) {
+        work->error = aborted;
+        work->success = false;
+        return;
+    }
+    work->success = true;
+}
+
+void CompleteManyAsync(napi_env env, napi_status status, void* data) {
+    AsyncManyWork* work = static_cast<AsyncManyWork*>(data);
+
+    if (status != napi_ok || !work->success) {
+        reject_with_error_message(env, work->deferred, work->error == "" ? async_status_message(status) : work->error);
+    } else {
+        napi_handle_scope scope;
+        napi_open_handle_scope(env, &scope);
+        napi_value ret;
+        /* keep what a JSON round trip used to give, like CompleteAsync */
+        NapiConverter conv(env, true, work->output);
+        napi_create_array_with_length(env, work->results.size(), &ret);
+        for (size_t i = 0; i < work->results.size(); i++) {
+            napi_set_element(env, ret, i, filter_result_to_napi(conv, &work->results[i]));
+        }
+        napi_resolve_deferred(env, work->deferred, ret);
+        napi_close_handle_scope(env, scope);
+    }
+
+    for (FilterResult& result : work->results) {
+        jv_free(result.value);
+    }
+    free_input(env, &work->input);
+    if (work->owner_ref != nullptr) {
+        napi_delete_reference(env, work->owner_ref);
+    }
+    finish_control(work->control);
+    delete_async_work(env, work->async_work);
+    ASYNC_DEBUG_LOG(work, "Deleting AsyncManyWork");
+    delete work;
+}
+
+/* queue work for the filters (or set) on input, returns the promise */
+static napi_value queue_many_async(napi_env env, AsyncManyWork* work) {
+    napi_value promise;
+    work->success = false;
+    napi_create_promise(env, &work->deferred, &promise);
+    queue_async_work(env, "ExecManyAsync", ExecuteManyAsync, CompleteManyAsync, work, &work->async_work, work->priority);
+    return promise;
+}
+
+/* execMany(input, filters, options) - run several cached filters on one input */
+napi_value ExecMany(napi_env env, napi_callback_info info) {
+    size_t argc = 3;
+    napi_value args[3];
+    napi_get_cb_info(env, info, &argc, args, nullptr, nullptr);
+    if (argc < 2) {
+        napi_throw_type_error(env, nullptr, "Wrong number of arguments. Expected 2.");
+        return nullptr;
+    }
+
+    ExecOptions options;
+    std::vector<std::string> filters;
+    if (!ParseExecOptions(env, argc > 2 ? args[2] : nullptr, &options) || !read_filters(env, args[1], &filters)) {
+        return nullptr;
+    }
+    std::vector<FilterEntry> entries;
+    napi_value ret;
+    lookup_entries(filters, entries);
+    if (exec_paths_on_value(env, entries, args[0], options, &ret)) {
+        release_entries(entries);
+        return ret;
+    }
+    ExecInput exec_input;
+    jv input;
+    ProjectionNode* projection = entries_projection(entries);
+    bool prepared = prepare_input(env, args[0], options, &exec_input, projection);
+    delete projection;
+    if (!prepared) {
+        release_entries(entries);
+        return nullptr;
+    }
+    if (!take_input(&exec_input, &input)) {
+        release_entries(entries);
+        napi_throw_error(env, nullptr, "Invalid JSON input");
+        return nullptr;
+    }
+
+    ret = exec_entries_sync(env, entries, input, options, true);
+    release_entries(entries);
+    jv_free(input);
+    return ret;
+}
+
+/* execManyAsync(input, filters, options) */
+napi_value ExecManyAsync(napi_env env, napi_callback_info info) {
+    size_t argc = 3;
+    napi_value args[3];
+    napi_get_cb_info(env, info, &argc, args, nullptr, nullptr);
+    if (argc < 2) {
+        napi_throw_type_error(env, nullptr, "Wrong number of arguments. Expected 2.");
+        return nullptr;
+    }
+
+    ExecOptions options;
+    AsyncManyWork* work = new AsyncManyWork();
+    if (!ParseExecOptions(env, argc > 2 ? args[2] : nullptr, &options) ||
+        !read_filters(env, args[1], &work->filters) ||
+        !prepare_input(env, args[0], options, &work->input)) {
+        delete work;
+        return nullptr;
+    }
+    hold_input(env, args[0], &work->input);
+    work->timeout_sec = options.timeout_sec;
+    work->output = options.output;
+    work->priority = options.priority;
+    work->control = start_control(options.cancel, options.timeout_ms);
+    return queue_many_async(env, work);
+}
+
+/* native object wrapped by the this of a method of the class in constructor_ref */
+static void* unwrap_this(napi_env env, napi_callback_info info, napi_ref constructor_ref, size_t* argc, napi_value* args, napi_value* this_arg) {
+    napi_value constructor;
+    bool is_instance = false;
+    void* object = nullptr;
+    napi_get_cb_info(env, info, argc, args, this_arg, nullptr);
+    napi_get_reference_value(env, constructor_ref, &constructor);
+    if (napi_instanceof(env, *this_arg, constructor, &is_instance) != napi_ok || !is_instance ||
+        napi_unwrap(env, *this_arg, &object) != napi_ok) {
+        napi_throw_type_error(env, nullptr, "Illegal invocation");
+        return nullptr;
+    }
+    return object;
+}
+
+static FilterSet* unwrap_filter_set(napi_env env, napi_callback_info info, size_t* argc, napi_value* args, napi_value* this_arg) {
+    return static_cast<FilterSet*>(unwrap_this(env, info, env_data(env)->filter_set_constructor, argc, args, this_arg));
+}
+
+/* FilterSet.exec(input, options) */
+napi_value FilterSetExec(napi_env env, napi_callback_info info) {
+    size_t argc = 2;
+    napi_value args[2], this_arg;
+    FilterSet* set = unwrap_filter_set(env, info, &argc, args, &this_arg);
+    if (set == nullptr) {
+        return nullptr;
+    }
+    if (argc < 1) {
+        napi_throw_type_error(env, nullptr, "Wrong number of arguments. Expected 1.");
+        return nullptr;
+    }
+
+    ExecOptions options;
+    if (!ParseExecOptions(env, argc > 1 ? args[1] : nullptr, &options)) {
+        return nullptr;
+    }
+    napi_value ret;
+    if (exec_paths_on_value(env, set->entries, args[0], options, &ret)) {
+        return ret;
+    }
+    ExecInput exec_input;
+    jv input;
+    if (!prepare_input(env, args[0], options, &exec_input, set->projection)) {
+        return nullptr;
+    }
+    if (!take_input(&exec_input, &input)) {
+        napi_throw_error(env, nullptr, "Invalid JSON input");
+        return nullptr;
+    }
+    ret = exec_entries_sync(env, set->entries, input, options, true);
+    jv_free(input);
+    return ret;
+}
+
+/* FilterSet.execAsync(input, options) */
+napi_value FilterSetExecAsync(napi_env env, napi_callback_info info) {
+    size_t argc = 2;
+    napi_value args[2], this_arg;
+    FilterSet* set = unwrap_filter_set(env, info, &argc, args, &this_arg);
+    if (set == nullptr) {
+        return nullptr;
+    }
+    if (argc < 1) {
+        napi_throw_type_error(env, nullptr, "Wrong number of arguments. Expected 1.");
+        return nullptr;
+    }
+
+    ExecOptions options;
+    AsyncManyWork* work = new AsyncManyWork();
+    if (!ParseExecOptions(env, argc > 1 ? args[1] : nullptr, &options) ||
+        !prepare_input(env, args[0], options, &work->input, set->projection)) {
+        delete work;
+        return nullptr;
+    }
+    hold_input(env, args[0], &work->input);
+    work->set = set;
+    napi_create_reference(env, this_arg, 1, &work->owner_ref);
+    work->timeout_sec = options.timeout_sec;
+    work->output = options.output;
+    work->priority = options.priority;
+    work->control = start_control(options.cancel, options.timeout_ms);
+    return queue_many_async(env, work);
+}
+
+static void FinalizeFilterSet(napi_env env, void* data, void* hint) {
+    delete static_cast<FilterSet*>(data);
+}
+
+/* constructor of the native classes, only reachable from the functions creating them, which pass the
+   native object as an external. the class data is the finalizer deleting it */
+napi_value WrapExternalConstructor(napi_env env, napi_callback_info info) {
+    size_t argc = 1;
+    napi_value args[1], this_arg;
+    napi_valuetype type = napi_undefined;
+    void* object = nullptr;
+    void* finalize = nullptr;
+    napi_get_cb_info(env, info, &argc, args, &this_arg, &finalize);
+    if (argc > 0) {
+        napi_typeof(env, args[0], &type);
+    }
+    if (type != napi_external) {
+        napi_throw_type_error(env, nullptr, "Illegal constructor");
+        return nullptr;
+    }
+    napi_get_value_external(env, args[0], &object);
+    napi_wrap(env, this_arg, object, reinterpret_cast<napi_finalize>(finalize), nullptr, nullptr);
+    return this_arg;
+}
+
+/* instance of the class in constructor_ref wrapping object, null with a pending exception on failure */
+static napi_value new_wrapped_instance(napi_env env, napi_ref constructor_ref, void* object) {
+    napi_value constructor, external, instance;
+    napi_get_reference_value(env, constructor_ref, &constructor);
+    napi_create_external(env, object, nullptr, nullptr, &external);
+    if (napi_new_instance(env, constructor, 1, &external, &instance) != napi_ok) {
+        return nullptr;
+    }
+    return instance;
+}
+
+/* compileFilters(filters) - compile filters once into a set that owns its states, outside of the cache */
+napi_value CompileFilters(napi_env env, napi_callback_info info) {
+    size_t argc = 1;
+    napi_value args[1];
+    napi_get_cb_info(env, info, &argc, args, nullptr, nullptr);
+    if (argc < 1) {
+        napi_throw_type_error(env, nullptr, "Wrong number of arguments. Expected 1.");
+        return nullptr;
+    }
+
+    std::vector<std::string> filters;
+    if (!read_filters(env, args[0], &filters)) {
+        return nullptr;
+    }
+    FilterSet* set = new FilterSet();
+    set->entries.resize(filters.size());
+    for (size_t i = 0; i < filters.size(); i++) {
+        FilterEntry& entry = set->entries[i];
+        entry.filter = filters[i];
+        entry.wrapper = nullptr;
+        if (filters[i] == "") {
+            entry.error = "Invalid filter input";
+            continue;
+        }
+        struct err_data err_msg;
+        entry.wrapper = new_filter_wrapper(filters[i], &err_msg);
+        if (entry.wrapper == nullptr) {
+            entry.error = err_msg.buf;
+        }
+    }
+    set->projection = entries_projection(set->entries);
+
+    napi_value instance = new_wrapped_instance(env, env_data(env)->filter_set_constructor, set);
+    if (instance == nullptr) {
+        delete set;
+    }
+    return instance;
+}
+
+static void FinalizeDocument(napi_env env, void* data, void* hint) {
+    delete static_cast<Document*>(data);
+}
+
+/* createDocument(input, options) - convert an input once to run many filters on it */
+napi_value CreateDocument(napi_env env, napi_callback_info info) {
+    size_t argc = 2;
+    napi_value args[2];
+    napi_get_cb_info(env, info, &argc, args, nullptr, nullptr);
+    if (argc < 1) {
+        napi_throw_type_error(env, nullptr, "Wrong number of arguments. Expected 1.");
+        return nullptr;
+    }
+
+    ExecOptions options;
+    ExecInput exec_input;
+    jv input;
+    if (!ParseExecOptions(env, argc > 1 ? args[1] : nullptr, &options) ||
+        !prepare_input(env, args[0], options, &exec_input)) {
+        return nullptr;
+    }
+    if (!take_input(&exec_input, &input)) {
+        napi_throw_error(env, nullptr, "Invalid JSON input");
+        return nullptr;
+    }
+    Document* doc = new Document(input);
+    napi_value instance = new_wrapped_instance(env, env_data(env)->document_constructor, doc);
+    if (instance == nullptr) {
+        delete doc;
+    }
+    return instance;
+}
+
+/* Document.execMany(filters, options) */
+napi_value DocumentExecMany(napi_env env, napi_callback_info info) {
+    size_t argc = 2;
+    napi_value args[2], this_arg;
+    Document* doc = static_cast<Document*>(unwrap_this(env, info, env_data(env)->document_constructor, &argc, args, &this_arg));
+    if (doc == nullptr) {
+        return nullptr;
+    }
+    if (argc < 1) {
+        napi_throw_type_error(env, nullptr, "Wrong number of arguments. Expected 1.");
+        return nullptr;
+    }
+
+    ExecOptions options;
+    std::vector<std::string> filters;
+    if (!ParseExecOptions(env, argc > 1 ? args[1] : nullptr, &options) || !read_filters(env, args[0], &filters)) {
+        return nullptr;
+    }
+    std::vector<FilterEntry> entries;
+    lookup_entries(filters, entries);
+    napi_value ret = exec_entries_sync(env, entries, doc->lock_master(), options);
+    doc->unlock_master();
+    release_entries(entries);
+    return ret;
+}
+
+/* Document.execManyAsync(filters, options) */
+napi_value DocumentExecManyAsync(napi_env env, napi_callback_info info) {
+    size_t argc = 2;
+    napi_value args[2], this_arg;
+    Document* doc = static_cast<Document*>(unwrap_this(env, info, env_data(env)->document_constructor, &argc, args, &this_arg));
+    if (doc == nullptr) {
+        return nullptr;
+    }
+    if (argc < 1) {
+        napi_throw_type_error(env, nullptr, "Wrong number of arguments. Expected 1.");
+        return nullptr;
+    }
+
+    ExecOptions options;
+    AsyncManyWork* work = new AsyncManyWork();
+    if (!ParseExecOptions(env, argc > 1 ? args[1] : nullptr, &options) || !read_filters(env, args[0], &work->filters)) {
+        delete work;
+        return nullptr;
+    }
+    work->doc = doc;
+    napi_create_reference(env, this_arg, 1, &work->owner_ref);
+    work->timeout_sec = options.timeout_sec;
+    work->output = options.output;
+    work->priority = options.priority;
+    work->control = start_control(options.cancel, options.timeout_ms);
+    return queue_many_async(env, work);
+}
+
+/* message of the pending js exception, which is cleared */
+static std::string take_pending_exception(napi_env env) {
+    napi_value exception, message;
+    napi_valuetype type;
+    napi_get_and_clear_last_exception(env, &exception);
+    napi_typeof(env, exception, &type);
+    if (type == napi_object && napi_get_named_property(env, exception, "message", &message) == napi_ok) {
+        napi_typeof(env, message, &type);
+        if (type == napi_string) {
+            return FromNapiString(env, message);
+        }
+    }
+    if (napi_coerce_to_string(env, exception, &message) != napi_ok) {
+        return "Invalid JSON input";
+    }
+    return FromNapiString(env, message);
+}
+
+/* convert every element of an inputs array, inputs that can't be converted get an error instead.
+   hold keeps Buffer inputs alive for async work */
+static bool read_batch_inputs(napi_env env, napi_value value, const ExecOptions& options, bool hold,
+                              std::vector<ExecInput>& inputs, std::vector<FilterResult>& results,
+                              const ProjectionNode* projection = nullptr) {
+    bool is_array;
+    uint32_t len;
+    if (napi_is_array(env, value, &is_array) != napi_ok || !is_array) {
+        napi_throw_type_error(env, nullptr, "Inputs must be an array");
+        return false;
+    }
+    napi_get_array_length(env, value, &len);
+    inputs.resize(len);
+    results.resize(len);
+    for (uint32_t i = 0; i < len; i++) {
+        napi_value element;
+        results[i].success = true;
+        results[i].is_undefined = false;
+        results[i].value = jv_invalid();
+        inputs[i].has_value = false;
+        napi_get_element(env, value, i, &element);
+        if (!prepare_input(env, element, options, &inputs[i], projection)) {
+            results[i].success = false;
+            results[i].error = take_pending_exception(env);
+        } else if (hold) {
+            hold_input(env, element, &inputs[i]);
+        }
+    }
+    return true;
+}
+
+/* run the filter of wrapper on inputs [begin, end) with one checked out state, or its simple path (jq is
+   null then). results already failed are skipped, the rest are left as they are once control (may be null)
+   aborts the call */
+static void run_batch(const JqFilterWrapper* wrapper, jq_state* jq, const SimplePath* path, std::vector<ExecInput>& inputs, std::vector<FilterResult>& results,
+                      size_t begin, size_t end, unsigned int timeout_sec, OutputFormat output, ExecControl* control,
+                      bool detach) {
+    if (jq != nullptr) {
+        jq_set_input_cb(jq, NULL, NULL);
+    }
+    for (size_t i = begin; i < end; i++) {
+        FilterResult& result = results[i];
+        jv input;
+        if (!result.success) {
+            continue;
+        }
+        if (control_error(control) != nullptr) {
+            break;
+        }
+        if (!take_input(&inputs[i], &input)) {
+            result.success = false;
+            result.error = "Invalid JSON input";
+            continue;
+        }
+        if (path != nullptr) {
+            /* the input is the batch's own, nothing else shares the result */
+            take_simple_output(*path, input, output, &result);
+            continue;
+        }
+        wrapper->start(jq, input);
+        take_first_output(jq, timeout_sec, output, control, &result);
+        if (detach && result.success && !result.is_undefined) {
+            result.value = jq_detach_result(jq, result.value);
+        }
+    }
+}
+
+/* execBatch(inputs, filter, options) - run one filter on every input with a single checked out state */
+napi_value ExecBatch(napi_env env, napi_callback_info info) {
+    size_t argc = 3;
+    napi_value args[3];
+    napi_get_cb_info(env, info, &argc, args, nullptr, nullptr);
+    if (argc < 2) {
+        napi_throw_type_error(env, nullptr, "Wrong number of arguments. Expected 2.");
+        return nullptr;
+    }
+
+    ExecOptions options;
+    if (!ParseExecOptions(env, argc > 2 ? args[2] : nullptr, &options)) {
+        return nullptr;
+    }
+    std::string filter = FromNapiString(env, args[1]);
+    if (filter == "") {
+        napi_throw_error(env, nullptr, "Invalid filter input");
+        return nullptr;
+    }
+    struct err_data err_msg;
+    JqFilterWrapper* wrapper = get_cached_wrapper(filter, &err_msg);
+    if (wrapper == nullptr) {
+        napi_throw_error(env, nullptr, err_msg.buf);
+        return nullptr;
+    }
+
+    std::vector<ExecInput> inputs;
+    std::vector<FilterResult> results;
+    if (!read_batch_inputs(env, args[0], options, false, inputs, results, wrapper->projection)) {
+        cache.dec_refcnt(wrapper);
+        return nullptr;
+    }
+    const SimplePath* path = wrapper->fast_path();
+    jq_state* jq = path == nullptr ? wrapper->acquire() : nullptr;
+    if (path == nullptr && jq == nullptr) {
+        for (ExecInput& input : inputs) {
+            free_input(env, &input);
+        }
+        cache.dec_refcnt(wrapper);
+        napi_throw_error(env, nullptr, "Failed to initialize jq");
+        return nullptr;
+    }
+
+    napi_value ret;
+    NapiConverter conv(env, false, options.output);
+    napi_create_array_with_length(env, inputs.size(), &ret);
+    for (size_t i = 0; i < inputs.size(); i++) {
+        /* materialize each result while the state still holds it */
+        run_batch(wrapper, jq, path, inputs, results, i, i + 1, options.timeout_sec, options.output, nullptr, false);
+        napi_set_element(env, ret, i, filter_result_to_napi(conv, &results[i]));
+    }
+    if (jq != nullptr) {
+        jq_start(jq, jv_null(), 0);
+        wrapper->release(jq);
+    }
+    cache.dec_refcnt(wrapper);
+    return ret;
+}
+
+/* smallest number of inputs worth a worker task of its own */
+#define BATCH_MIN_CHUNK 16
+
+/* state of an execBatchAsync call, shared by its chunks. only touched on the js thread
+   or by the chunk owning a range of inputs/results */
+struct BatchJob {
+    std::vector<ExecInput> inputs;
+    std::vector<FilterResult> results;
+    std::string filter;
+    unsigned int timeout_sec;
+    OutputFormat output;
+    ExecControl* control;
+    napi_deferred deferred;
+    size_t pending_chunks;
+    std::string error;
+};
+
+struct BatchChunk {
+    BatchJob* job;
+    size_t begin;
+    size_t end;
+    napi_async_work async_work;
+    std::string error;
+};
+
+void ExecuteBatchChunk(napi_env env, void* data) {
+    BatchChunk* chunk = static_cast<BatchChunk*>(data);
+    BatchJob* job = chunk->job;
+    ASYNC_DEBUG_LOG(chunk, "ExecuteBatchChunk started for inputs [%zu, %zu)", chunk->begin, chunk->end);
+
+    if (control_error(job->control) != nullptr) {
+        return;
+    }
+    struct err_data err_msg;
+    JqFilterWrapper* wrapper = get_cached_wrapper(job->filter, &err_msg);
+    if (wrapper == nullptr) {
+        chunk->error = err_msg.buf;
+        return;
+    }
+    const SimplePath* path = wrapper->fast_path();
+    jq_state* jq = path == nullptr ? wrapper->acquire() : nullptr;
+    if (path == nullptr && jq == nullptr) {
+        chunk->error = "Failed to initialize jq";
+        cache.dec_refcnt(wrapper);
+        return;
+    }
+    run_batch(wrapper, jq, path, job->inputs, job->results, chunk->begin, chunk->end, job->timeout_sec, job->output, job->control, true);
+    if (jq != nullptr) {
+        jq_start(jq, jv_null(), 0);
+        wrapper->release(jq);
+    }
+    cache.dec_refcnt(wrapper);
+}
+
+void CompleteBatchChunk(napi_env env, napi_status status, void* data) {
+    BatchChunk* chunk = static_cast<BatchChunk*>(data);
+    BatchJob* job = chunk->job;
+
+    if (job->error == "") {
+        job->error = status != napi_ok ? async_status_message(status) : chunk->error;
+    }
+    delete_async_work(env, chunk->async_work);
+    delete chunk;
+    if (--job->pending_chunks > 0) {
+        return;
+    }
+
+    /* all chunks are done, an abort while any of them ran fails the call */
+    if (const char* aborted = control_error(job->control)) {
+        job->error = aborted;
+    }
+    finish_control(job->control);
+    if (job->error != "") {
+        reject_with_error_message(env, job->deferred, job->error);
+    } else {
+        napi_handle_scope scope;
+        napi_open_handle_scope(env, &scope);
+        napi_value ret;
+        NapiConverter conv(env, true, job->output);
+        napi_create_array_with_length(env, job->results.size(), &ret);
+        for (size_t i = 0; i < job->results.size(); i++) {
+            napi_set_element(env, ret, i, filter_result_to_napi(conv, &job->results[i]));
+        }
+        napi_resolve_deferred(env, job->deferred, ret);
+        napi_close_handle_scope(env, scope);
+    }
+
+    for (size_t i = 0; i < job->results.size(); i++) {
+        jv_free(job->results[i].value);
+        free_input(env, &job->inputs[i]);
+    }
+    delete job;
+}
+
+/* execBatchAsync(inputs, filter, options) - like execBatch, split in chunks over several worker tasks */
+napi_value ExecBatchAsync(napi_env env, napi_callback_info info) {
+    size_t argc = 3;
+    napi_value args[3];
+    napi_get_cb_info(env, info, &argc, args, nullptr, nullptr);
+    if (argc < 2) {
+        napi_throw_type_error(env, nullptr, "Wrong number of arguments. Expected 2.");
+        return nullptr;
+    }
+
+    ExecOptions options;
+    if (!ParseExecOptions(env, argc > 2 ? args[2] : nullptr, &options)) {
+        return nullptr;
+    }
+    BatchJob* job = new BatchJob();
+    job->filter = FromNapiString(env, args[1]);
+    if (job->filter == "") {
+        napi_throw_error(env, nullptr, "Invalid filter input");
+        delete job;
+        return nullptr;
+    }
+    if (!read_batch_inputs(env, args[0], options, true, job->inputs, job->results)) {
+        delete job;
+        return nullptr;
+    }
+    job->timeout_sec = options.timeout_sec;
+    job->output = options.output;
+    job->control = start_control(options.cancel, options.timeout_ms);
+
+    /* at most one chunk per pooled state, so chunks never wait on each other */
+    size_t count = job->inputs.size();
+    size_t chunks = (count + BATCH_MIN_CHUNK - 1) / BATCH_MIN_CHUNK;
+    if (chunks > get_pool_size()) {
+        chunks = get_pool_size();
+    }
+    if (chunks == 0) {
+        chunks = 1;
+    }
+    job->pending_chunks = chunks;
+
+    napi_value promise;
+    napi_create_promise(env, &job->deferred, &promise);
+    for (size_t c = 0; c < chunks; c++) {
+        BatchChunk* chunk = new BatchChunk();
+        chunk->job = job;
+        chunk->begin = count * c / chunks;
+        chunk->end = count * (c + 1) / chunks;
+        queue_async_work(env, "ExecBatchAsync", ExecuteBatchChunk, CompleteBatchChunk, chunk, &chunk->async_work, options.priority);
+    }
+    return promise;
+}
+
+/* pull up to max outputs of a started jq into outputs. true once the filter is done, with error set
+   if it failed (the outputs before the error are kept) or control (may be null) aborted the call */
+static bool pull_outputs(jq_state* jq, unsigned int timeout_sec, OutputFormat output, ExecControl* control, size_t max,
+                         std::vector<jv>& outputs, std::string& error) {
+    if (!control_begin(control)) {
+        error = control_error(control);
+        return true;
+    }
+    /* one execute sample per pull, not per output */
+    uint64_t execute_ns = 0;
+    bool done = false;
+    while (outputs.size() < max && control_error(control) == nullptr) {
+        uint64_t start = stats_now();
+        jv value = jq_next(jq, control_timeout(control, timeout_sec));
+        execute_ns += stats_now() - start;
+        if (jv_get_kind(value) == JV_KIND_INVALID) {
+            jv msg = jv_invalid_get_msg(jv_copy(value));
+            if (jv_get_kind(msg) == JV_KIND_STRING) {
+                error = std::string("jq: error: ") + jv_string_value(msg);
+            }
+            jv_free(msg);
+            jv_free(value);
+            done = true;
+            break;
+        }
+        outputs.push_back(prepare_output(value, output));
+    }
+    stats_record_ns(PHASE_EXECUTE, execute_ns);
+    if (const char* aborted = control_end(control, jq)) {
+        error = aborted;
+        return true;
+    }
+    return done;
+}
+
+/* js array of outputs, which are freed */
+static bool outputs_to_napi(napi_env env, std::vector<jv>& outputs, bool json_numbers, OutputFormat output,
+                            napi_value* ret, std::string& err_msg) {
+    bool success = true;
+    uint64_t start = stats_now();
+    NapiConverter conv(env, json_numbers, output);
+    napi_create_array_with_length(env, outputs.size(), ret);
+    for (size_t i = 0; i < outputs.size(); i++) {
+        napi_value value;
+        if (success && (success = output_to_napi(conv, outputs[i], &value, err_msg))) {
+            napi_set_element(env, *ret, i, value);
+        }
+        jv_free(outputs[i]);
+    }
+    outputs.clear();
+    stats_record(PHASE_MATERIALIZE, start);
+    return success;
+}
+
+/* execAll(input, filter, options) - every output of the filter */
+napi_value ExecAll(napi_env env, napi_callback_info info) {
+    size_t argc = 3;
+    napi_value args[3];
+    napi_get_cb_info(env, info, &argc, args, nullptr, nullptr);
+    if (argc < 2) {
+        napi_throw_type_error(env, nullptr, "Wrong number of arguments. Expected 2.");
+        return nullptr;
+    }
+
+    ExecOptions options;
+    if (!ParseExecOptions(env, argc > 2 ? args[2] : nullptr, &options)) {
+        return nullptr;
+    }
+    std::string filter = FromNapiString(env, args[1]);
+    if (filter == "") {
+        napi_throw_error(env, nullptr, "Invalid filter input");
+        return nullptr;
+    }
+    struct err_data err_msg;
+    JqFilterWrapper* wrapper = get_cached_wrapper(filter, &err_msg);
+    if (wrapper == nullptr) {
+        napi_throw_error(env, nullptr, err_msg.buf);
+        return nullptr;
+    }
+    ExecInput exec_input;
+    jv input;
+    if (!prepare_input(env, args[0], options, &exec_input, wrapper->projection)) {
+        cache.dec_refcnt(wrapper);
+        return nullptr;
+    }
+    if (!take_input(&exec_input, &input)) {
+        cache.dec_refcnt(wrapper);
+        napi_throw_error(env, nullptr, "Invalid JSON input");
+        return nullptr;
+    }
+    jq_state* jq = wrapper->acquire();
+    if (jq == nullptr) {
+        jv_free(input);
+        cache.dec_refcnt(wrapper);
+        napi_throw_error(env, nullptr, "Failed to initialize jq");
+        return nullptr;
+    }
+
+    std::vector<jv> outputs;
+    std::string error;
+    napi_value ret;
+    jq_set_input_cb(jq, NULL, NULL);
+    wrapper->start(jq, input);
+    pull_outputs(jq, options.timeout_sec, options.output, nullptr, SIZE_MAX, outputs, error);
+    bool success = outputs_to_napi(env, outputs, false, options.output, &ret, error) && error == "";
+    jq_start(jq, jv_null(), 0);
+    wrapper->release(jq);
+    cache.dec_refcnt(wrapper);
+    if (!success) {
+        napi_throw_error(env, nullptr, error.c_str());
+        return nullptr;
+    }
+    return ret;
+}
+
+struct AsyncAllWork {
+    /* input */
+    ExecInput input;
+    std::string filter;
+    unsigned int timeout_sec;
+    OutputFormat output;
+    ExecControl* control;
+    /* promise */
+    napi_deferred deferred;
+    napi_async_work async_work;
+    /* output, detached from the jq state */
+    std::vector<jv> outputs;
+    std::string error;
+};
+
+void ExecuteAllAsync(napi_env env, void* data) {
+    AsyncAllWork* work = static_cast<AsyncAllWork*>(data);
+    ASYNC_DEBUG_LOG(work, "ExecuteAllAsync started for filter='%s'", work->filter.c_str());
+
+    if (const char* aborted = control_error(work->control)) {
+        work->error = aborted;
+        return;
+    }
+    struct err_data err_msg;
+    JqFilterWrapper* wrapper = get_cached_wrapper(work->filter, &err_msg);
+    if (wrapper == nullptr) {
+        work->error = err_msg.buf;
+        return;
+    }
+    jv input;
+    if (!take_input(&work->input, &input)) {
+        work->error = "Invalid JSON input";
+        cache.dec_refcnt(wrapper);
+        return;
+    }
+    jq_state* jq = wrapper->acquire();
+    if (jq == nullptr) {
+        work->error = "Failed to initialize jq";
+        jv_free(input);
+        cache.dec_refcnt(wrapper);
+        return;
+    }
+    jq_set_input_cb(jq, NULL, NULL);
+    wrapper->start(jq, input);
+    pull_outputs(jq, work->timeout_sec, work->output, work->control, SIZE_MAX, work->outputs, work->error);
+
+    /* detach all outputs at once: one reset of the state, one sharing check */
+    jv all = jv_array_sized(work->outputs.size());
+    for (jv output : work->outputs) {
+        all = jv_array_append(all, output);
+    }
+    work->outputs.clear();
+    all = jq_detach_result(jq, all);
+    wrapper->release(jq);
+    cache.dec_refcnt(wrapper);
+
+    int len = jv_array_length(jv_copy(all));
+    for (int i = 0; i < len; i++) {
+        work->outputs.push_back(jv_array_get(jv_copy(all), i));
+    }
+    jv_free(all);
+}
+
+void CompleteAllAsync(napi_env env, napi_status status, void* data) {
+    AsyncAllWork* work = static_cast<AsyncAllWork*>(data);
+    std::string error = status != napi_ok ? async_status_message(status) : work->error;
+
+    napi_handle_scope scope;
+    napi_open_handle_scope(env, &scope);
+    napi_value ret;
+    if (outputs_to_napi(env, work->outputs, true, work->output, &ret, error) && error == "") {
+        napi_resolve_deferred(env, work->deferred, ret);
+    } else {
+        reject_with_error_message(env, work->deferred, error);
+    }
+    napi_close_handle_scope(env, scope);
+
+    free_input(env, &work->input);
+    finish_control(work->control);
+    delete_async_work(env, work->async_work);
+    delete work;
+}
+
+/* execAllAsync(input, filter, options) */
+napi_value ExecAllAsync(napi_env env, napi_callback_info info) {
+    size_t argc = 3;
+    napi_value args[3];
+    napi_get_cb_info(env, info, &argc, args, nullptr, nullptr);
+    if (argc < 2) {
+        napi_throw_type_error(env, nullptr, "Wrong number of arguments. Expected 2.");
+        return nullptr;
+    }
+
+    ExecOptions options;
+    if (!ParseExecOptions(env, argc > 2 ? args[2] : nullptr, &options)) {
+        return nullptr;
+    }
+    AsyncAllWork* work = new AsyncAllWork();
+    work->filter = FromNapiString(env, args[1]);
+    if (work->filter == "") {
+        napi_throw_error(env, nullptr, "Invalid filter input");
+        delete work;
+        return nullptr;
+    }
+    if (!prepare_input(env, args[0], options, &work->input)) {
+        delete work;
+        return nullptr;
+    }
+    hold_input(env, args[0], &work->input);
+    work->timeout_sec = options.timeout_sec;
+    work->output = options.output;
+    work->control = start_control(options.cancel, options.timeout_ms);
+
+    napi_value promise;
+    napi_create_promise(env, &work->deferred, &promise);
+    queue_async_work(env, "ExecAllAsync", ExecuteAllAsync, CompleteAllAsync, work, &work->async_work, options.priority);
+    return promise;
+}
+
+/* a state of the filter for a caller keeping it across js turns: taken out of the pool of the filter's
+   program (so no cache reference is held meanwhile) or compiled privately when none is idle, never
+   waited for. pool and literals are what the caller runs and returns the state with */
+static jq_state* take_filter_state(const std::string& filter, struct err_data* err, std::shared_ptr<StatePool>* pool,
+                                   std::vector<ShapeLiteral>* literals) {
+    JqFilterWrapper* wrapper = get_cached_wrapper(filter, err);
+    if (wrapper == nullptr) {
+        return nullptr;
+    }
+    *pool = wrapper->pool;
+    *literals = wrapper->literals;
+    jq_state* jq = wrapper->take();
+    cache.dec_refcnt(wrapper);
+    return jq != nullptr ? jq : compile_jq_state((*pool)->program, err);
+}
+
+/* hand a taken state back to its pool, tear it down if the pool is full */
+static void return_filter_state(StatePool* pool, jq_state* jq) {
+    jq_start(jq, jv_null(), 0);
+    if (!pool->adopt(jq)) {
+        jq_teardown(&jq);
+    }
+}
+
+/* outputs of a filter pulled in batches by createIterator. the iterator owns its jq state (see
+   take_filter_state) until the filter is done or it is closed. its jvs are touched by one thread at a
+   time: nextAsync work is never queued while another pull is pending */
+struct OutputIterator {
+    std::shared_ptr<StatePool> pool;
+    jq_state* jq;
+    unsigned int timeout_sec;
+    OutputFormat output;
+    WorkPriority priority;
+    bool busy;
+    /* the filter has no more outputs. the state is only given back once the last batch is converted:
+       outputs may share constants of the compiled program, and refcounts aren't atomic */
+    bool done;
+    std::string error;
+
+    ~OutputIterator() {
+        close();
+    }
+
+    void close() {
+        if (jq != nullptr) {
+            return_filter_state(pool.get(), jq);
+            jq = nullptr;
+        }
+    }
+
+    /* pull the next batch, the caller closes the iterator once done and the batch is converted */
+    void pull(size_t max, std::vector<jv>& outputs) {
+        if (jq != nullptr && !done && pull_outputs(jq, timeout_sec, output, nullptr, max, outputs, error)) {
+            done = true;
+        }
+    }
+};
+
+static void FinalizeIterator(napi_env env, void* data, void* hint) {
+    delete static_cast<OutputIterator*>(data);
+}
+
+/* createIterator(input, filter, options) */
+napi_value CreateIterator(napi_env env, napi_callback_info info) {
+    size_t argc = 3;
+    napi_value args[3];
+    napi_get_cb_info(env, info, &argc, args, nullptr, nullptr);
+    if (argc < 2) {
+        napi_throw_type_error(env, nullptr, "Wrong number of arguments. Expected 2.");
+        return nullptr;
+    }
+
+    ExecOptions options;
+    if (!ParseExecOptions(env, argc > 2 ? args[2] : nullptr, &options)) {
+        return nullptr;
+    }
+    std::string filter = FromNapiString(env, args[1]);
+    if (filter == "") {
+        napi_throw_error(env, nullptr, "Invalid filter input");
+        return nullptr;
+    }
+    ExecInput exec_input;
+    jv input;
+    if (!prepare_input(env, args[0], options, &exec_input)) {
+        return nullptr;
+    }
+    if (!take_input(&exec_input, &input)) {
+        napi_throw_error(env, nullptr, "Invalid JSON input");
+        return nullptr;
+    }
+
+    struct err_data err_msg;
+    std::shared_ptr<StatePool> pool;
+    std::vector<ShapeLiteral> literals;
+    jq_state* jq = take_filter_state(filter, &err_msg, &pool, &literals);
+    if (jq == nullptr) {
+        jv_free(input);
+        napi_throw_error(env, nullptr, err_msg.buf);
+        return nullptr;
+    }
+    jq_set_input_cb(jq, NULL, NULL);
+    jq_start(jq, bind_literals(literals, input), 0);
+
+    OutputIterator* it = new OutputIterator();
+    it->pool = pool;
+    it->jq = jq;
+    it->timeout_sec = options.timeout_sec;
+    it->output = options.output;
+    it->priority = options.priority;
+    it->busy = false;
+    it->done = false;
+    napi_value instance = new_wrapped_instance(env, env_data(env)->iterator_constructor, it);
+    if (instance == nullptr) {
+        delete it;
+    }
+    return instance;
+}
+
+static OutputIterator* unwrap_idle_iterator(napi_env env, napi_callback_info info, size_t* argc, napi_value* args, napi_value* this_arg) {
+    OutputIterator* it = static_cast<OutputIterator*>(unwrap_this(env, info, env_data(env)->iterator_constructor, argc, args, this_arg));
+    if (it != nullptr && it->busy) {
+        napi_throw_error(env, nullptr, "Iterator is busy");
+        return nullptr;
+    }
+    return it;
+}
+
+/* batch size argument, at least 1 */
+static size_t read_batch_size(napi_env env, size_t argc, napi_value* args) {
+    double max = 0;
+    if (argc > 0) {
+        napi_get_value_double(env, args[0], &max);
+    }
+    return max >= 1 ? (max < (double)SIZE_MAX ? (size_t)max : SIZE_MAX) : 1;
+}
+
+/* the batch, or the error the filter failed with once the outputs before it were handed out. closes the
+   iterator after converting the last batch */
+static napi_value iterator_batch(napi_env env, OutputIterator* it, std::vector<jv>& outputs, bool json_numbers) {
+    napi_value ret;
+    std::string err_msg;
+    if (outputs.empty() && it->error != "") {
+        it->close();
+        napi_throw_error(env, nullptr, it->error.c_str());
+        it->error = "";
+        return nullptr;
+    }
+    bool success = outputs_to_napi(env, outputs, json_numbers, it->output, &ret, err_msg);
+    if (!success || it->done) {
+        it->close();
+    }
+    if (!success) {
+        napi_throw_error(env, nullptr, err_msg.c_str());
+        return nullptr;
+    }
+    return ret;
+}
+
+/* JqIterator.next(max) - up to max outputs, fewer once the filter is done */
+napi_value IteratorNext(napi_env env, napi_callback_info info) {
+    size_t argc = 1;
+    napi_value args[1], this_arg;
+    OutputIterator* it = unwrap_idle_iterator(env, info, &argc, args, &this_arg);
+    if (it == nullptr) {
+        return nullptr;
+    }
+    std::vector<jv> outputs;
+    it->pull(read_batch_size(env, argc, args), outputs);
+    return iterator_batch(env, it, outputs, false);
+}
+
+struct IteratorWork {
+    OutputIterator* it;
+    napi_ref it_ref;
+    size_t max;
+    std::vector<jv> outputs;
+    napi_deferred deferred;
+    napi_async_work async_work;
+};
+
+void ExecuteIteratorNext(napi_env env, void* data) {
+    IteratorWork* work = static_cast<IteratorWork*>(data);
+    work->it->pull(work->max, work->outputs);
+}
+
+void CompleteIteratorNext(napi_env env, napi_status status, void* data) {
+    IteratorWork* work = static_cast<IteratorWork*>(data);
+    work->it->busy = false;
+
+    napi_handle_scope scope;
+    napi_open_handle_scope(env, &scope);
+    napi_value ret = nullptr;
+    if (status != napi_ok) {
+        work->it->close();
+        reject_with_error_message(env, work->deferred, async_status_message(status));
+    } else {
+        /* keep what a JSON round trip used to give, like CompleteAsync */
+        ret = iterator_batch(env, work->it, work->outputs, true);
+        if (ret != nullptr) {
+            napi_resolve_deferred(env, work->deferred, ret);
+        } else {
+            napi_value error;
+            napi_get_and_clear_last_exception(env, &error);
+            napi_reject_deferred(env, work->deferred, error);
+        }
+    }
+    napi_close_handle_scope(env, scope);
+
+    for (jv output : work->outputs) {
+        jv_free(output);
+    }
+    napi_delete_reference(env, work->it_ref);
+    delete_async_work(env, work->async_work);
+    delete work;
+}
+
+/* JqIterator.nextAsync(max) - next() pulling on a worker thread */
+napi_value IteratorNextAsync(napi_env env, napi_callback_info info) {
+    size_t argc = 1;
+    napi_value args[1], this_arg;
+    OutputIterator* it = unwrap_idle_iterator(env, info, &argc, args, &this_arg);
+    if (it == nullptr) {
+        return nullptr;
+    }
+
+    IteratorWork* work = new IteratorWork();
+    work->it = it;
+    work->max = read_batch_size(env, argc, args);
+    it->busy = true;
+    napi_create_reference(env, this_arg, 1, &work->it_ref);
+
+    napi_value promise;
+    napi_create_promise(env, &work->deferred, &promise);
+    queue_async_work(env, "IteratorNextAsync", ExecuteIteratorNext, CompleteIteratorNext, work, &work->async_work, it->priority);
+    return promise;
+}
+
+/* JqIterator.close() - stop the filter early and give its state back */
+napi_value IteratorClose(napi_env env, napi_callback_info info) {
+    size_t argc = 0;
+    napi_value this_arg;
+    OutputIterator* it = unwrap_idle_iterator(env, info, &argc, nullptr, &this_arg);
+    if (it == nullptr) {
+        return nullptr;
+    }
+    it->close();
+    it->error = "";
+    return nullptr;
+}
+
+/* JSON values parsed from a byte stream by createStream, each run through the filter. like
+   OutputIterator, the stream owns its state and parser and only one write is pending at a time */
+struct JsonStream {
+    std::shared_ptr<StatePool> pool;
+    std::vector<ShapeLiteral> literals;
+    jq_state* jq;
+    struct jv_parser* parser;
+    unsigned int timeout_sec;
+    OutputFormat output;
+    WorkPriority priority;
+    bool busy;
+    bool close_pending;
+
+    ~JsonStream() {
+        close();
+    }
+
+    void close() {
+        if (parser != nullptr) {
+            jv_parser_free(parser);
+            parser = nullptr;
+        }
+        if (jq != nullptr) {
+            return_filter_state(pool.get(), jq);
+            jq = nullptr;
+        }
+    }
+
+    /* parse the bytes (the end of the stream if final) and run the filter on every complete value.
+       true on success, otherwise error is set and the outputs are those before the error */
+    bool write(const char* data, size_t length, bool final, std::vector<jv>& outputs, std::string& error) {
+        if (parser == nullptr) {
+            error = "Stream is closed";
+            return false;
+        }
+        do {
+            /* jv_parser takes int lengths */
+            int part = length > INT_MAX ? INT_MAX : (int)length;
+            bool last = final && (size_t)part == length;
+            jv_parser_set_buf(parser, data, part, !last);
+            data += part;
+            length -= part;
+            /* drain the parser, it must not keep pointing into this buffer */
+            for (;;) {
+                uint64_t start = stats_now();
+                jv value = jv_parser_next(parser);
+                stats_record(PHASE_PARSE, start);
+                if (!jv_is_valid(value)) {
+                    jv msg = jv_invalid_get_msg(value);
+                    bool failed = jv_get_kind(msg) == JV_KIND_STRING;
+                    if (failed) {
+                        error = std::string("Invalid JSON input: ") + jv_string_value(msg);
+                    }
+                    jv_free(msg);
+                    if (failed) {
+                        return false;
+                    }
+                    break;
+                }
+                jq_start(jq, bind_literals(literals, value), 0);
+                if (pull_outputs(jq, timeout_sec, output, nullptr, SIZE_MAX, outputs, error) && error != "") {
+                    return false;
+                }
+            }
+        } while (length > 0);
+        return true;
+    }
+};
+
+static void FinalizeStream(napi_env env, void* data, void* hint) {
+    delete static_cast<JsonStream*>(data);
+}
+
+/* createStream(filter, options) */
+napi_value CreateStream(napi_env env, napi_callback_info info) {
+    size_t argc = 2;
+    napi_value args[2];
+    napi_get_cb_info(env, info, &argc, args, nullptr, nullptr);
+    if (argc < 1) {
+        napi_throw_type_error(env, nullptr, "Wrong number of arguments. Expected 1.");
+        return nullptr;
+    }
+
+    ExecOptions options;
+    if (!ParseExecOptions(env, argc > 1 ? args[1] : nullptr, &options)) {
+        return nullptr;
+    }
+    std::string filter = FromNapiString(env, args[0]);
+    if (filter == "") {
+        napi_throw_error(env, nullptr, "Invalid filter input");
+        return nullptr;
+    }
+    struct err_data err_msg;
+    std::shared_ptr<StatePool> pool;
+    std::vector<ShapeLiteral> literals;
+    jq_state* jq = take_filter_state(filter, &err_msg, &pool, &literals);
+    if (jq == nullptr) {
+        napi_throw_error(env, nullptr, err_msg.buf);
+        return nullptr;
+    }
+    jq_set_input_cb(jq, NULL, NULL);
+
+    JsonStream* stream = new JsonStream();
+    stream->pool = pool;
+    stream->literals = literals;
+    stream->jq = jq;
+    stream->parser = jv_parser_new(0);
+    stream->timeout_sec = options.timeout_sec;
+    stream->output = options.output;
+    stream->priority = options.priority;
+    stream->busy = false;
+    stream->close_pending = false;
+    napi_value instance = new_wrapped_instance(env, env_data(env)->stream_constructor, stream);
+    if (instance == nullptr) {
+        delete stream;
+    }
+    return instance;
+}
+
+struct StreamWork {
+    JsonStream* stream;
+    napi_ref stream_ref;
+    /* the chunk is referenced until the work is done, the parser reads it in place */
+    napi_ref chunk_ref;
+    const char* data;
+    size_t length;
+    bool final;
+    std::vector<jv> outputs;
+    std::string error;
+    bool success;
+    napi_deferred deferred;
+    napi_async_work async_work;
+};
+
+void ExecuteStreamWrite(napi_env env, void* data) {
+    StreamWork* work = static_cast<StreamWork*>(data);
+    work->success = work->stream->write(work->data, work->length, work->final, work->outputs, work->error);
+}
+
+void CompleteStreamWrite(napi_env env, napi_status status, void* data) {
+    StreamWork* work = static_cast<StreamWork*>(data);
+    JsonStream* stream = work->stream;
+    stream->busy = false;
+
+    napi_handle_scope scope;
+    napi_open_handle_scope(env, &scope);
+    napi_value ret;
+    std::string error = status != napi_ok ? async_status_message(status) : work->error;
+    /* keep what a JSON round trip used to give, like CompleteAsync */
+    if (outputs_to_napi(env, work->outputs, true, stream->output, &ret, error) && error == "") {
+        napi_resolve_deferred(env, work->deferred, ret);
+    } else {
+        stream->close();
+        reject_with_error_message(env, work->deferred, error);
+    }
+    napi_close_handle_scope(env, scope);
+
+    if (work->final || stream->close_pending) {
+        stream->close();
+    }
+    if (work->chunk_ref != nullptr) {
+        napi_delete_reference(env, work->chunk_ref);
+    }
+    napi_delete_reference(env, work->stream_ref);
+    delete_async_work(env, work->async_work);
+    delete work;
+}
+
+/* JqStream.writeAsync(chunk) - parse a Buffer/Uint8Array chunk on a worker thread and resolve with the
+   outputs of the filter for every value completed by it. a null chunk ends the stream */
+napi_value StreamWriteAsync(napi_env env, napi_callback_info info) {
+    size_t argc = 1;
+    napi_value args[1], this_arg;
+    JsonStream* stream = static_cast<JsonStream*>(unwrap_this(env, info, env_data(env)->stream_constructor, &argc, args, &this_arg));
+    if (stream == nullptr) {
+        return nullptr;
+    }
+    if (stream->busy) {
+        napi_throw_error(env, nullptr, "Stream is busy");
+        return nullptr;
+    }
+
+    StreamWork* work = new StreamWork();
+    napi_valuetype type = napi_undefined;
+    if (argc > 0) {
+        napi_typeof(env, args[0], &type);
+    }
+    if (type == napi_null || type == napi_undefined) {
+        work->data = "";
+        work->length = 0;
+        work->final = true;
+    } else if (get_bytes(env, args[0], &work->data, &work->length)) {
+        work->final = false;
+        napi_create_reference(env, args[0], 1, &work->chunk_ref);
+    } else {
+        delete work;
+        napi_throw_type_error(env, nullptr, "Chunk must be a Buffer or Uint8Array");
+        return nullptr;
+    }
+    work->stream = stream;
+    stream->busy = true;
+    napi_create_reference(env, this_arg, 1, &work->stream_ref);
+
+    napi_value promise;
+    napi_create_promise(env, &work->deferred, &promise);
+    queue_async_work(env, "StreamWriteAsync", ExecuteStreamWrite, CompleteStreamWrite, work, &work->async_work, stream->priority);
+    return promise;
+}
+
+/* JqStream.close() - free the parser and give the state back, after the pending write if any */
+napi_value StreamClose(napi_env env, napi_callback_info info) {
+    size_t argc = 0;
+    napi_value this_arg;
+    JsonStream* stream = static_cast<JsonStream*>(unwrap_this(env, info, env_data(env)->stream_constructor, &argc, nullptr, &this_arg));
+    if (stream == nullptr) {
+        return nullptr;
+    }
+    if (stream->busy) {
+        stream->close_pending = true;
+    } else {
+        stream->close();
+    }
+    return nullptr;
+}
+
+static void FinalizeCancelToken(napi_env env, void* data, void* hint) {
+    control_unref(static_cast<ExecControl*>(data));
+}
+
+/* createCancelToken() - token to abort the async call it is passed to as the cancel option */
+napi_value CreateCancelToken(napi_env env, napi_callback_info info) {
+    ExecControl* control = new ExecControl();
+    napi_value instance = new_wrapped_instance(env, env_data(env)->cancel_token_constructor, control);
+    if (instance == nullptr) {
+        delete control;
+    }
+    return instance;
+}
+
+/* JqCancelToken.abort() - drop the call if it is queued, halt it at its next VM step if it runs */
+napi_value CancelTokenAbort(napi_env env, napi_callback_info info) {
+    size_t argc = 0;
+    napi_value this_arg;
+    ExecControl* control = static_cast<ExecControl*>(unwrap_this(env, info, env_data(env)->cancel_token_constructor, &argc, nullptr, &this_arg));
+    if (control == nullptr) {
+        return nullptr;
+    }
+    control_abort(control, ABORTED_ERROR);
+    return nullptr;
+}
+
+// napi_value SetDebugMode(napi_env env, napi_callback_info info) {
+//     size_t argc = 1;
+//     napi_value args[1];
+//     bool enable;
+
+//     napi_get_cb_info(env, info, &argc, args, nullptr, nullptr);
+
+//     if (argc < 1) {
+//         napi_throw_type_error(env, nullptr, "Wrong number of arguments");
+//         return nullptr;
+//     }
+
+//     napi_get_value_bool(env, args[0], &enable);
+//     debug_enabled = enable;
+//     DEBUG_LOG("Debug mode %s", enable ? "enabled" : "disabled");
 
-// napi_value GetCacheStats(napi_env env, napi_callback_info info) {
 //     napi_value result;
-//     napi_create_object(env, &result);
-//     struct rusage usage;
-//     getrusage(RUSAGE_SELF, &usage);
-//     napi_value maxrss;
-//     napi_create_int64(env, usage.ru_maxrss, &maxrss);
-//     napi_set_named_property(env, result, "max_rss", maxrss);
+//     napi_get_boolean(env, debug_enabled, &result);
 //     return result;
 // }
 
+/* {entries, hits, misses, evictions} of a shard, or summed over all shards */
+static napi_value shard_stats_to_napi(napi_env env, const CacheShardStats& stats) {
+    napi_value result, value;
+    napi_create_object(env, &result);
+    napi_create_int64(env, stats.entries, &value);
+    napi_set_named_property(env, result, "entries", value);
+    napi_create_int64(env, stats.bytes, &value);
+    napi_set_named_property(env, result, "bytes", value);
+    napi_create_int64(env, stats.hits, &value);
+    napi_set_named_property(env, result, "hits", value);
+    napi_create_int64(env, stats.misses, &value);
+    napi_set_named_property(env, result, "misses", value);
+    napi_create_int64(env, stats.evictions, &value);
+    napi_set_named_property(env, result, "evictions", value);
+    return result;
+}
+
+static napi_value cache_stats_to_napi(napi_env env) {
+    size_t entries, states, idle;
+    cache.pool_stats(&entries, &states, &idle);
+    CacheShardStats shards[CACHE_SHARDS];
+    CacheShardStats total = {};
+    cache.shard_stats(shards);
+
+    napi_value result, value;
+    napi_create_object(env, &result);
+    napi_create_int64(env, cache.size(), &value);
+    napi_set_named_property(env, result, "cacheSize", value);
+    napi_create_int64(env, entries, &value);
+    napi_set_named_property(env, result, "entries", value);
+    napi_create_int64(env, get_pool_size(), &value);
+    napi_set_named_property(env, result, "poolSize", value);
+    napi_create_int64(env, states, &value);
+    napi_set_named_property(env, result, "states", value);
+    napi_create_int64(env, idle, &value);
+    napi_set_named_property(env, result, "idleStates", value);
+
+    napi_value shard_list;
+    napi_create_array_with_length(env, CACHE_SHARDS, &shard_list);
+    for (size_t i = 0; i < CACHE_SHARDS; i++) {
+        napi_set_element(env, shard_list, i, shard_stats_to_napi(env, shards[i]));
+        total.bytes += shards[i].bytes;
+        total.hits += shards[i].hits;
+        total.misses += shards[i].misses;
+        total.evictions += shards[i].evictions;
+    }
+    napi_create_int64(env, total.bytes, &value);
+    napi_set_named_property(env, result, "bytes", value);
+    napi_create_int64(env, cache.max_bytes(), &value);
+    napi_set_named_property(env, result, "maxBytes", value);
+    napi_create_int64(env, total.hits, &value);
+    napi_set_named_property(env, result, "hits", value);
+    napi_create_int64(env, total.misses, &value);
+    napi_set_named_property(env, result, "misses", value);
+    napi_create_int64(env, total.evictions, &value);
+    napi_set_named_property(env, result, "evictions", value);
+    napi_set_named_property(env, result, "shards", shard_list);
+    return result;
+}
+
+napi_value GetCacheStats(napi_env env, napi_callback_info info) {
+    return cache_stats_to_napi(env);
+}
+
+/* percentiles reported for every phase */
+static const double stats_percentiles[] = { 50, 90, 99, 99.9 };
+static const char* const stats_percentile_names[] = { "p50Us", "p90Us", "p99Us", "p999Us" };
+
+/* {count, totalUs, maxUs, p50Us.., buckets} of a phase. a percentile is the upper end of its bucket
+   (capped at the max), buckets are the non empty ones as {upToUs, count} */
+static napi_value histogram_to_napi(napi_env env, const ThreadStats& stats, StatsPhase phase) {
+    uint64_t count = 0;
+    for (size_t bucket = 0; bucket < HIST_BUCKETS; bucket++) {
+        count += stats.buckets[phase][bucket].load(std::memory_order_relaxed);
+    }
+    uint64_t max_ns = stats.max_ns[phase].load(std::memory_order_relaxed);
+
+    napi_value result, value, buckets;
+    napi_create_object(env, &result);
+    napi_create_int64(env, count, &value);
+    napi_set_named_property(env, result, "count", value);
+    napi_create_double(env, stats.total_ns[phase].load(std::memory_order_relaxed) / 1e3, &value);
+    napi_set_named_property(env, result, "totalUs", value);
+    napi_create_double(env, max_ns / 1e3, &value);
+    napi_set_named_property(env, result, "maxUs", value);
+
+    napi_create_array(env, &buckets);
+    uint32_t bucket_count = 0;
+    uint64_t seen = 0;
+    size_t percentile = 0;
+    size_t percentiles = sizeof(stats_percentiles) / sizeof(stats_percentiles[0]);
+    for (size_t bucket = 0; bucket < HIST_BUCKETS; bucket++) {
+        uint64_t in_bucket = stats.buckets[phase][bucket].load(std::memory_order_relaxed);
+        if (in_bucket == 0) {
+            continue;
+        }
+        seen += in_bucket;
+        uint64_t up_to_ns = bucket + 1 < HIST_BUCKETS ? hist_bucket_start(bucket + 1) : UINT64_MAX;
+        while (percentile < percentiles && seen >= stats_percentiles[percentile] / 100 * count) {
+            napi_create_double(env, std::min(up_to_ns, max_ns) / 1e3, &value);
+            napi_set_named_property(env, result, stats_percentile_names[percentile], value);
+            percentile++;
+        }
+        napi_value entry;
+        napi_create_object(env, &entry);
+        napi_create_double(env, up_to_ns / 1e3, &value);
+        napi_set_named_property(env, entry, "upToUs", value);
+        napi_create_int64(env, in_bucket, &value);
+        napi_set_named_property(env, entry, "count", value);
+        napi_set_element(env, buckets, bucket_count++, entry);
+    }
+    /* nothing recorded yet */
+    for (; percentile < percentiles; percentile++) {
+        napi_create_double(env, 0, &value);
+        napi_set_named_property(env, result, stats_percentile_names[percentile], value);
+    }
+    napi_set_named_property(env, result, "buckets", buckets);
+    return result;
+}
+
+/* getStats() - cache stats, compile time of every cached filter, time spent waiting for filter states,
+   latency histograms per phase, the async work in flight, coalesced async calls and the result cache. counters are kept per thread
+   and summed here */
+napi_value GetStats(napi_env env, napi_callback_info info) {
+    ThreadStats* stats = new ThreadStats();
+    stats_collect(*stats);
+    std::vector<CachedFilterStats> filters;
+    cache.filter_stats(filters);
+
+    napi_value result, value;
+    napi_create_object(env, &result);
+    napi_set_named_property(env, result, "cache", cache_stats_to_napi(env));
+
+    napi_value filter_list;
+    napi_create_array_with_length(env, filters.size(), &filter_list);
+    for (size_t i = 0; i < filters.size(); i++) {
+        napi_value entry;
+        napi_create_object(env, &entry);
+        napi_create_string_utf8(env, filters[i].filter.c_str(), filters[i].filter.size(), &value);
+        napi_set_named_property(env, entry, "filter", value);
+        napi_create_double(env, filters[i].compile_us, &value);
+        napi_set_named_property(env, entry, "compileUs", value);
+        napi_create_int64(env, filters[i].footprint, &value);
+        napi_set_named_property(env, entry, "bytes", value);
+        napi_create_int64(env, filters[i].states, &value);
+        napi_set_named_property(env, entry, "states", value);
+        napi_create_int64(env, filters[i].idle, &value);
+        napi_set_named_property(env, entry, "idleStates", value);
+        napi_set_element(env, filter_list, i, entry);
+    }
+    napi_set_named_property(env, result, "filters", filter_list);
+
+    napi_value state_waits;
+    napi_create_object(env, &state_waits);
+    napi_create_int64(env, stats->state_waits.load(std::memory_order_relaxed), &value);
+    napi_set_named_property(env, state_waits, "count", value);
+    napi_create_double(env, stats->state_wait_ns.load(std::memory_order_relaxed) / 1e3, &value);
+    napi_set_named_property(env, state_waits, "totalUs", value);
+    napi_set_named_property(env, result, "stateWaits", state_waits);
+
+    napi_value latency;
+    napi_create_object(env, &latency);
+    for (size_t phase = 0; phase < PHASE_COUNT; phase++) {
+        napi_set_named_property(env, latency, phase_names[phase], histogram_to_napi(env, *stats, (StatsPhase)phase));
+    }
+    napi_set_named_property(env, result, "latency", latency);
+
+    napi_create_int64(env, async_in_flight.load(std::memory_order_relaxed), &value);
+    napi_set_named_property(env, result, "asyncInFlight", value);
+    napi_create_int64(env, async_coalesced.load(std::memory_order_relaxed), &value);
+    napi_set_named_property(env, result, "asyncCoalesced", value);
+
+    napi_value pool;
+    WorkerPool* worker_pool = env_data(env)->worker_pool;
+    if (worker_pool != nullptr) {
+        napi_create_object(env, &pool);
+        napi_create_int64(env, worker_pool->threads(), &value);
+        napi_set_named_property(env, pool, "threads", value);
+        napi_create_int64(env, worker_pool->depth(), &value);
+        napi_set_named_property(env, pool, "queued", value);
+        napi_create_int64(env, worker_pool->rejected.load(), &value);
+        napi_set_named_property(env, pool, "rejected", value);
+        napi_create_int64(env, worker_pool->shed_depth.load(), &value);
+        napi_set_named_property(env, pool, "shed", value);
+        napi_create_int64(env, worker_pool->shed_wait.load(), &value);
+        napi_set_named_property(env, pool, "expired", value);
+    } else {
+        napi_get_null(env, &pool);
+    }
+    napi_set_named_property(env, result, "workerPool", pool);
+
+    size_t memo_entries, memo_bytes, memo_max_bytes;
+    uint64_t memo_ttl_ns, memo_hits, memo_misses, memo_evictions, memo_expired;
+    result_cache.stats(&memo_entries, &memo_bytes, &memo_max_bytes, &memo_ttl_ns, &memo_hits, &memo_misses,
+                       &memo_evictions, &memo_expired);
+    napi_value memo;
+    napi_create_object(env, &memo);
+    napi_create_int64(env, memo_entries, &value);
+    napi_set_named_property(env, memo, "entries", value);
+    napi_create_int64(env, memo_bytes, &value);
+    napi_set_named_property(env, memo, "bytes", value);
+    napi_create_int64(env, memo_max_bytes, &value);
+    napi_set_named_property(env, memo, "maxBytes", value);
+    napi_create_double(env, memo_ttl_ns / 1e6, &value);
+    napi_set_named_property(env, memo, "ttlMs", value);
+    napi_create_int64(env, memo_hits, &value);
+    napi_set_named_property(env, memo, "hits", value);
+    napi_create_int64(env, memo_misses, &value);
+    napi_set_named_property(env, memo, "misses", value);
+    napi_create_int64(env, memo_evictions, &value);
+    napi_set_named_property(env, memo, "evictions", value);
+    napi_create_int64(env, memo_expired, &value);
+    napi_set_named_property(env, memo, "expired", value);
+    napi_set_named_property(env, result, "resultCache", memo);
+    delete stats;
+    return result;
+}
+
+napi_value SetPoolSize(napi_env env, napi_callback_info info) {
+    size_t argc = 1;
+    napi_value args[1];
+    int64_t new_size;
+
+    napi_get_cb_info(env, info, &argc, args, nullptr, nullptr);
+    napi_status status;
+    if (argc < 1) {
+        napi_throw_type_error(env, nullptr, "Wrong number of arguments");
+        return nullptr;
+    }
+
+    status=napi_get_value_int64(env, args[0], &new_size);
+    if(!CheckNapiStatus(env,status,"error loading int64")){
+        return nullptr;
+    }
+    if (new_size <= 0) {
+        napi_throw_error(env, nullptr, "Pool size must be positive");
+        return nullptr;
+    }
+
+    DEBUG_LOG("Changing pool size from %zu to %lld", get_pool_size(), new_size);
+    global_pool_size.store(static_cast<size_t>(new_size), std::memory_order_relaxed);
+
+    napi_value result;
+    napi_create_int64(env, new_size, &result);
+    return result;
+}
+
+/* number field of options, def if it is missing. false with a pending exception if it isn't a
+   non negative number */
+static bool get_count_option(napi_env env, napi_value options, const char* name, double def, double* out) {
+    napi_value field;
+    napi_valuetype type;
+    *out = def;
+    napi_get_named_property(env, options, name, &field);
+    napi_typeof(env, field, &type);
+    if (type == napi_undefined || type == napi_null) {
+        return true;
+    }
+    if (type != napi_number || napi_get_value_double(env, field, out) != napi_ok || !(*out >= 0)) {
+        std::string message = std::string("Invalid ") + name + " option, expected a non negative number";
+        napi_throw_type_error(env, nullptr, message.c_str());
+        return false;
+    }
+    return true;
+}
+
+/* setWorkerPool(options) - run async calls on threads owned by the addon instead of the libuv pool:
+   {threads, affinity: [cpu, ...], maxQueue, maxWaitMs, overflow: "reject" | "shed"}. threads 0 (or no
+   options) goes back to the libuv pool. the previous pool stops taking calls and runs the ones queued on it
+   in the background */
+napi_value SetWorkerPool(napi_env env, napi_callback_info info) {
+    size_t argc = 1;
+    napi_value args[1];
+    napi_get_cb_info(env, info, &argc, args, nullptr, nullptr);
+
+    double threads = 0, max_queue = 0, max_wait_ms = 0;
+    std::vector<int> affinity;
+    bool shed = false;
+    napi_valuetype type = napi_undefined;
+    if (argc > 0) {
+        napi_typeof(env, args[0], &type);
+    }
+    if (type == napi_object) {
+        if (!get_count_option(env, args[0], "threads", 0, &threads) ||
+            !get_count_option(env, args[0], "maxQueue", 0, &max_queue) ||
+            !get_count_option(env, args[0], "maxWaitMs", 0, &max_wait_ms)) {
+            return nullptr;
+        }
+        napi_value field;
+        bool is_array = false;
+        napi_get_named_property(env, args[0], "affinity", &field);
+        napi_is_array(env, field, &is_array);
+        if (is_array) {
+            uint32_t len;
+            napi_get_array_length(env, field, &len);
+            for (uint32_t i = 0; i < len; i++) {
+                napi_value element;
+                int32_t cpu = -1;
+                napi_get_element(env, field, i, &element);
+                napi_get_value_int32(env, element, &cpu);
+                if (cpu < 0 || cpu >= CPU_SETSIZE) {
+                    napi_throw_type_error(env, nullptr, "Invalid affinity option, expected an array of cpu numbers");
+                    return nullptr;
+                }
+                affinity.push_back(cpu);
+            }
+        }
+        napi_get_named_property(env, args[0], "overflow", &field);
+        napi_typeof(env, field, &type);
+        if (type == napi_string) {
+            std::string overflow = FromNapiString(env, field);
+            if (overflow != "reject" && overflow != "shed") {
+                napi_throw_type_error(env, nullptr, "Invalid overflow option, expected \"reject\" or \"shed\"");
+                return nullptr;
+            }
+            shed = overflow == "shed";
+        }
+    } else if (type != napi_undefined && type != napi_null) {
+        napi_throw_type_error(env, nullptr, "Worker pool options must be an object");
+        return nullptr;
+    }
+    if (threads > 1024) {
+        napi_throw_error(env, nullptr, "Worker pool threads must be at most 1024");
+        return nullptr;
+    }
+
+    /* the pool of this env, other envs keep theirs */
+    EnvData* env_state = env_data(env);
+    DEBUG_LOG("Changing worker pool to %zu threads", (size_t)threads);
+    reap_retired_pools(env_state);
+    if (env_state->worker_pool != nullptr) {
+        /* the old pool runs what is queued on it on its own threads, the event loop doesn't wait for it */
+        global_worker_threads.fetch_sub(env_state->worker_pool->threads());
+        env_state->worker_pool->stop();
+        env_state->retired_pools.push_back(env_state->worker_pool);
+        env_state->worker_pool = nullptr;
+    }
+    if (threads > 0) {
+        env_state->worker_pool = new WorkerPool((size_t)threads, affinity, (size_t)max_queue,
+                                                (uint64_t)(max_wait_ms * 1e6), shed);
+        global_worker_threads.fetch_add((size_t)threads);
+    }
+
+    napi_value result;
+    napi_create_int64(env, (int64_t)threads, &result);
+    return result;
+}
+
 napi_value SetCacheSize(napi_env env, napi_callback_info info) {
     size_t argc = 1;
     napi_value args[1];
@@ -707,19 +3052,294 @@ napi_value SetCacheSize(napi_env env, napi_callback_info info) {
     return result;
 }
 
+/* setCacheMaxBytes(bytes) - byte budget of the filter cache by estimated footprint, 0 for none */
+napi_value SetCacheMaxBytes(napi_env env, napi_callback_info info) {
+    size_t argc = 1;
+    napi_value args[1];
+    int64_t max_bytes;
+
+    napi_get_cb_info(env, info, &argc, args, nullptr, nullptr);
+    if (argc < 1) {
+        napi_throw_type_error(env, nullptr, "Wrong number of arguments");
+        return nullptr;
+    }
+    if (napi_get_value_int64(env, args[0], &max_bytes) != napi_ok) {
+        napi_throw_type_error(env, nullptr, "Cache max bytes must be a number");
+        return nullptr;
+    }
+    if (max_bytes < 0) {
+        napi_throw_error(env, nullptr, "Cache max bytes must not be negative");
+        return nullptr;
+    }
+    cache.set_max_bytes(static_cast<size_t>(max_bytes));
+
+    napi_value result;
+    napi_create_int64(env, max_bytes, &result);
+    return result;
+}
+
+/* setFastPath(enabled) - run simple path filters without the jq VM (the default), false runs every filter on it.
+   returns the previous setting */
+napi_value SetFastPath(napi_env env, napi_callback_info info) {
+    size_t argc = 1;
+    napi_value args[1];
+    bool enabled;
+
+    napi_get_cb_info(env, info, &argc, args, nullptr, nullptr);
+    if (argc < 1 || napi_get_value_bool(env, args[0], &enabled) != napi_ok) {
+        napi_throw_type_error(env, nullptr, "Fast path flag must be a boolean");
+        return nullptr;
+    }
+    bool previous = fast_path_enabled.exchange(enabled, std::memory_order_relaxed);
+
+    napi_value result;
+    napi_get_boolean(env, previous, &result);
+    return result;
+}
+
+/* setInputProjection(enabled) - convert only the fields of js inputs a filter reads (the default), returns the previous setting */
+napi_value SetInputProjection(napi_env env, napi_callback_info info) {
+    size_t argc = 1;
+    napi_value args[1];
+    bool enabled;
+
+    napi_get_cb_info(env, info, &argc, args, nullptr, nullptr);
+    if (argc < 1 || napi_get_value_bool(env, args[0], &enabled) != napi_ok) {
+        napi_throw_type_error(env, nullptr, "Input projection flag must be a boolean");
+        return nullptr;
+    }
+    bool previous = projection_enabled.exchange(enabled, std::memory_order_relaxed);
+
+    napi_value result;
+    napi_get_boolean(env, previous, &result);
+    return result;
+}
+
+/* setAsyncCoalescing(enabled) - let execAsync calls identical to one in flight wait for its result, false
+   queues every call (the default). returns the previous setting */
+napi_value SetAsyncCoalescing(napi_env env, napi_callback_info info) {
+    size_t argc = 1;
+    napi_value args[1];
+    bool enabled;
+
+    napi_get_cb_info(env, info, &argc, args, nullptr, nullptr);
+    if (argc < 1 || napi_get_value_bool(env, args[0], &enabled) != napi_ok) {
+        napi_throw_type_error(env, nullptr, "Async coalescing flag must be a boolean");
+        return nullptr;
+    }
+    bool previous = coalescing_enabled.exchange(enabled, std::memory_order_relaxed);
+
+    napi_value result;
+    napi_get_boolean(env, previous, &result);
+    return result;
+}
+
+static const char* json_parser_names[] = { "jq", "simd", "scalar" };
+
+/* setJsonParser(name) - parser of JSON inputs: "jq" (jv_parse, the default), "simd" (vectorized, AVX2 when the
+   cpu has it) or "scalar" (the same parser without vector instructions). returns the previous name */
+napi_value SetJsonParser(napi_env env, napi_callback_info info) {
+    size_t argc = 1;
+    napi_value args[1];
+    napi_get_cb_info(env, info, &argc, args, nullptr, nullptr);
+
+    napi_valuetype type = napi_undefined;
+    if (argc > 0) {
+        napi_typeof(env, args[0], &type);
+    }
+    int parser = -1;
+    if (type == napi_string) {
+        std::string name = FromNapiString(env, args[0]);
+        for (int i = 0; i < 3; i++) {
+            if (name == json_parser_names[i]) {
+                parser = i;
+            }
+        }
+    }
+    if (parser < 0) {
+        napi_throw_type_error(env, nullptr, "JSON parser must be 'jq', 'simd' or 'scalar'");
+        return nullptr;
+    }
+    int previous = json_parser.exchange(parser, std::memory_order_relaxed);
+
+    napi_value result;
+    napi_create_string_utf8(env, json_parser_names[previous], NAPI_AUTO_LENGTH, &result);
+    return result;
+}
+
+/* setResultCache(options) - memoize results of exec, execMany, compiled filters and templates by filter and input:
+   {maxBytes, ttlMs}. no options or maxBytes 0 turns it off and drops what it holds. returns maxBytes */
+napi_value SetResultCache(napi_env env, napi_callback_info info) {
+    size_t argc = 1;
+    napi_value args[1];
+    napi_get_cb_info(env, info, &argc, args, nullptr, nullptr);
+
+    double max_bytes = 0, ttl_ms = 0;
+    napi_valuetype type = napi_undefined;
+    if (argc > 0) {
+        napi_typeof(env, args[0], &type);
+    }
+    if (type == napi_object) {
+        if (!get_count_option(env, args[0], "maxBytes", 0, &max_bytes) ||
+            !get_count_option(env, args[0], "ttlMs", 0, &ttl_ms)) {
+            return nullptr;
+        }
+    } else if (type != napi_undefined && type != napi_null) {
+        napi_throw_type_error(env, nullptr, "Result cache options must be an object");
+        return nullptr;
+    }
+    result_cache.configure((size_t)max_bytes, (uint64_t)(ttl_ms * 1e6));
+
+    napi_value result;
+    napi_create_int64(env, (int64_t)max_bytes, &result);
+    return result;
+}
+
+/* setLiteralHoisting(enabled) - compile filters differing only in literals once (the default), applies to
+   filters compiled afterwards. returns the previous setting */
+napi_value SetLiteralHoisting(napi_env env, napi_callback_info info) {
+    size_t argc = 1;
+    napi_value args[1];
+    bool enabled;
+
+    napi_get_cb_info(env, info, &argc, args, nullptr, nullptr);
+    if (argc < 1 || napi_get_value_bool(env, args[0], &enabled) != napi_ok) {
+        napi_throw_type_error(env, nullptr, "Literal hoisting flag must be a boolean");
+        return nullptr;
+    }
+    bool previous = literal_hoisting_enabled.exchange(enabled, std::memory_order_relaxed);
+
+    napi_value result;
+    napi_get_boolean(env, previous, &result);
+    return result;
+}
+
 napi_value Init(napi_env env, napi_value exports) {
-    napi_value exec_sync, exec_async, cache_size_fn,cache_stats_fn;
+    /* every env (the main thread and each worker_thread) gets its own classes and pool */
+    EnvData* data = new EnvData();
+    data->env = env;
+    napi_set_instance_data(env, data, FinalizeEnvData, nullptr);
+
+    napi_value exec_sync, exec_async, cache_size_fn, cache_stats_fn, pool_size_fn;
 
     napi_create_function(env, "execSync", NAPI_AUTO_LENGTH, ExecSync, nullptr, &exec_sync);
     napi_create_function(env, "execAsync", NAPI_AUTO_LENGTH, ExecAsync, nullptr, &exec_async);
     // napi_create_function(env, "setDebugMode", NAPI_AUTO_LENGTH, SetDebugMode, nullptr, &debug_fn);
     napi_create_function(env, "setCacheSize", NAPI_AUTO_LENGTH, SetCacheSize, nullptr, &cache_size_fn);
-    // napi_create_function(env, "getCacheStats", NAPI_AUTO_LENGTH, GetCacheStats, nullptr, &cache_stats_fn);
+    napi_create_function(env, "getCacheStats", NAPI_AUTO_LENGTH, GetCacheStats, nullptr, &cache_stats_fn);
+    napi_create_function(env, "setPoolSize", NAPI_AUTO_LENGTH, SetPoolSize, nullptr, &pool_size_fn);
     napi_set_named_property(env, exports, "execSync", exec_sync);
     napi_set_named_property(env, exports, "execAsync", exec_async);
     // napi_set_named_property(env, exports, "setDebugMode", debug_fn);
     napi_set_named_property(env, exports, "setCacheSize", cache_size_fn);
-    // napi_set_named_property(env, exports, "getCacheStats", cache_stats_fn);
+    napi_set_named_property(env, exports, "getCacheStats", cache_stats_fn);
+    napi_set_named_property(env, exports, "setPoolSize", pool_size_fn);
+
+    napi_value cache_max_bytes_fn;
+    napi_create_function(env, "setCacheMaxBytes", NAPI_AUTO_LENGTH, SetCacheMaxBytes, nullptr, &cache_max_bytes_fn);
+    napi_set_named_property(env, exports, "setCacheMaxBytes", cache_max_bytes_fn);
+
+    napi_value fast_path_fn;
+    napi_create_function(env, "setFastPath", NAPI_AUTO_LENGTH, SetFastPath, nullptr, &fast_path_fn);
+    napi_set_named_property(env, exports, "setFastPath", fast_path_fn);
+
+    napi_value projection_fn;
+    napi_create_function(env, "setInputProjection", NAPI_AUTO_LENGTH, SetInputProjection, nullptr, &projection_fn);
+    napi_set_named_property(env, exports, "setInputProjection", projection_fn);
+
+    napi_value result_cache_fn;
+    napi_create_function(env, "setResultCache", NAPI_AUTO_LENGTH, SetResultCache, nullptr, &result_cache_fn);
+    napi_set_named_property(env, exports, "setResultCache", result_cache_fn);
+
+    napi_value json_parser_fn;
+    napi_create_function(env, "setJsonParser", NAPI_AUTO_LENGTH, SetJsonParser, nullptr, &json_parser_fn);
+    napi_set_named_property(env, exports, "setJsonParser", json_parser_fn);
+
+    napi_value coalescing_fn;
+    napi_create_function(env, "setAsyncCoalescing", NAPI_AUTO_LENGTH, SetAsyncCoalescing, nullptr, &coalescing_fn);
+    napi_set_named_property(env, exports, "setAsyncCoalescing", coalescing_fn);
+
+    napi_value hoisting_fn;
+    napi_create_function(env, "setLiteralHoisting", NAPI_AUTO_LENGTH, SetLiteralHoisting, nullptr, &hoisting_fn);
+    napi_set_named_property(env, exports, "setLiteralHoisting", hoisting_fn);
+
+    napi_value stats_fn;
+    napi_create_function(env, "getStats", NAPI_AUTO_LENGTH, GetStats, nullptr, &stats_fn);
+    napi_set_named_property(env, exports, "getStats", stats_fn);
+
+    napi_value worker_pool_fn;
+    napi_create_function(env, "setWorkerPool", NAPI_AUTO_LENGTH, SetWorkerPool, nullptr, &worker_pool_fn);
+    napi_set_named_property(env, exports, "setWorkerPool", worker_pool_fn);
+    napi_add_env_cleanup_hook(env, CleanupEnv, data);
+
+    napi_value exec_many, exec_many_async, compile_filters, filter_set_class;
+    napi_property_descriptor filter_set_methods[] = {
+        { "exec", nullptr, FilterSetExec, nullptr, nullptr, nullptr, napi_default, nullptr },
+        { "execAsync", nullptr, FilterSetExecAsync, nullptr, nullptr, nullptr, napi_default, nullptr },
+    };
+    napi_define_class(env, "FilterSet", NAPI_AUTO_LENGTH, WrapExternalConstructor, reinterpret_cast<void*>(FinalizeFilterSet),
+                      sizeof(filter_set_methods) / sizeof(filter_set_methods[0]), filter_set_methods, &filter_set_class);
+    napi_create_reference(env, filter_set_class, 1, &data->filter_set_constructor);
+    napi_create_function(env, "execMany", NAPI_AUTO_LENGTH, ExecMany, nullptr, &exec_many);
+    napi_create_function(env, "execManyAsync", NAPI_AUTO_LENGTH, ExecManyAsync, nullptr, &exec_many_async);
+    napi_create_function(env, "compileFilters", NAPI_AUTO_LENGTH, CompileFilters, nullptr, &compile_filters);
+    napi_set_named_property(env, exports, "execMany", exec_many);
+    napi_set_named_property(env, exports, "execManyAsync", exec_many_async);
+    napi_set_named_property(env, exports, "compileFilters", compile_filters);
+
+    napi_value exec_batch, exec_batch_async;
+    napi_create_function(env, "execBatch", NAPI_AUTO_LENGTH, ExecBatch, nullptr, &exec_batch);
+    napi_create_function(env, "execBatchAsync", NAPI_AUTO_LENGTH, ExecBatchAsync, nullptr, &exec_batch_async);
+    napi_set_named_property(env, exports, "execBatch", exec_batch);
+    napi_set_named_property(env, exports, "execBatchAsync", exec_batch_async);
+
+    napi_value create_document, document_class;
+    napi_property_descriptor document_methods[] = {
+        { "execMany", nullptr, DocumentExecMany, nullptr, nullptr, nullptr, napi_default, nullptr },
+        { "execManyAsync", nullptr, DocumentExecManyAsync, nullptr, nullptr, nullptr, napi_default, nullptr },
+    };
+    napi_define_class(env, "Document", NAPI_AUTO_LENGTH, WrapExternalConstructor, reinterpret_cast<void*>(FinalizeDocument),
+                      sizeof(document_methods) / sizeof(document_methods[0]), document_methods, &document_class);
+    napi_create_reference(env, document_class, 1, &data->document_constructor);
+    napi_create_function(env, "createDocument", NAPI_AUTO_LENGTH, CreateDocument, nullptr, &create_document);
+    napi_set_named_property(env, exports, "createDocument", create_document);
+
+    napi_value exec_all, exec_all_async, create_iterator, iterator_class;
+    napi_property_descriptor iterator_methods[] = {
+        { "next", nullptr, IteratorNext, nullptr, nullptr, nullptr, napi_default, nullptr },
+        { "nextAsync", nullptr, IteratorNextAsync, nullptr, nullptr, nullptr, napi_default, nullptr },
+        { "close", nullptr, IteratorClose, nullptr, nullptr, nullptr, napi_default, nullptr },
+    };
+    napi_define_class(env, "JqIterator", NAPI_AUTO_LENGTH, WrapExternalConstructor, reinterpret_cast<void*>(FinalizeIterator),
+                      sizeof(iterator_methods) / sizeof(iterator_methods[0]), iterator_methods, &iterator_class);
+    napi_create_reference(env, iterator_class, 1, &data->iterator_constructor);
+    napi_create_function(env, "execAll", NAPI_AUTO_LENGTH, ExecAll, nullptr, &exec_all);
+    napi_create_function(env, "execAllAsync", NAPI_AUTO_LENGTH, ExecAllAsync, nullptr, &exec_all_async);
+    napi_create_function(env, "createIterator", NAPI_AUTO_LENGTH, CreateIterator, nullptr, &create_iterator);
+    napi_set_named_property(env, exports, "execAll", exec_all);
+    napi_set_named_property(env, exports, "execAllAsync", exec_all_async);
+    napi_set_named_property(env, exports, "createIterator", create_iterator);
+
+    napi_value create_stream, stream_class;
+    napi_property_descriptor stream_methods[] = {
+        { "writeAsync", nullptr, StreamWriteAsync, nullptr, nullptr, nullptr, napi_default, nullptr },
+        { "close", nullptr, StreamClose, nullptr, nullptr, nullptr, napi_default, nullptr },
+    };
+    napi_define_class(env, "JqStream", NAPI_AUTO_LENGTH, WrapExternalConstructor, reinterpret_cast<void*>(FinalizeStream),
+                      sizeof(stream_methods) / sizeof(stream_methods[0]), stream_methods, &stream_class);
+    napi_create_reference(env, stream_class, 1, &data->stream_constructor);
+    napi_create_function(env, "createStream", NAPI_AUTO_LENGTH, CreateStream, nullptr, &create_stream);
+    napi_set_named_property(env, exports, "createStream", create_stream);
+
+    napi_value create_cancel_token, cancel_token_class;
+    napi_property_descriptor cancel_token_methods[] = {
+        { "abort", nullptr, CancelTokenAbort, nullptr, nullptr, nullptr, napi_default, nullptr },
+    };
+    napi_define_class(env, "JqCancelToken", NAPI_AUTO_LENGTH, WrapExternalConstructor, reinterpret_cast<void*>(FinalizeCancelToken),
+                      sizeof(cancel_token_methods) / sizeof(cancel_token_methods[0]), cancel_token_methods, &cancel_token_class);
+    napi_create_reference(env, cancel_token_class, 1, &data->cancel_token_constructor);
+    napi_create_function(env, "createCancelToken", NAPI_AUTO_LENGTH, CreateCancelToken, nullptr, &create_cancel_token);
+    napi_set_named_property(env, exports, "createCancelToken", create_cancel_token);
     return exports;
 }
 
@@ -1,12 +1,132 @@
 #ifndef SRC_BINDING_H_
 #define SRC_BINDING_H_
 
-#include <napi.h> 
+#include <napi.h>
 
 extern "C" {
     #include "jq.h"
 }
 
+#include <algorithm>
+#include <list>
+#include <map>
+#include <memory>
+#include <chrono>
+#include <deque>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <atomic>
+#include <functional>
+#include <assert.h>
 #include <string>
+#include <string_view>
+#include <stdio.h>
+#include <string.h>
+#include <cmath>
+#include <charconv>
+#include <float.h>
+#include <limits.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
 
-#endif 
+// #ifdef DEBUG_MODE
+// static bool debug_enabled = true;
+// #else
+// static bool debug_enabled = false;
+// #endif
+
+// #define DEBUG_LOG(fmt, ...) \
+//     do { if (debug_enabled) printf("[DEBUG] " fmt "\n", ##__VA_ARGS__); } while (0)
+
+// #define ASYNC_DEBUG_LOG(work, fmt, ...) \
+//     do { if (debug_enabled) printf("[DEBUG][ASYNC][%p] " fmt "\n", (jv*)work, ##__VA_ARGS__); } while (0)
+
+// #define CACHE_DEBUG_LOG(cache, fmt, ...) \
+//     do { if (debug_enabled) printf("[DEBUG][CACHE][%p] " fmt "\n", (void*)cache, ##__VA_ARGS__); } while (0)
+
+// #define WRAPPER_DEBUG_LOG(wrapper, fmt, ...) \
+//     do { if (debug_enabled) printf("[DEBUG][WRAPPER:%p] " fmt "\n", (void*)wrapper, ##__VA_ARGS__); } while (0)
+#ifdef ENABLE_DEBUG  // We'll use ENABLE_DEBUG as our flag name
+#define DEBUG_ENABLED 1
+#else
+#define DEBUG_ENABLED 0
+#endif
+
+#ifdef ENABLE_DEBUG
+#define DEBUG_LOG(fmt, ...) fprintf(stderr, "[DEBUG] " fmt "\n", ##__VA_ARGS__)
+#define ASYNC_DEBUG_LOG(work, fmt, ...) fprintf(stderr, "[DEBUG][ASYNC][%p] " fmt "\n", (void*)work, ##__VA_ARGS__)
+#define CACHE_DEBUG_LOG(cache, fmt, ...) fprintf(stderr, "[DEBUG][CACHE][%p] " fmt "\n", (void*)cache, ##__VA_ARGS__)
+#define WRAPPER_DEBUG_LOG(wrapper, fmt, ...) fprintf(stderr, "[DEBUG][WRAPPER][%p] " fmt "\n", (void*)wrapper, ##__VA_ARGS__)
+#else
+#define DEBUG_LOG(fmt, ...) ((void)0)
+#define ASYNC_DEBUG_LOG(work, fmt, ...) ((void)0)
+#define CACHE_DEBUG_LOG(cache, fmt, ...) ((void)0)
+#define WRAPPER_DEBUG_LOG(wrapper, fmt, ...) ((void)0)
+#endif
+
+extern size_t global_cache_size;
+extern unsigned int global_timeout_sec;
+extern std::atomic<size_t> global_worker_threads;
+size_t get_worker_thread_count();
+
+/* err_data and throw_err_cb to get jq error message*/
+struct err_data {
+    char buf[4096];
+};
+void throw_err_cb(void* data, jv msg);
+extern struct err_data runtime_err;
+
+/* check napi status to throw error if napi_status is not ok */
+inline bool CheckNapiStatus(napi_env env, napi_status status, const char* message) {
+    if (status != napi_ok) {
+        napi_throw_error(env, nullptr, message);
+        return false;
+    }
+    return true;
+}
+
+extern std::atomic<int64_t> async_in_flight;
+
+class WorkerPool;
+
+/* state of one env, the main thread or a worker_thread that loaded the addon, kept as its instance data.
+   compiled filters, the result cache and the settings are process wide, so every env shares them */
+struct EnvData {
+    napi_env env;
+    /* classes of the objects handed to js. cancel tokens are JqCancelToken objects wrapping an ExecControl */
+    napi_ref filter_set_constructor;
+    napi_ref document_constructor;
+    napi_ref iterator_constructor;
+    napi_ref stream_constructor;
+    napi_ref cancel_token_constructor;
+    /* the dedicated pool of the env's async calls (null to use the libuv pool) and the threadsafe function
+       its tasks complete through. both are only replaced on the js thread */
+    WorkerPool* worker_pool;
+    napi_threadsafe_function pool_tsfn;
+    /* pool tasks whose complete callback hasn't run yet, the tsfn keeps the loop alive while there are any */
+    size_t pool_pending;
+    /* replaced pools still running their queued tasks, deleted once their workers exit */
+    std::vector<WorkerPool*> retired_pools;
+};
+
+EnvData* env_data(napi_env env);
+
+/* result of running one filter, value is the first output */
+struct FilterResult {
+    bool success;
+    bool is_undefined;
+    jv value;
+    std::string error;
+};
+
+/* how results are handed to js: converted to js values, or as the JSON text jq dumps them to
+   (a string or a Buffer), which skips building the js value when it is only serialized again */
+enum OutputFormat { OUTPUT_VALUE, OUTPUT_JSON, OUTPUT_BUFFER };
+
+/* priority of an async call, only used by the dedicated worker pool */
+enum WorkPriority { PRIORITY_HIGH, PRIORITY_NORMAL, PRIORITY_LOW, PRIORITY_LEVELS };
+
+#endif
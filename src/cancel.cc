@@ -0,0 +1,144 @@
+#include "src/binding.h"
+#include "src/cancel.h"
+#include "src/stats.h"
+
+void control_unref(ExecControl* control) {
+    if (control != nullptr && control->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        delete control;
+    }
+}
+
+/* abort the call with reason, from any thread. the first reason wins */
+void control_abort(ExecControl* control, const char* reason) {
+    const char* expected = nullptr;
+    control->reason.compare_exchange_strong(expected, reason, std::memory_order_acq_rel);
+}
+
+/* error of an aborted call, null if it may (still) run */
+const char* control_error(ExecControl* control) {
+    if (control == nullptr) {
+        return nullptr;
+    }
+    return control->reason.load(std::memory_order_acquire);
+}
+
+/* timeout_sec for a jq_next of the call, cut to its deadline. jq_next only takes whole seconds, so
+   this rounds up and the check before the next jq_next does the rest */
+unsigned int control_timeout(ExecControl* control, unsigned int timeout_sec) {
+    if (control == nullptr || control->deadline_ns == 0) {
+        return timeout_sec;
+    }
+    uint64_t now = stats_now();
+    uint64_t left = control->deadline_ns > now ? control->deadline_ns - now : 0;
+    unsigned int left_sec = (unsigned int)std::max<uint64_t>(1, (left + 999999999) / 1000000000);
+    return timeout_sec == 0 ? left_sec : std::min(timeout_sec, left_sec);
+}
+
+/* true if a started jq may run for the call. false if it was aborted, then it must not run */
+bool control_begin(ExecControl* control) {
+    return control_error(control) == nullptr;
+}
+
+/* done running jq for the call, on the thread that ran it. returns the error if the call was aborted,
+   halting jq so nothing resumes it; the next jq_start resets it */
+const char* control_end(ExecControl* control, jq_state* jq) {
+    const char* reason = control_error(control);
+    if (reason != nullptr && !jq_halted(jq)) {
+        /* the filter may have called halt itself */
+        jq_halt(jq, jv_invalid(), jv_invalid());
+    }
+    return reason;
+}
+
+/* deadlines of running calls, expired by one thread started with the first deadline */
+static pthread_mutex_t watchdog_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t watchdog_cond = PTHREAD_COND_INITIALIZER;
+static std::multimap<uint64_t, ExecControl*> watchdog_deadlines;
+static bool watchdog_started = false;
+
+static void* watchdog_main(void* arg) {
+    pthread_mutex_lock(&watchdog_mutex);
+    for (;;) {
+        if (watchdog_deadlines.empty()) {
+            pthread_cond_wait(&watchdog_cond, &watchdog_mutex);
+            continue;
+        }
+        auto first = watchdog_deadlines.begin();
+        uint64_t now = stats_now();
+        if (first->first <= now) {
+            ExecControl* control = first->second;
+            watchdog_deadlines.erase(first);
+            control->watched = false;
+            pthread_mutex_unlock(&watchdog_mutex);
+            control_abort(control, TIMEOUT_ERROR);
+            control_unref(control);
+            pthread_mutex_lock(&watchdog_mutex);
+            continue;
+        }
+        /* condition variables wait on the realtime clock, a jump only makes the wait end early or late
+           once, the deadline is checked again on the monotonic clock */
+        uint64_t wait_ns = first->first - now;
+        struct timespec until;
+        clock_gettime(CLOCK_REALTIME, &until);
+        uint64_t until_ns = (uint64_t)until.tv_nsec + wait_ns;
+        until.tv_sec += until_ns / 1000000000;
+        until.tv_nsec = until_ns % 1000000000;
+        pthread_cond_timedwait(&watchdog_cond, &watchdog_mutex, &until);
+    }
+    return nullptr;
+}
+
+/* abort control with TIMEOUT_ERROR once timeout_ms passed */
+static void watch_deadline(ExecControl* control, double timeout_ms) {
+    control->deadline_ns = stats_now() + (uint64_t)(timeout_ms * 1e6);
+    control->refs.fetch_add(1, std::memory_order_relaxed);
+    pthread_mutex_lock(&watchdog_mutex);
+    if (!watchdog_started) {
+        pthread_t thread;
+        watchdog_started = pthread_create(&thread, nullptr, watchdog_main, nullptr) == 0;
+        if (watchdog_started) {
+            pthread_detach(thread);
+        }
+    }
+    control->watch_pos = watchdog_deadlines.emplace(control->deadline_ns, control);
+    control->watched = true;
+    /* wake the watchdog if this is its new first deadline */
+    if (control->watch_pos == watchdog_deadlines.begin()) {
+        pthread_cond_signal(&watchdog_cond);
+    }
+    pthread_mutex_unlock(&watchdog_mutex);
+}
+
+/* control of an async call with the options' token and deadline, null if it has neither. released with
+   finish_control */
+ExecControl* start_control(ExecControl* token, double timeout_ms) {
+    ExecControl* control = token;
+    if (control != nullptr) {
+        control->used = true;
+        control->refs.fetch_add(1, std::memory_order_relaxed);
+    } else if (timeout_ms > 0) {
+        control = new ExecControl();
+    }
+    if (control != nullptr && timeout_ms > 0) {
+        watch_deadline(control, timeout_ms);
+    }
+    return control;
+}
+
+/* the call is done, drop its deadline and its reference */
+void finish_control(ExecControl* control) {
+    if (control == nullptr) {
+        return;
+    }
+    pthread_mutex_lock(&watchdog_mutex);
+    bool watched = control->watched;
+    if (watched) {
+        watchdog_deadlines.erase(control->watch_pos);
+        control->watched = false;
+    }
+    pthread_mutex_unlock(&watchdog_mutex);
+    if (watched) {
+        control_unref(control);
+    }
+    control_unref(control);
+}
@@ -0,0 +1,38 @@
+#ifndef SRC_CANCEL_H_
+#define SRC_CANCEL_H_
+
+#include "src/binding.h"
+
+/* cancellation of an async call, by abort() on its cancel token or by its deadline (timeoutMs). jq states
+   are only touched by the thread running them: abort sets a flag, which the worker checks before every
+   jq_next and which makes it halt its own state and drop the call. a filter busy on one output stops at
+   that output, or earlier past its deadline, which the worker hands to jq_next as its timeout. a call
+   aborted before it starts doesn't run at all. shared by the token, the call and the watchdog, freed
+   with the last reference */
+struct ExecControl {
+    std::atomic<size_t> refs;
+    /* error of an aborted call, null while it may run. the first reason wins */
+    std::atomic<const char*> reason;
+    /* a token cancels one call, only touched on the js thread */
+    bool used;
+    /* deadline in stats_now() time, 0 for none. the watchdog holds a reference while it is queued */
+    uint64_t deadline_ns;
+    bool watched;
+    std::multimap<uint64_t, ExecControl*>::iterator watch_pos;
+
+    ExecControl() : refs(1), reason(nullptr), used(false), deadline_ns(0), watched(false) {}
+};
+
+#define ABORTED_ERROR "jq: error: aborted"
+#define TIMEOUT_ERROR "jq: error: timeout"
+
+void control_unref(ExecControl* control);
+void control_abort(ExecControl* control, const char* reason);
+const char* control_error(ExecControl* control);
+unsigned int control_timeout(ExecControl* control, unsigned int timeout_sec);
+bool control_begin(ExecControl* control);
+const char* control_end(ExecControl* control, jq_state* jq);
+ExecControl* start_control(ExecControl* token, double timeout_ms);
+void finish_control(ExecControl* control);
+
+#endif
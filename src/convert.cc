@@ -0,0 +1,730 @@
+#include "src/binding.h"
+#include "src/convert.h"
+#include "src/stats.h"
+#include "src/json_parser.h"
+
+std::string FromNapiString(napi_env env, napi_value value) {
+    size_t str_size;
+    size_t str_size_out;
+    napi_status status;
+    status=napi_get_value_string_utf8(env, value, nullptr, 0, &str_size);
+    if(!CheckNapiStatus(env,status,"error loading string lenth")){
+        return "";
+    }
+    if (str_size == 0) {
+        return "";
+    }
+    /* copy straight into the string, std::string keeps room for the terminator napi writes */
+    std::string result(str_size, '\0');
+    status=napi_get_value_string_utf8(env, value, &result[0], str_size + 1, &str_size_out);
+    if(!CheckNapiStatus(env,status,"error loading string")){
+        return "";
+    }
+    result.resize(str_size_out);
+    return result;
+}
+
+/* dump a result (consumed) for a raw output format. done where the result is produced, on the
+   worker for async calls, so the js thread only has to wrap the bytes */
+jv prepare_output(jv value, OutputFormat output) {
+    if (output == OUTPUT_VALUE || !jv_is_valid(value)) {
+        return value;
+    }
+    uint64_t start = stats_now();
+    jv dumped = jv_dump_string(value, 0);
+    stats_record(PHASE_SERIALIZE, start);
+    return dumped;
+}
+
+/* interned keys per converter, beyond this keys are created every time */
+#define CONVERTER_MAX_KEYS 4096
+
+static napi_status converter_key(NapiConverter& conv, jv key, napi_value* out) {
+    std::string_view name(jv_string_value(key), jv_string_length_bytes(jv_copy(key)));
+    auto it = conv.keys.find(name);
+    if (it != conv.keys.end()) {
+        *out = it->second;
+        return napi_ok;
+    }
+    napi_status status = napi_create_string_utf8(conv.env, name.data(), name.size(), out);
+    if (status == napi_ok && conv.keys.size() < CONVERTER_MAX_KEYS) {
+        conv.key_names.emplace_back(name);
+        conv.keys.emplace(conv.key_names.back(), *out);
+    }
+    return status;
+}
+
+/* convert a valid jv (not consumed) to a js value */
+static bool jv_to_napi(NapiConverter& conv, jv actual, napi_value* out, std::string& err_msg) {
+    napi_env env = conv.env;
+    napi_status status = napi_invalid_arg;
+    switch (jv_get_kind(actual)) {
+        case JV_KIND_NULL:
+            status = napi_get_null(env, out);
+            break;
+        case JV_KIND_TRUE:
+            status = napi_get_boolean(env, true, out);
+            break;
+        case JV_KIND_FALSE:
+            status = napi_get_boolean(env, false, out);
+            break;
+        case JV_KIND_NUMBER: {
+            double num = jv_number_value(actual);
+            if (conv.json_numbers && std::isnan(num)) {
+                status = napi_get_null(env, out);
+                break;
+            }
+            if (conv.json_numbers && std::isinf(num)) {
+                num = num > 0 ? DBL_MAX : -DBL_MAX;
+            }
+            status = napi_create_double(env, num, out);
+            break;
+        }
+        case JV_KIND_STRING:
+            status = napi_create_string_utf8(env, jv_string_value(actual), jv_string_length_bytes(jv_copy(actual)), out);
+            break;
+        case JV_KIND_ARRAY: {
+            int len = jv_array_length(jv_copy(actual));
+            status = napi_create_array_with_length(env, len, out);
+            for (int i = 0; status == napi_ok && i < len; i++) {
+                napi_value element;
+                jv v = jv_array_get(jv_copy(actual), i);
+                bool success = jv_to_napi(conv, v, &element, err_msg);
+                jv_free(v);
+                if (!success) {
+                    return false;
+                }
+                status = napi_set_element(env, *out, i, element);
+            }
+            break;
+        }
+        case JV_KIND_OBJECT: {
+            status = napi_create_object(env, out);
+            /* nested objects push and pop their descriptors above ours */
+            size_t base = conv.props.size();
+            int iter = jv_object_iter(actual);
+            while (status == napi_ok && jv_object_iter_valid(actual, iter)) {
+                napi_property_descriptor prop = {};
+                jv key = jv_object_iter_key(actual, iter);
+                jv value = jv_object_iter_value(actual, iter);
+                bool success = converter_key(conv, key, &prop.name) == napi_ok &&
+                               jv_to_napi(conv, value, &prop.value, err_msg);
+                jv_free(key);
+                jv_free(value);
+                if (!success) {
+                    conv.props.resize(base);
+                    if (err_msg == "") {
+                        err_msg = "error creating napi object";
+                    }
+                    return false;
+                }
+                /* own data properties like JSON.parse makes, "__proto__" included */
+                prop.attributes = napi_default_jsproperty;
+                conv.props.push_back(prop);
+                iter = jv_object_iter_next(actual, iter);
+            }
+            if (status == napi_ok && conv.props.size() > base) {
+                status = napi_define_properties(env, *out, conv.props.size() - base, &conv.props[base]);
+            }
+            conv.props.resize(base);
+            break;
+        }
+        default:
+            break;
+    }
+    if (status != napi_ok) {
+        err_msg = "error creating napi object";
+        return false;
+    }
+    return true;
+}
+
+/* dumped output smaller than this is copied into a regular Buffer, larger output is handed over */
+#define EXTERNAL_BUFFER_MIN 4096
+
+static void free_dumped_output(napi_env env, void* data, void* hint) {
+    jv* dumped = static_cast<jv*>(hint);
+    napi_adjust_external_memory(env, -(int64_t)jv_string_length_bytes(jv_copy(*dumped)), nullptr);
+    jv_free(*dumped);
+    delete dumped;
+}
+
+/* convert a valid result (not consumed) for the converter's output format */
+bool output_to_napi(NapiConverter& conv, jv actual, napi_value* out, std::string& err_msg) {
+    if (conv.output == OUTPUT_VALUE) {
+        return jv_to_napi(conv, actual, out, err_msg);
+    }
+    const char* text = jv_string_value(actual);
+    size_t length = jv_string_length_bytes(jv_copy(actual));
+    napi_status status;
+    if (conv.output == OUTPUT_JSON) {
+        status = napi_create_string_utf8(conv.env, text, length, out);
+    } else if (length < EXTERNAL_BUFFER_MIN) {
+        status = napi_create_buffer_copy(conv.env, length, text, nullptr, out);
+    } else {
+        /* the Buffer keeps its own reference to the dumped string */
+        jv* dumped = new jv(jv_copy(actual));
+        status = napi_create_external_buffer(conv.env, length, const_cast<char*>(text), free_dumped_output, dumped, out);
+        if (status == napi_ok) {
+            napi_adjust_external_memory(conv.env, (int64_t)length, nullptr);
+        } else {
+            /* runtimes that don't allow external buffers */
+            jv_free(*dumped);
+            delete dumped;
+            status = napi_create_buffer_copy(conv.env, length, text, nullptr, out);
+        }
+    }
+    if (status != napi_ok) {
+        err_msg = "error creating napi object";
+        return false;
+    }
+    return true;
+}
+
+/* set ret[key] to the converted result, an invalid result without a message (no output) leaves ret alone */
+bool jv_object_to_napi(const char* key, NapiConverter& conv, jv actual, napi_value ret, std::string& err_msg) {
+    if (jv_get_kind(actual) == JV_KIND_INVALID) {
+        jv msg = jv_invalid_get_msg(jv_copy(actual));
+        if (jv_get_kind(msg) == JV_KIND_STRING) {
+            err_msg = std::string("jq: error: ") + jv_string_value(msg);
+            jv_free(msg);
+            return false;
+        }
+        jv_free(msg);
+        return true;
+    }
+    napi_value value;
+    if (!output_to_napi(conv, actual, &value, err_msg)) {
+        return false;
+    }
+    napi_set_named_property(conv.env, ret, key, value);
+    return true;
+}
+
+/* jv_parse refuses input nesting deeper than this (objects count twice, for the object and its key),
+   leave such input to JSON.stringify + jv_parse so the error is the same */
+#define WALK_MAX_DEPTH 256
+
+enum WalkResult { WALK_OK, WALK_SKIP, WALK_ABORT };
+
+struct WalkState {
+    size_t nodes_left;
+    napi_value object_proto;
+    std::string buf;
+};
+
+/* read a js string into the scratch buffer of the walk, short strings need a single napi call */
+static bool walk_string(napi_env env, napi_value value, WalkState* state) {
+    size_t len;
+    size_t capacity = std::max(state->buf.capacity(), (size_t)256);
+    state->buf.resize(capacity);
+    if (napi_get_value_string_utf8(env, value, &state->buf[0], capacity, &len) != napi_ok) {
+        return false;
+    }
+    if (len + 1 >= capacity) {
+        if (napi_get_value_string_utf8(env, value, nullptr, 0, &len) != napi_ok) {
+            return false;
+        }
+        state->buf.resize(len + 1);
+        if (napi_get_value_string_utf8(env, value, &state->buf[0], len + 1, &len) != napi_ok) {
+            return false;
+        }
+    }
+    state->buf.resize(len);
+    /* lone surrogates come back as U+FFFD, which jv_parse may reject for the escaped form. let it decide */
+    if (state->buf.find("\xEF\xBF\xBD") != std::string::npos) {
+        return false;
+    }
+    return true;
+}
+
+/* reverse of jv_object_to_napi, mirrors JSON.stringify for plain objects, arrays and primitives.
+   anything else (toJSON, class instances, bigint, cycles) aborts so the caller can fall back to JSON.stringify */
+static WalkResult napi_value_to_jv(napi_env env, napi_value value, jv* out, WalkState* state, int depth) {
+    if (state->nodes_left == 0) {
+        return WALK_ABORT;
+    }
+    state->nodes_left--;
+
+    napi_valuetype type;
+    if (napi_typeof(env, value, &type) != napi_ok) {
+        return WALK_ABORT;
+    }
+    switch (type) {
+        case napi_undefined:
+        case napi_function:
+        case napi_symbol:
+            return WALK_SKIP;
+        case napi_null:
+            *out = jv_null();
+            return WALK_OK;
+        case napi_boolean: {
+            bool b;
+            if (napi_get_value_bool(env, value, &b) != napi_ok) {
+                return WALK_ABORT;
+            }
+            *out = jv_bool(b);
+            return WALK_OK;
+        }
+        case napi_number: {
+            double num;
+            if (napi_get_value_double(env, value, &num) != napi_ok) {
+                return WALK_ABORT;
+            }
+            if (!std::isfinite(num)) {
+                *out = jv_null();
+            } else {
+                /* JSON.stringify(-0) is "0" */
+                *out = jv_number(num == 0 ? 0 : num);
+            }
+            return WALK_OK;
+        }
+        case napi_string: {
+            if (!walk_string(env, value, state)) {
+                return WALK_ABORT;
+            }
+            *out = jv_string_sized(state->buf.data(), state->buf.size());
+            return WALK_OK;
+        }
+        case napi_object:
+            break;
+        default:
+            return WALK_ABORT;
+    }
+
+    if (depth + 1 > WALK_MAX_DEPTH) {
+        return WALK_ABORT;
+    }
+    bool is_array;
+    if (napi_is_array(env, value, &is_array) != napi_ok) {
+        return WALK_ABORT;
+    }
+    if (is_array) {
+        uint32_t len;
+        if (napi_get_array_length(env, value, &len) != napi_ok) {
+            return WALK_ABORT;
+        }
+        jv arr = jv_array_sized(len);
+        for (uint32_t i = 0; i < len; i++) {
+            napi_value element;
+            jv item;
+            if (napi_get_element(env, value, i, &element) != napi_ok) {
+                jv_free(arr);
+                return WALK_ABORT;
+            }
+            WalkResult res = napi_value_to_jv(env, element, &item, state, depth + 1);
+            if (res == WALK_ABORT) {
+                jv_free(arr);
+                return WALK_ABORT;
+            }
+            arr = jv_array_append(arr, res == WALK_SKIP ? jv_null() : item);
+        }
+        *out = arr;
+        return WALK_OK;
+    }
+
+    napi_value proto;
+    if (napi_get_prototype(env, value, &proto) != napi_ok) {
+        return WALK_ABORT;
+    }
+    bool plain = false;
+    napi_strict_equals(env, proto, state->object_proto, &plain);
+    if (!plain) {
+        napi_valuetype proto_type;
+        napi_typeof(env, proto, &proto_type);
+        if (proto_type != napi_null) {
+            return WALK_ABORT;
+        }
+    }
+
+    napi_value keys;
+    uint32_t keys_len;
+    if (napi_get_all_property_names(env, value, napi_key_own_only,
+            static_cast<napi_key_filter>(napi_key_enumerable | napi_key_skip_symbols),
+            napi_key_numbers_to_strings, &keys) != napi_ok ||
+        napi_get_array_length(env, keys, &keys_len) != napi_ok) {
+        return WALK_ABORT;
+    }
+    jv obj = jv_object();
+    for (uint32_t i = 0; i < keys_len; i++) {
+        napi_value key, element;
+        jv item;
+        if (napi_get_element(env, keys, i, &key) != napi_ok ||
+            napi_get_property(env, value, key, &element) != napi_ok ||
+            !walk_string(env, key, state)) {
+            jv_free(obj);
+            return WALK_ABORT;
+        }
+        jv item_key = jv_string_sized(state->buf.data(), state->buf.size());
+        if (state->buf == "toJSON") {
+            napi_valuetype element_type;
+            napi_typeof(env, element, &element_type);
+            if (element_type == napi_function) {
+                jv_free(item_key);
+                jv_free(obj);
+                return WALK_ABORT;
+            }
+        }
+        WalkResult res = napi_value_to_jv(env, element, &item, state, depth + 2);
+        if (res == WALK_ABORT) {
+            jv_free(item_key);
+            jv_free(obj);
+            return WALK_ABORT;
+        }
+        if (res == WALK_SKIP) {
+            jv_free(item_key);
+            continue;
+        }
+        obj = jv_object_set(obj, item_key, item);
+    }
+    *out = obj;
+    return WALK_OK;
+}
+
+/* convert a js value into a jv input, walking at most walk_limit nodes before falling back to JSON.stringify.
+   returns false with a pending exception when the input can't be converted */
+static bool value_to_jv(napi_env env, napi_value value, size_t walk_limit, jv* out) {
+    if (walk_limit > 0) {
+        WalkState state;
+        napi_value global, object_ctor;
+        state.nodes_left = walk_limit;
+        if (napi_get_global(env, &global) == napi_ok &&
+            napi_get_named_property(env, global, "Object", &object_ctor) == napi_ok &&
+            napi_get_named_property(env, object_ctor, "prototype", &state.object_proto) == napi_ok) {
+            WalkResult res = napi_value_to_jv(env, value, out, &state, 0);
+            if (res == WALK_OK) {
+                return true;
+            }
+        }
+        DEBUG_LOG("Walk aborted, falling back to JSON.stringify");
+    }
+
+    napi_value global, json_obj, stringify, json_value;
+    napi_get_global(env, &global);
+    napi_get_named_property(env, global, "JSON", &json_obj);
+    napi_get_named_property(env, json_obj, "stringify", &stringify);
+    if (napi_call_function(env, json_obj, stringify, 1, &value, &json_value) != napi_ok) {
+        return false;
+    }
+    std::string json = FromNapiString(env, json_value);
+    if (json == "") {
+        napi_throw_error(env, nullptr, "Invalid JSON input");
+        return false;
+    }
+    *out = parse_json(json.c_str(), json.size());
+    if (!jv_is_valid(*out)) {
+        jv_free(*out);
+        napi_throw_error(env, nullptr, "Invalid JSON input");
+        return false;
+    }
+    return true;
+}
+
+/* a plain object as napi_value_to_jv walks it: Object.prototype or no prototype, no own toJSON function */
+static bool is_plain_object(napi_env env, napi_value value, napi_value object_proto) {
+    napi_value proto, to_json_key, to_json;
+    napi_valuetype type;
+    bool plain = false, has_to_json = false;
+    if (napi_get_prototype(env, value, &proto) != napi_ok) {
+        return false;
+    }
+    napi_strict_equals(env, proto, object_proto, &plain);
+    if (!plain && (napi_typeof(env, proto, &type) != napi_ok || type != napi_null)) {
+        return false;
+    }
+    napi_create_string_utf8(env, "toJSON", NAPI_AUTO_LENGTH, &to_json_key);
+    napi_has_own_property(env, value, to_json_key, &has_to_json);
+    if (has_to_json && napi_get_property(env, value, to_json_key, &to_json) == napi_ok &&
+        napi_typeof(env, to_json, &type) == napi_ok && type == napi_function) {
+        return false;
+    }
+    return true;
+}
+
+/* Object.prototype and its propertyIsEnumerable */
+static void get_object_proto(napi_env env, napi_value* object_proto, napi_value* is_enumerable) {
+    napi_value global, object_ctor;
+    napi_get_global(env, &global);
+    napi_get_named_property(env, global, "Object", &object_ctor);
+    napi_get_named_property(env, object_ctor, "prototype", object_proto);
+    napi_get_named_property(env, *object_proto, "propertyIsEnumerable", is_enumerable);
+}
+
+/* true, with a pending TypeError like JSON.stringify's, if value is one of the objects a walk came
+   through to reach it */
+static bool closes_cycle(napi_env env, const std::vector<napi_value>& ancestors, napi_value value) {
+    for (napi_value ancestor : ancestors) {
+        bool same = false;
+        napi_strict_equals(env, ancestor, value, &same);
+        if (same) {
+            napi_throw_type_error(env, nullptr, "Converting circular structure to JSON");
+            return true;
+        }
+    }
+    return false;
+}
+
+/* steps of a simple path on a js value, walking plain objects and arrays without converting them. a
+   value the walk doesn't know how to step into (a primitive, a class instance, an object with toJSON)
+   is converted like value_to_jv would and jv_get takes the rest of the path, so errors are jq's.
+   returns false with a pending exception if that conversion fails or the path runs into a cycle */
+static bool napi_path_get(napi_env env, const std::vector<PathStep>& steps, napi_value value, size_t walk_limit,
+                          napi_value object_proto, napi_value is_enumerable, jv* out) {
+    std::vector<napi_value> ancestors;
+    for (size_t i = 0; i < steps.size(); i++) {
+        const PathStep& step = steps[i];
+        napi_valuetype type;
+        bool is_array = false;
+        napi_typeof(env, value, &type);
+        /* skipped by the conversion or null, either way jv_get gives null for the rest of the path */
+        if (i > 0 && (type == napi_null || type == napi_undefined || type == napi_function || type == napi_symbol)) {
+            *out = jv_null();
+            return true;
+        }
+        if (type == napi_object) {
+            napi_is_array(env, value, &is_array);
+        }
+        if (is_array && step.is_index) {
+            uint32_t len;
+            napi_get_array_length(env, value, &len);
+            int64_t index = step.index < 0 ? (int64_t)step.index + len : step.index;
+            if (index < 0 || index >= (int64_t)len) {
+                *out = jv_null();
+                return true;
+            }
+            ancestors.push_back(value);
+            napi_get_element(env, value, (uint32_t)index, &value);
+            if (closes_cycle(env, ancestors, value)) {
+                return false;
+            }
+            continue;
+        }
+        if (type == napi_object && !is_array && !step.is_index && is_plain_object(env, value, object_proto)) {
+            napi_value key, enumerable;
+            bool found = false;
+            napi_create_string_utf8(env, step.key.data(), step.key.size(), &key);
+            napi_has_own_property(env, value, key, &found);
+            /* only own enumerable keys are converted */
+            if (found && napi_call_function(env, value, is_enumerable, 1, &key, &enumerable) == napi_ok) {
+                napi_get_value_bool(env, enumerable, &found);
+            }
+            if (!found) {
+                *out = jv_null();
+                return true;
+            }
+            ancestors.push_back(value);
+            napi_get_property(env, value, key, &value);
+            if (closes_cycle(env, ancestors, value)) {
+                return false;
+            }
+            continue;
+        }
+        jv converted;
+        if (!value_to_jv(env, value, walk_limit, &converted)) {
+            return false;
+        }
+        *out = simple_path_get(steps, i, converted);
+        return true;
+    }
+    napi_valuetype type;
+    napi_typeof(env, value, &type);
+    if (!steps.empty() && (type == napi_undefined || type == napi_function || type == napi_symbol)) {
+        *out = jv_null();
+        return true;
+    }
+    return value_to_jv(env, value, walk_limit, out);
+}
+
+/* simple_path_eval on a js object input, converting only the values the path ends on. the parts of the
+   input it doesn't reach aren't looked at, so an input value_to_jv would reject there (a cycle, a bigint)
+   still runs. a cycle on the path throws like JSON.stringify. false with a pending exception if a value
+   can't be converted */
+bool simple_path_eval_napi(napi_env env, const SimplePath& path, napi_value input, size_t walk_limit, jv* out) {
+    napi_value object_proto, is_enumerable;
+    get_object_proto(env, &object_proto, &is_enumerable);
+    for (size_t i = 0; i < path.paths.size(); i++) {
+        jv value;
+        if (!napi_path_get(env, path.paths[i], input, walk_limit, object_proto, is_enumerable, &value)) {
+            return false;
+        }
+        bool last = i + 1 == path.paths.size() && path.fallback_kind == JV_KIND_INVALID;
+        if (last || simple_path_defined(value)) {
+            *out = value;
+            return true;
+        }
+        jv_free(value);
+    }
+    *out = simple_path_fallback(path);
+    return true;
+}
+
+/* ancestors holds the objects projected on the way to value */
+static bool project_node(napi_env env, const ProjectionNode& node, napi_value value, size_t walk_limit,
+                         napi_value object_proto, napi_value is_enumerable, std::vector<napi_value>& ancestors,
+                         jv* out) {
+    napi_valuetype type;
+    bool is_array = true;
+    if (closes_cycle(env, ancestors, value)) {
+        return false;
+    }
+    if (node.whole || napi_typeof(env, value, &type) != napi_ok || type != napi_object ||
+        napi_is_array(env, value, &is_array) != napi_ok || is_array || !is_plain_object(env, value, object_proto)) {
+        return value_to_jv(env, value, walk_limit, out);
+    }
+    ancestors.push_back(value);
+    jv obj = jv_object();
+    for (const ProjectionNode& field : node.fields) {
+        napi_value key, enumerable, element;
+        napi_valuetype element_type;
+        bool found = false;
+        napi_create_string_utf8(env, field.key.data(), field.key.size(), &key);
+        napi_has_own_property(env, value, key, &found);
+        /* only own enumerable keys are converted */
+        if (found && napi_call_function(env, value, is_enumerable, 1, &key, &enumerable) == napi_ok) {
+            napi_get_value_bool(env, enumerable, &found);
+        }
+        if (!found) {
+            continue;
+        }
+        if (napi_get_property(env, value, key, &element) != napi_ok) {
+            ancestors.pop_back();
+            jv_free(obj);
+            return false;
+        }
+        napi_typeof(env, element, &element_type);
+        if (element_type == napi_undefined || element_type == napi_function || element_type == napi_symbol) {
+            continue;
+        }
+        jv item;
+        if (!project_node(env, field, element, walk_limit, object_proto, is_enumerable, ancestors, &item)) {
+            ancestors.pop_back();
+            jv_free(obj);
+            return false;
+        }
+        obj = jv_object_set(obj, jv_string_sized(field.key.data(), field.key.size()), item);
+    }
+    ancestors.pop_back();
+    *out = obj;
+    return true;
+}
+
+/* value_to_jv for a filter reading only projection of its input: plain objects along the projection
+   keep only its fields, whatever a field holds past it (or an array, a primitive, an object with
+   toJSON on the way) is converted whole. like simple paths, a part of the input the filter doesn't
+   read isn't looked at, a cycle in what it reads throws like JSON.stringify. false with a pending
+   exception if a value can't be converted */
+static bool project_input(napi_env env, const ProjectionNode& projection, napi_value value, size_t walk_limit, jv* out) {
+    napi_value object_proto, is_enumerable;
+    std::vector<napi_value> ancestors;
+    get_object_proto(env, &object_proto, &is_enumerable);
+    return project_node(env, projection, value, walk_limit, object_proto, is_enumerable, ancestors, out);
+}
+
+/* value_to_jv through projection when there is one */
+bool input_to_jv(napi_env env, const ProjectionNode* projection, napi_value value, size_t walk_limit, jv* out) {
+    if (projection != nullptr && projection_enabled.load(std::memory_order_relaxed)) {
+        return project_input(env, *projection, value, walk_limit, out);
+    }
+    return value_to_jv(env, value, walk_limit, out);
+}
+
+/* default node budget for walking js values. per node the walk costs about as much as
+   JSON.stringify + jv_parse (less for numbers, more for strings), so only small inputs are walked
+   and the time lost on a larger input before falling back stays bounded. see bench/input.bench.js */
+size_t global_walk_limit = 256;
+
+/* deep copy v, consumes v */
+jv jv_deep_copy(jv v) {
+    switch (jv_get_kind(v)) {
+        case JV_KIND_NUMBER: {
+            jv copy = jv_number(jv_number_value(v));
+            jv_free(v);
+            return copy;
+        }
+        case JV_KIND_STRING: {
+            jv copy = jv_string_sized(jv_string_value(v), jv_string_length_bytes(jv_copy(v)));
+            jv_free(v);
+            return copy;
+        }
+        case JV_KIND_ARRAY: {
+            int len = jv_array_length(jv_copy(v));
+            jv copy = jv_array_sized(len);
+            for (int i = 0; i < len; i++) {
+                copy = jv_array_append(copy, jv_deep_copy(jv_array_get(jv_copy(v), i)));
+            }
+            jv_free(v);
+            return copy;
+        }
+        case JV_KIND_OBJECT: {
+            jv copy = jv_object();
+            int iter = jv_object_iter(v);
+            while (jv_object_iter_valid(v, iter)) {
+                copy = jv_object_set(copy, jv_deep_copy(jv_object_iter_key(v, iter)), jv_deep_copy(jv_object_iter_value(v, iter)));
+                iter = jv_object_iter_next(v, iter);
+            }
+            jv_free(v);
+            return copy;
+        }
+        default:
+            return v;
+    }
+}
+
+/* true if no part of v is referenced from outside of v, owners is the number of references the caller knows of */
+static bool jv_is_unshared(jv v, int owners) {
+    switch (jv_get_kind(v)) {
+        case JV_KIND_NUMBER:
+        case JV_KIND_STRING:
+            return jv_get_refcnt(v) <= owners;
+        case JV_KIND_ARRAY: {
+            if (jv_get_refcnt(v) > owners) {
+                return false;
+            }
+            int len = jv_array_length(jv_copy(v));
+            for (int i = 0; i < len; i++) {
+                /* the array and our copy */
+                jv item = jv_array_get(jv_copy(v), i);
+                bool unshared = jv_is_unshared(item, 2);
+                jv_free(item);
+                if (!unshared) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        case JV_KIND_OBJECT: {
+            if (jv_get_refcnt(v) > owners) {
+                return false;
+            }
+            bool unshared = true;
+            int iter = jv_object_iter(v);
+            while (unshared && jv_object_iter_valid(v, iter)) {
+                jv key = jv_object_iter_key(v, iter);
+                jv value = jv_object_iter_value(v, iter);
+                unshared = jv_is_unshared(key, 2) && jv_is_unshared(value, 2);
+                jv_free(key);
+                jv_free(value);
+                iter = jv_object_iter_next(v, iter);
+            }
+            return unshared;
+        }
+        default:
+            return true;
+    }
+}
+
+/* result with nothing shared with other values, a copy if needed */
+jv jv_detach(jv result) {
+    if (jv_is_unshared(result, 1)) {
+        return result;
+    }
+    return jv_deep_copy(result);
+}
+
+/* take a result out of jq so it can move to another thread. jv refcounts aren't atomic and the result may
+   share values with the jq stack and with constants of the compiled program, which the next user of the
+   state touches. resets the state, then copies the result if anything in it is still shared */
+jv jq_detach_result(jq_state* jq, jv result) {
+    jq_start(jq, jv_null(), 0);
+    return jv_detach(result);
+}
@@ -0,0 +1,40 @@
+#ifndef SRC_CONVERT_H_
+#define SRC_CONVERT_H_
+
+#include "src/binding.h"
+#include "src/filter_analysis.h"
+
+/* conversions between js values and jv, and of jv results between threads */
+
+std::string FromNapiString(napi_env env, napi_value value);
+jv prepare_output(jv value, OutputFormat output);
+
+/* state of converting jv results to js values on the js thread. object keys are created as js strings
+   once per converter and reused (jq results are mostly arrays of objects sharing their keys), and
+   the property descriptors of objects being converted share one stack.
+   json_numbers maps nan to null and clamps infinities, like dumping and re-parsing the result would */
+struct NapiConverter {
+    napi_env env;
+    bool json_numbers;
+    /* results of a raw output format are already dumped by prepare_output */
+    OutputFormat output;
+    /* interned keys, viewing into key_names (deque elements don't move) since results can be freed
+       before the converter */
+    std::unordered_map<std::string_view, napi_value> keys;
+    std::deque<std::string> key_names;
+    std::vector<napi_property_descriptor> props;
+
+    NapiConverter(napi_env env_, bool json_numbers_, OutputFormat output_ = OUTPUT_VALUE)
+        : env(env_), json_numbers(json_numbers_), output(output_) {}
+};
+
+bool output_to_napi(NapiConverter& conv, jv actual, napi_value* out, std::string& err_msg);
+bool jv_object_to_napi(const char* key, NapiConverter& conv, jv actual, napi_value ret, std::string& err_msg);
+bool simple_path_eval_napi(napi_env env, const SimplePath& path, napi_value input, size_t walk_limit, jv* out);
+bool input_to_jv(napi_env env, const ProjectionNode* projection, napi_value value, size_t walk_limit, jv* out);
+extern size_t global_walk_limit;
+jv jv_deep_copy(jv v);
+jv jv_detach(jv result);
+jv jq_detach_result(jq_state* jq, jv result);
+
+#endif
@@ -0,0 +1,915 @@
+#include "src/binding.h"
+#include "src/filter_analysis.h"
+#include "src/filter_cache.h"
+
+/* the prefix lib/jq.js puts before filters that don't enable env, it doesn't change what a path outputs */
+#define NO_ENV_PREFIX "def env: {}; {} as $ENV | "
+
+/* simple paths run natively, setFastPath(false) sends them to the VM too */
+std::atomic<bool> fast_path_enabled(true);
+
+static bool is_ident_start(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+static bool is_ident_char(char c) {
+    return is_ident_start(c) || (c >= '0' && c <= '9');
+}
+
+static void skip_spaces(const std::string& s, size_t* pos) {
+    while (*pos < s.size() && (s[*pos] == ' ' || s[*pos] == '\t' || s[*pos] == '\n' || s[*pos] == '\r')) {
+        (*pos)++;
+    }
+}
+
+/* "..." without escapes or control characters */
+static bool parse_plain_string(const std::string& s, size_t* pos, std::string* out) {
+    if (*pos >= s.size() || s[*pos] != '"') {
+        return false;
+    }
+    size_t end = *pos + 1;
+    while (end < s.size() && s[end] != '"') {
+        if (s[end] == '\\' || (unsigned char)s[end] < 0x20) {
+            return false;
+        }
+        end++;
+    }
+    if (end == s.size()) {
+        return false;
+    }
+    out->assign(s, *pos + 1, end - *pos - 1);
+    *pos = end + 1;
+    return true;
+}
+
+/* digits of an integer short enough to be exact, without leading zeros */
+static bool parse_plain_integer(const std::string& s, size_t* pos, size_t max_digits, double* out) {
+    size_t end = *pos;
+    while (end < s.size() && s[end] >= '0' && s[end] <= '9') {
+        end++;
+    }
+    size_t digits = end - *pos;
+    if (digits == 0 || digits > max_digits || (digits > 1 && s[*pos] == '0') || (end < s.size() && (is_ident_char(s[end]) || s[end] == '.'))) {
+        return false;
+    }
+    *out = strtod(s.substr(*pos, digits).c_str(), nullptr);
+    *pos = end;
+    return true;
+}
+
+/* [N], [-N] or ["key"] */
+static bool parse_bracket_step(const std::string& s, size_t* pos, PathStep* step) {
+    size_t p = *pos + 1;
+    if (p < s.size() && s[p] == '"') {
+        step->is_index = false;
+        if (!parse_plain_string(s, &p, &step->key)) {
+            return false;
+        }
+    } else {
+        bool negative = p < s.size() && s[p] == '-';
+        double index;
+        if (negative) {
+            p++;
+        }
+        if (!parse_plain_integer(s, &p, 9, &index)) {
+            return false;
+        }
+        step->is_index = true;
+        step->index = negative ? -(int)index : (int)index;
+    }
+    if (p >= s.size() || s[p] != ']') {
+        return false;
+    }
+    *pos = p + 1;
+    return true;
+}
+
+/* a path starting with '.' at pos, the dot alone is the identity */
+static bool parse_path(const std::string& s, size_t* pos, std::vector<PathStep>* steps) {
+    size_t p = *pos + 1;
+    /* after a dot: a field follows, or a bracket if it is the leading dot (jq 1.6 has no .a.[0]) */
+    bool dotted = true;
+    for (;;) {
+        PathStep step;
+        if (dotted && p < s.size() && is_ident_start(s[p])) {
+            size_t end = p;
+            while (end < s.size() && is_ident_char(s[end])) {
+                end++;
+            }
+            step.is_index = false;
+            step.key.assign(s, p, end - p);
+            p = end;
+        } else if (dotted && p < s.size() && s[p] == '"') {
+            step.is_index = false;
+            if (!parse_plain_string(s, &p, &step.key)) {
+                return false;
+            }
+        } else if (p < s.size() && s[p] == '[' && (!dotted || steps->empty())) {
+            if (!parse_bracket_step(s, &p, &step)) {
+                return false;
+            }
+        } else if (!dotted && p < s.size() && s[p] == '.') {
+            p++;
+            dotted = true;
+            continue;
+        } else if (dotted && !steps->empty()) {
+            return false;
+        } else {
+            break;
+        }
+        steps->push_back(step);
+        dotted = false;
+    }
+    *pos = p;
+    return true;
+}
+
+/* the literal ending the alternatives */
+static bool parse_fallback(const std::string& s, size_t* pos, SimplePath* path) {
+    static const struct {
+        const char* word;
+        jv_kind kind;
+    } words[] = {{"true", JV_KIND_TRUE}, {"false", JV_KIND_FALSE}, {"null", JV_KIND_NULL}};
+    if (*pos < s.size() && s[*pos] == '"') {
+        path->fallback_kind = JV_KIND_STRING;
+        return parse_plain_string(s, pos, &path->fallback_string);
+    }
+    if (*pos < s.size() && s[*pos] >= '0' && s[*pos] <= '9') {
+        path->fallback_kind = JV_KIND_NUMBER;
+        return parse_plain_integer(s, pos, 15, &path->fallback_number);
+    }
+    for (const auto& word : words) {
+        size_t len = strlen(word.word);
+        if (s.compare(*pos, len, word.word) == 0 && (*pos + len == s.size() || !is_ident_char(s[*pos + len]))) {
+            path->fallback_kind = word.kind;
+            *pos += len;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* the simple path of filter, null if it needs the VM */
+SimplePath* parse_simple_path(const std::string& filter) {
+    size_t pos = 0;
+    if (filter.compare(0, strlen(NO_ENV_PREFIX), NO_ENV_PREFIX) == 0) {
+        pos = strlen(NO_ENV_PREFIX);
+    }
+    SimplePath* path = new SimplePath();
+    path->fallback_kind = JV_KIND_INVALID;
+    for (;;) {
+        skip_spaces(filter, &pos);
+        if (pos < filter.size() && filter[pos] == '.') {
+            path->paths.emplace_back();
+            if (!parse_path(filter, &pos, &path->paths.back())) {
+                break;
+            }
+        } else if (path->paths.empty() || !parse_fallback(filter, &pos, path)) {
+            break;
+        }
+        skip_spaces(filter, &pos);
+        if (pos == filter.size()) {
+            return path;
+        }
+        if (path->fallback_kind != JV_KIND_INVALID || filter.compare(pos, 2, "//") != 0) {
+            break;
+        }
+        pos += 2;
+    }
+    delete path;
+    return nullptr;
+}
+
+/* apply steps to value (consumed) like the VM would, stopping at the first error */
+jv simple_path_get(const std::vector<PathStep>& steps, size_t from, jv value) {
+    for (size_t i = from; i < steps.size() && jv_is_valid(value); i++) {
+        const PathStep& step = steps[i];
+        value = jv_get(value, step.is_index ? jv_number(step.index) : jv_string_sized(step.key.data(), step.key.size()));
+    }
+    return value;
+}
+
+jv simple_path_fallback(const SimplePath& path) {
+    switch (path.fallback_kind) {
+        case JV_KIND_STRING:
+            return jv_string_sized(path.fallback_string.data(), path.fallback_string.size());
+        case JV_KIND_NUMBER:
+            return jv_number(path.fallback_number);
+        case JV_KIND_TRUE:
+            return jv_true();
+        case JV_KIND_FALSE:
+            return jv_false();
+        default:
+            return jv_null();
+    }
+}
+
+/* whether a // b goes on to b when a raises an error, which differs between jq versions. asked from
+   jq itself the first time a simple path needs it */
+static bool alternative_catches_errors() {
+    static const bool catches = [] {
+        struct err_data err;
+        jq_state* jq = compile_jq_state(".a // 0", &err);
+        if (jq == nullptr) {
+            return false;
+        }
+        jq_start(jq, jv_array(), 0);
+        jv result = jq_next(jq, global_timeout_sec);
+        bool valid = jv_is_valid(result);
+        jv_free(result);
+        jq_teardown(&jq);
+        return valid;
+    }();
+    return catches;
+}
+
+/* a // b: a if it is neither null nor false, the error of a if the alternative doesn't catch it */
+bool simple_path_defined(jv value) {
+    jv_kind kind = jv_get_kind(value);
+    if (kind == JV_KIND_INVALID) {
+        return !alternative_catches_errors();
+    }
+    return kind != JV_KIND_NULL && kind != JV_KIND_FALSE;
+}
+
+/* what jq_next would return for the first output of path on input (consumed): the value, or an
+   invalid with the error message */
+jv simple_path_eval(const SimplePath& path, jv input) {
+    for (size_t i = 0; i < path.paths.size(); i++) {
+        jv value = simple_path_get(path.paths[i], 0, jv_copy(input));
+        bool last = i + 1 == path.paths.size() && path.fallback_kind == JV_KIND_INVALID;
+        if (last || simple_path_defined(value)) {
+            jv_free(input);
+            return value;
+        }
+        jv_free(value);
+    }
+    jv_free(input);
+    return simple_path_fallback(path);
+}
+
+/* setInputProjection(false) converts whole inputs again */
+std::atomic<bool> projection_enabled(true);
+
+enum ProjectionTokenKind { TOK_END, TOK_BAD, TOK_FIELD, TOK_DOT, TOK_DOTDOT, TOK_STRING, TOK_NUMBER, TOK_IDENT, TOK_VAR, TOK_FORMAT, TOK_OP };
+
+struct ProjectionToken {
+    ProjectionTokenKind kind;
+    /* name of a field, identifier or variable, text of an operator, contents of a plain string */
+    std::string text;
+    /* a string without escapes */
+    bool plain;
+    /* a string with \(...) parts */
+    bool interpolated;
+};
+
+/* skip the jq string literal at pos, interpolated parts included */
+static bool skip_jq_string(const std::string& s, size_t* pos, ProjectionToken* tok, int depth) {
+    size_t p = *pos + 1;
+    while (p < s.size() && s[p] != '"') {
+        if ((unsigned char)s[p] < 0x20) {
+            tok->plain = false;
+        }
+        if (s[p] != '\\') {
+            p++;
+            continue;
+        }
+        tok->plain = false;
+        if (p + 1 < s.size() && s[p + 1] == '(') {
+            tok->interpolated = true;
+            p += 2;
+            int parens = 1;
+            while (p < s.size() && parens > 0) {
+                if (s[p] == '"') {
+                    ProjectionToken inner;
+                    if (depth >= 16 || !skip_jq_string(s, &p, &inner, depth + 1)) {
+                        return false;
+                    }
+                    continue;
+                }
+                /* a comment could hide a paren */
+                if (s[p] == '#') {
+                    return false;
+                }
+                parens += s[p] == '(' ? 1 : (s[p] == ')' ? -1 : 0);
+                p++;
+            }
+            if (parens > 0) {
+                return false;
+            }
+            continue;
+        }
+        p += 2;
+    }
+    if (p >= s.size()) {
+        return false;
+    }
+    if (tok->plain) {
+        tok->text.assign(s, *pos + 1, p - *pos - 1);
+    }
+    *pos = p + 1;
+    return true;
+}
+
+static bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+/* skip spaces and comments */
+static void skip_blanks(const std::string& s, size_t* pos) {
+    for (;;) {
+        skip_spaces(s, pos);
+        if (*pos >= s.size() || s[*pos] != '#') {
+            return;
+        }
+        while (*pos < s.size() && s[*pos] != '\n') {
+            (*pos)++;
+        }
+    }
+}
+
+/* next token of a jq program, skipping spaces and comments */
+static ProjectionToken projection_token(const std::string& s, size_t* pos) {
+    static const char* const ops[] = {"?//", "//=", "|=", "+=", "-=", "*=", "/=", "%=", "==", "!=", "<=", ">=", "//"};
+    ProjectionToken tok;
+    tok.kind = TOK_BAD;
+    tok.plain = true;
+    tok.interpolated = false;
+    skip_blanks(s, pos);
+    size_t p = *pos;
+    if (p >= s.size()) {
+        tok.kind = TOK_END;
+        return tok;
+    }
+    char c = s[p];
+    char next = p + 1 < s.size() ? s[p + 1] : '\0';
+    if (is_digit(c) || (c == '.' && is_digit(next))) {
+        while (p < s.size() && (is_digit(s[p]) || s[p] == '.')) {
+            p++;
+        }
+        if (p < s.size() && (s[p] == 'e' || s[p] == 'E')) {
+            p++;
+            if (p < s.size() && (s[p] == '+' || s[p] == '-')) {
+                p++;
+            }
+            while (p < s.size() && is_digit(s[p])) {
+                p++;
+            }
+        }
+        tok.kind = TOK_NUMBER;
+    } else if (c == '.' && next == '.') {
+        tok.kind = TOK_DOTDOT;
+        p += 2;
+    } else if (c == '.' || c == '$' || c == '@' || is_ident_start(c)) {
+        size_t start = is_ident_start(c) ? p : p + 1;
+        if (start != p && !is_ident_start(next)) {
+            if (c != '.') {
+                return tok;
+            }
+            tok.kind = TOK_DOT;
+            *pos = p + 1;
+            return tok;
+        }
+        p = start;
+        /* module names are ident::ident */
+        while (p < s.size() && (is_ident_char(s[p]) || (c != '.' && s.compare(p, 2, "::") == 0 && ++p))) {
+            p++;
+        }
+        tok.text.assign(s, start, p - start);
+        tok.kind = c == '.' ? TOK_FIELD : c == '$' ? TOK_VAR : c == '@' ? TOK_FORMAT : TOK_IDENT;
+    } else if (c == '"') {
+        if (!skip_jq_string(s, &p, &tok, 0)) {
+            return tok;
+        }
+        tok.kind = TOK_STRING;
+    } else {
+        tok.kind = TOK_OP;
+        for (const char* op : ops) {
+            if (s.compare(p, strlen(op), op) == 0) {
+                tok.text = op;
+                break;
+            }
+        }
+        if (tok.text.empty()) {
+            if (strchr("|,+-*/%=<>()[]{}:;?", c) == nullptr) {
+                tok.kind = TOK_BAD;
+                return tok;
+            }
+            tok.text.assign(1, c);
+        }
+        p += tok.text.size();
+    }
+    *pos = p;
+    return tok;
+}
+
+/* mark path as read whole */
+static void projection_add(ProjectionNode* node, const std::vector<std::string>& path) {
+    for (const std::string& key : path) {
+        if (node->whole) {
+            return;
+        }
+        ProjectionNode* child = nullptr;
+        for (ProjectionNode& field : node->fields) {
+            if (field.key == key) {
+                child = &field;
+                break;
+            }
+        }
+        if (child == nullptr) {
+            node->fields.push_back(ProjectionNode{key, false, {}});
+            child = &node->fields.back();
+        }
+        node = child;
+    }
+    node->whole = true;
+    node->fields.clear();
+}
+
+/* add what from reads to into */
+void projection_merge(ProjectionNode* into, const ProjectionNode& from) {
+    if (into->whole) {
+        return;
+    }
+    if (from.whole) {
+        into->whole = true;
+        into->fields.clear();
+        return;
+    }
+    for (const ProjectionNode& field : from.fields) {
+        ProjectionNode* child = nullptr;
+        for (ProjectionNode& existing : into->fields) {
+            if (existing.key == field.key) {
+                child = &existing;
+                break;
+            }
+        }
+        if (child == nullptr) {
+            into->fields.push_back(field);
+        } else {
+            projection_merge(child, field);
+        }
+    }
+}
+
+enum ProjectionFrameKind { FRAME_PAREN, FRAME_KEY_PAREN, FRAME_BRACKET, FRAME_BRACE, FRAME_IF };
+
+/* an open (, [, { or if, derived is the context it was opened in */
+struct ProjectionFrame {
+    ProjectionFrameKind kind;
+    bool derived;
+};
+
+/* what filter reads of its input, null if it may read all of it */
+ProjectionNode* analyze_projection(const std::string& filter) {
+    enum { EXPECT_TERM, AFTER_TERM, EXPECT_KEY, AFTER_KEY } state = EXPECT_TERM;
+    size_t pos = 0;
+    if (filter.compare(0, strlen(NO_ENV_PREFIX), NO_ENV_PREFIX) == 0) {
+        pos = strlen(NO_ENV_PREFIX);
+    }
+    ProjectionNode root{"", false, {}};
+    std::vector<ProjectionFrame> frames;
+    /* past a pipe, `.` isn't the input anymore */
+    bool derived = false;
+    /* the path of the input being read, while the term goes on with fields */
+    bool active = false;
+    std::vector<std::string> path;
+    auto finish = [&]() {
+        if (active) {
+            projection_add(&root, path);
+            active = false;
+        }
+    };
+    auto top_is = [&](ProjectionFrameKind kind) {
+        return !frames.empty() && frames.back().kind == kind;
+    };
+    auto pop = [&]() {
+        derived = frames.back().derived;
+        frames.pop_back();
+    };
+
+    for (;;) {
+        if (root.whole) {
+            return nullptr;
+        }
+        ProjectionToken tok = projection_token(filter, &pos);
+        if (tok.kind == TOK_BAD || (tok.interpolated && !derived)) {
+            return nullptr;
+        }
+        bool is_op = tok.kind == TOK_OP;
+        if (state == EXPECT_TERM) {
+            state = AFTER_TERM;
+            if (tok.kind == TOK_FIELD) {
+                active = !derived;
+                path.assign(1, tok.text);
+            } else if (tok.kind == TOK_DOT) {
+                size_t save = pos;
+                ProjectionToken next = projection_token(filter, &pos);
+                if (next.kind == TOK_STRING) {
+                    if (!derived && !next.plain) {
+                        return nullptr;
+                    }
+                    active = !derived;
+                    path.assign(1, next.text);
+                } else if (next.kind == TOK_OP && next.text == "[") {
+                    pos = save;
+                    active = !derived;
+                    path.clear();
+                } else if (!derived) {
+                    /* the identity */
+                    return nullptr;
+                } else {
+                    pos = save;
+                }
+            } else if (tok.kind == TOK_NUMBER || tok.kind == TOK_STRING || tok.kind == TOK_VAR) {
+            } else if (tok.kind == TOK_DOTDOT || tok.kind == TOK_FORMAT) {
+                if (!derived) {
+                    return nullptr;
+                }
+                /* @base64 "...\(.)" */
+                size_t save = pos;
+                if (tok.kind == TOK_FORMAT && projection_token(filter, &pos).kind != TOK_STRING) {
+                    pos = save;
+                }
+            } else if (tok.kind == TOK_IDENT) {
+                const std::string& word = tok.text;
+                if (word == "if") {
+                    frames.push_back({FRAME_IF, derived});
+                    state = EXPECT_TERM;
+                } else if (word == "try") {
+                    state = EXPECT_TERM;
+                } else if (word == "true" || word == "false" || word == "null" || word == "empty" || word == "env" || word == "now") {
+                } else if (!derived || word == "import" || word == "include" || word == "then" || word == "elif" ||
+                           word == "else" || word == "end" || word == "as" || word == "and" || word == "or" || word == "catch") {
+                    return nullptr;
+                } else if (word == "reduce" || word == "foreach" || word == "def" || word == "label") {
+                    state = EXPECT_TERM;
+                }
+            } else if (is_op && (tok.text == "(" || tok.text == "[")) {
+                frames.push_back({tok.text == "(" ? FRAME_PAREN : FRAME_BRACKET, derived});
+                state = EXPECT_TERM;
+            } else if (is_op && tok.text == "{") {
+                frames.push_back({FRAME_BRACE, derived});
+                state = EXPECT_KEY;
+            } else if (is_op && tok.text == "-") {
+                state = EXPECT_TERM;
+            } else if (is_op && tok.text == "]" && top_is(FRAME_BRACKET)) {
+                /* [] or the end of .[i:] */
+                pop();
+            } else if (is_op && tok.text == ":" && top_is(FRAME_BRACKET)) {
+                /* .[:i] */
+                state = EXPECT_TERM;
+            } else {
+                return nullptr;
+            }
+        } else if (state == AFTER_TERM) {
+            const std::string& op = tok.text;
+            if (tok.kind == TOK_FIELD) {
+                if (active) {
+                    path.push_back(tok.text);
+                }
+            } else if (tok.kind == TOK_DOT) {
+                size_t save = pos;
+                ProjectionToken next = projection_token(filter, &pos);
+                if (next.kind == TOK_STRING) {
+                    if (active && !next.plain) {
+                        return nullptr;
+                    }
+                    if (active) {
+                        path.push_back(next.text);
+                    }
+                } else if (next.kind == TOK_OP && next.text == "[") {
+                    pos = save;
+                } else {
+                    return nullptr;
+                }
+            } else if (is_op && op == "[") {
+                size_t save = pos;
+                ProjectionToken next = projection_token(filter, &pos);
+                if (next.kind == TOK_OP && next.text == "]") {
+                    /* .a[] */
+                    finish();
+                    continue;
+                }
+                if (next.kind == TOK_STRING && next.plain) {
+                    ProjectionToken close = projection_token(filter, &pos);
+                    if (close.kind == TOK_OP && close.text == "]") {
+                        if (active) {
+                            path.push_back(next.text);
+                        }
+                        continue;
+                    }
+                }
+                /* an index or slice, evaluated on the same input as the term */
+                pos = save;
+                finish();
+                frames.push_back({FRAME_BRACKET, derived});
+                state = EXPECT_TERM;
+            } else if (is_op && op == "?") {
+            } else if (is_op && op == "|") {
+                finish();
+                derived = true;
+                state = EXPECT_TERM;
+            } else if (is_op && op == ",") {
+                finish();
+                if (top_is(FRAME_BRACE)) {
+                    derived = frames.back().derived;
+                    state = EXPECT_KEY;
+                } else {
+                    state = EXPECT_TERM;
+                }
+            } else if ((is_op && (op == "+" || op == "-" || op == "*" || op == "/" || op == "%" || op == "==" || op == "!=" ||
+                                  op == "<" || op == "<=" || op == ">" || op == ">=" || op == "//")) ||
+                       (tok.kind == TOK_IDENT && (op == "and" || op == "or" || op == "catch"))) {
+                finish();
+                state = EXPECT_TERM;
+            } else if (is_op && (op == ":" && top_is(FRAME_BRACKET))) {
+                finish();
+                state = EXPECT_TERM;
+            } else if (is_op && (op == "(" || op == ";" || op == ":" || op == "?//" || op.find('=') != std::string::npos)) {
+                /* calls, definitions, patterns and assignments, only past a pipe */
+                if (!derived) {
+                    return nullptr;
+                }
+                if (op == "(") {
+                    frames.push_back({FRAME_PAREN, derived});
+                }
+                state = EXPECT_TERM;
+            } else if (is_op && op == ")" && (top_is(FRAME_PAREN) || top_is(FRAME_KEY_PAREN))) {
+                finish();
+                state = frames.back().kind == FRAME_KEY_PAREN ? AFTER_KEY : AFTER_TERM;
+                pop();
+            } else if (is_op && ((op == "]" && top_is(FRAME_BRACKET)) || (op == "}" && top_is(FRAME_BRACE)))) {
+                finish();
+                pop();
+            } else if (tok.kind == TOK_IDENT && (op == "then" || op == "elif" || op == "else") && top_is(FRAME_IF)) {
+                finish();
+                derived = frames.back().derived;
+                state = EXPECT_TERM;
+            } else if (tok.kind == TOK_IDENT && op == "end" && top_is(FRAME_IF)) {
+                finish();
+                pop();
+            } else if (tok.kind == TOK_IDENT && op == "as") {
+                finish();
+                state = EXPECT_TERM;
+                if (!derived) {
+                    /* E as $x | body: the body still runs on the input */
+                    ProjectionToken var = projection_token(filter, &pos);
+                    ProjectionToken pipe = projection_token(filter, &pos);
+                    if (var.kind != TOK_VAR || pipe.kind != TOK_OP || pipe.text != "|") {
+                        return nullptr;
+                    }
+                }
+            } else if (tok.kind == TOK_END) {
+                finish();
+                if (!frames.empty() || root.whole) {
+                    return nullptr;
+                }
+                return new ProjectionNode(root);
+            } else {
+                return nullptr;
+            }
+        } else if (state == EXPECT_KEY) {
+            if (tok.kind == TOK_IDENT || tok.kind == TOK_VAR || tok.kind == TOK_STRING) {
+                size_t save = pos;
+                ProjectionToken next = projection_token(filter, &pos);
+                if (next.kind == TOK_OP && next.text == ":") {
+                    state = EXPECT_TERM;
+                    continue;
+                }
+                pos = save;
+                /* {a} is {a: .a} */
+                if (!derived && tok.kind != TOK_VAR) {
+                    if (!tok.plain) {
+                        return nullptr;
+                    }
+                    projection_add(&root, std::vector<std::string>(1, tok.text));
+                }
+                state = AFTER_KEY;
+            } else if (is_op && tok.text == "(") {
+                frames.push_back({FRAME_KEY_PAREN, derived});
+                state = EXPECT_TERM;
+            } else if (is_op && tok.text == "}") {
+                pop();
+                state = AFTER_TERM;
+            } else {
+                return nullptr;
+            }
+        } else {
+            if (is_op && tok.text == ":") {
+                state = EXPECT_TERM;
+            } else if (is_op && tok.text == ",") {
+                state = EXPECT_KEY;
+            } else if (is_op && tok.text == "}") {
+                pop();
+                state = AFTER_TERM;
+            } else {
+                return nullptr;
+            }
+        }
+    }
+}
+
+/* jq compiles and links its whole builtin library into every program, so a cache miss costs
+   milliseconds whatever the filter. filters that differ only in literal values (as generated ones
+   do) share one compiled program instead: the literals are moved into variables bound from the input,
+   `.a == "x"` becoming `. as [$__jq0, $__jqin] | $__jqin | .a == $__jq0` run on ["x", input].
+   setLiteralHoisting(false) compiles every filter as it is written */
+std::atomic<bool> literal_hoisting_enabled(true);
+
+/* the input of a shape: [literals..., input], the input itself for a filter without literals */
+jv bind_literals(const std::vector<ShapeLiteral>& literals, jv input) {
+    if (literals.empty()) {
+        return input;
+    }
+    /* built for every run, a shared jv would be copied across threads */
+    jv bound = jv_array_sized(literals.size() + 1);
+    for (const ShapeLiteral& literal : literals) {
+        bound = jv_array_append(bound, literal.is_string ? jv_string_sized(literal.text.c_str(), literal.text.size()) : jv_number(literal.number));
+    }
+    return jv_array_append(bound, input);
+}
+
+/* an integer literal printed the same as the double it parses to */
+static bool is_exact_integer(const std::string& text) {
+    if (text.empty() || text.size() > 15 || (text[0] == '0' && text.size() > 1)) {
+        return false;
+    }
+    for (char c : text) {
+        if (!is_digit(c)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* whether a literal after prev stands for a value, open is the innermost bracket ('\0' for none).
+   keys (`{"a": 1}`, `{a, "b"}`), `."a"` and `@base64 "..."` need the literal itself */
+static bool literal_after(const ProjectionToken& prev, bool first, char open) {
+    if (first) {
+        return true;
+    }
+    if (prev.kind == TOK_IDENT) {
+        return prev.text == "if" || prev.text == "then" || prev.text == "elif" || prev.text == "else" ||
+               prev.text == "and" || prev.text == "or";
+    }
+    if (prev.kind != TOK_OP) {
+        return false;
+    }
+    if (prev.text == "," && open == '{') {
+        return false;
+    }
+    return strchr("{)]}?", prev.text[0]) == nullptr;
+}
+
+/* whether a literal followed by next stands alone, not `"a"[0]`, `"a"?` or a key before `:` */
+static bool literal_before(const ProjectionToken& next) {
+    if (next.kind == TOK_END) {
+        return true;
+    }
+    if (next.kind == TOK_IDENT) {
+        return next.text == "then" || next.text == "elif" || next.text == "else" || next.text == "end" ||
+               next.text == "and" || next.text == "or" || next.text == "as";
+    }
+    return next.kind == TOK_OP && strchr("([{:?", next.text[0]) == nullptr;
+}
+
+/* the shape of filter with its plain string and integer literals in value positions hoisted into
+   variables, false if there are none or the filter is left as it is: modules, destructuring (where a
+   variable would be a valid pattern and a literal isn't) and anything the scan doesn't understand */
+bool filter_shape(const std::string& filter, std::string* shape, std::vector<ShapeLiteral>* literals) {
+    if (filter.find("__jq") != std::string::npos) {
+        return false;
+    }
+    std::string body;
+    std::vector<char> open;
+    ProjectionToken prev;
+    prev.kind = TOK_END;
+    bool first = true;
+    /* a literal hoisted if the token after it allows */
+    bool pending = false;
+    ShapeLiteral literal;
+    size_t literal_start = 0, literal_end = 0, copied = 0, pos = 0;
+    for (;;) {
+        skip_blanks(filter, &pos);
+        size_t start = pos;
+        ProjectionToken tok = projection_token(filter, &pos);
+        if (tok.kind == TOK_BAD || (tok.kind == TOK_OP && tok.text == "?//")) {
+            return false;
+        }
+        if (tok.kind == TOK_IDENT && (tok.text == "import" || tok.text == "include" || tok.text == "module")) {
+            return false;
+        }
+        if (tok.kind == TOK_OP && (tok.text == "[" || tok.text == "{") && prev.kind == TOK_IDENT && prev.text == "as") {
+            return false;
+        }
+        if (pending && literal_before(tok)) {
+            body.append(filter, copied, literal_start - copied);
+            body += "$__jq" + std::to_string(literals->size());
+            copied = literal_end;
+            literals->push_back(literal);
+        }
+        pending = false;
+        if (tok.kind == TOK_END) {
+            break;
+        }
+        char innermost = open.empty() ? '\0' : open.back();
+        if (tok.kind == TOK_OP && strchr("([{", tok.text[0]) != nullptr) {
+            open.push_back(tok.text[0]);
+        } else if (tok.kind == TOK_OP && strchr(")]}", tok.text[0]) != nullptr) {
+            if (open.empty()) {
+                return false;
+            }
+            open.pop_back();
+        } else if (((tok.kind == TOK_STRING && tok.plain) ||
+                    (tok.kind == TOK_NUMBER && is_exact_integer(filter.substr(start, pos - start)))) &&
+                   literal_after(prev, first, innermost)) {
+            pending = true;
+            literal.is_string = tok.kind == TOK_STRING;
+            literal.text = literal.is_string ? tok.text : "";
+            literal.number = literal.is_string ? 0 : strtod(filter.c_str() + start, nullptr);
+            literal_start = start;
+            literal_end = pos;
+        }
+        prev = tok;
+        first = false;
+    }
+    if (literals->empty()) {
+        return false;
+    }
+    body.append(filter, copied, std::string::npos);
+    *shape = ". as [";
+    for (size_t i = 0; i < literals->size(); i++) {
+        *shape += "$__jq" + std::to_string(i) + ", ";
+    }
+    *shape += "$__jqin] | $__jqin | " + body;
+    return true;
+}
+
+/* builtins whose outputs don't only depend on the input. env and $ENV only count when the filter
+   doesn't start with the prefix hiding them */
+static const char* const nondeterministic_builtins[] = {
+    "now", "input", "inputs", "input_line_number", "input_filename", "debug", "stderr", "halt", "halt_error",
+    "localtime", "strflocaltime", "get_search_list", "get_prog_origin", "get_jq_origin", "$__loc__",
+};
+
+/* whether name appears as a word in text */
+static bool contains_word(const std::string& text, const std::string& name) {
+    for (size_t at = text.find(name); at != std::string::npos; at = text.find(name, at + 1)) {
+        bool starts = at == 0 || (!is_ident_char(text[at - 1]) && (name[0] == '$' || text[at - 1] != '$'));
+        bool ends = at + name.size() >= text.size() || !is_ident_char(text[at + name.size()]);
+        if (starts && ends) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* whether filter always gives the same outputs for the same input, so its results may be memoized.
+   false for the builtins above, modules and anything the scan doesn't understand. names are matched
+   wherever they appear, a field or object key of the same name is enough to opt out */
+bool filter_is_deterministic(const std::string& filter) {
+    size_t pos = 0;
+    bool env_hidden = filter.compare(0, strlen(NO_ENV_PREFIX), NO_ENV_PREFIX) == 0;
+    if (env_hidden) {
+        pos = strlen(NO_ENV_PREFIX);
+    }
+    std::vector<std::string> names(std::begin(nondeterministic_builtins), std::end(nondeterministic_builtins));
+    names.push_back("import");
+    names.push_back("include");
+    if (!env_hidden) {
+        names.push_back("env");
+        names.push_back("$ENV");
+    }
+    for (;;) {
+        skip_blanks(filter, &pos);
+        size_t start = pos;
+        ProjectionToken tok = projection_token(filter, &pos);
+        if (tok.kind == TOK_END) {
+            return true;
+        }
+        if (tok.kind == TOK_BAD) {
+            return false;
+        }
+        std::string word;
+        if (tok.kind == TOK_IDENT) {
+            word = tok.text;
+        } else if (tok.kind == TOK_VAR) {
+            word = "$" + tok.text;
+        } else if (tok.kind == TOK_STRING && tok.interpolated) {
+            /* the code inside \(...) isn't tokenized */
+            std::string text = filter.substr(start, pos - start);
+            for (const std::string& name : names) {
+                if (contains_word(text, name)) {
+                    return false;
+                }
+            }
+            continue;
+        }
+        for (const std::string& name : names) {
+            if (word == name) {
+                return false;
+            }
+        }
+    }
+}
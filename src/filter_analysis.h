@@ -0,0 +1,66 @@
+#ifndef SRC_FILTER_ANALYSIS_H_
+#define SRC_FILTER_ANALYSIS_H_
+
+#include "src/binding.h"
+
+/* what the text of a filter tells before it runs: simple paths run without the VM, the input fields
+   it reads, its shape with literals hoisted out and whether it is deterministic */
+
+/* filters simple enough to run without the jq VM: a path of fields and integer indices (`.`, `.a.b`,
+   `."a b"`, `.["a"]`, `.a[0]`, `.[-1]`), optionally followed by `// path` alternatives, the last of
+   which may be a literal (a string without escapes, an integer, true, false or null). every step is
+   applied with jv_get, the function the VM's INDEX opcode calls, so results and errors are jq's own.
+   anything else, including whitespace inside a path, is left to the VM */
+struct PathStep {
+    bool is_index;
+    std::string key;
+    int index;
+};
+
+struct SimplePath {
+    /* alternatives of a // b // ..., each a list of steps */
+    std::vector<std::vector<PathStep>> paths;
+    /* the literal ending the alternatives, JV_KIND_INVALID for none */
+    jv_kind fallback_kind;
+    std::string fallback_string;
+    double fallback_number;
+};
+
+extern std::atomic<bool> fast_path_enabled;
+SimplePath* parse_simple_path(const std::string& filter);
+jv simple_path_get(const std::vector<PathStep>& steps, size_t from, jv value);
+jv simple_path_fallback(const SimplePath& path);
+bool simple_path_defined(jv value);
+jv simple_path_eval(const SimplePath& path, jv input);
+
+/* input projection: the fields of the input a filter can read, found by scanning its text, so that
+   a js object input only has to be converted along them (see project_input). the input is reached
+   through paths like .a.b, ."a" or .["a"] in input context; past a pipe `.` is whatever the left
+   side output, which is made of values it read whole (or built), so the right side is only
+   scanned for its nesting. .a[0], .a[] and .a[.i] read .a whole. in input context, anything that
+   could see more of the input (`.`, `..`, function calls, reduce, def, assignments, string
+   interpolation, formats) means the whole input, as does anything the scanner doesn't follow */
+struct ProjectionNode {
+    std::string key;
+    /* the value here is read whole, fields is empty then */
+    bool whole;
+    std::vector<ProjectionNode> fields;
+};
+
+extern std::atomic<bool> projection_enabled;
+void projection_merge(ProjectionNode* into, const ProjectionNode& from);
+ProjectionNode* analyze_projection(const std::string& filter);
+extern std::atomic<bool> literal_hoisting_enabled;
+
+/* a literal moved out of a filter, $__jq<i> of its shape */
+struct ShapeLiteral {
+    bool is_string;
+    std::string text;
+    double number;
+};
+
+jv bind_literals(const std::vector<ShapeLiteral>& literals, jv input);
+bool filter_shape(const std::string& filter, std::string* shape, std::vector<ShapeLiteral>* literals);
+bool filter_is_deterministic(const std::string& filter);
+
+#endif
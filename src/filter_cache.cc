@@ -0,0 +1,128 @@
+#include "src/binding.h"
+#include "src/filter_cache.h"
+
+/* set on the js thread, read by every worker */
+std::atomic<size_t> global_pool_size(0);
+
+/* max compiled jq_state instances a single filter may hold, defaults to the number of worker threads */
+size_t get_pool_size() {
+    size_t pool_size = global_pool_size.load(std::memory_order_relaxed);
+    if (pool_size > 0) {
+        return pool_size;
+    }
+    return get_worker_thread_count();
+}
+
+/* init jq and compile filter, returns nullptr and fills err on failure */
+jq_state* compile_jq_state(const std::string& filter, struct err_data* err) {
+    snprintf(err->buf, sizeof(err->buf), "jq: compile error");
+    jq_state* jq = jq_init();
+    if (jq == nullptr) {
+        snprintf(err->buf, sizeof(err->buf), "Failed to initialize jq");
+        return nullptr;
+    }
+    jq_set_error_cb(jq, throw_err_cb, err);
+    if (!jq_compile(jq, filter.c_str())) {
+        jq_teardown(&jq);
+        return nullptr;
+    }
+    /* err lives on the caller stack, don't let the state keep pointing at it */
+    jq_set_error_cb(jq, throw_err_cb, &runtime_err);
+    return jq;
+}
+
+/* live state pools by program. entries of freed pools are swept once the map doubles */
+static std::unordered_map<std::string, std::weak_ptr<StatePool>> state_pools;
+static size_t state_pools_sweep_at = 64;
+static pthread_mutex_t state_pools_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* the pool of program, created empty if no cached filter uses it */
+static std::shared_ptr<StatePool> get_state_pool(const std::string& program) {
+    pthread_mutex_lock(&state_pools_mutex);
+    std::weak_ptr<StatePool>& entry = state_pools[program];
+    std::shared_ptr<StatePool> pool = entry.lock();
+    if (pool == nullptr) {
+        pool = std::make_shared<StatePool>(program);
+        entry = pool;
+        if (state_pools.size() >= state_pools_sweep_at) {
+            for (auto it = state_pools.begin(); it != state_pools.end();) {
+                it = it->second.expired() ? state_pools.erase(it) : std::next(it);
+            }
+            state_pools_sweep_at = state_pools.size() * 2 + 64;
+        }
+    }
+    pthread_mutex_unlock(&state_pools_mutex);
+    return pool;
+}
+
+std::atomic<uint64_t> next_wrapper_id(1);
+
+FilterCache cache(global_cache_size);
+
+/* approximate memory held by one compiled jq_state: a few KB plus bytecode growing with the filter
+   text (fitted to malloc usage measured around jq_init + jq_compile) */
+#define JQ_STATE_BASE_BYTES 4096
+#define JQ_STATE_BYTES_PER_CHAR 6
+/* a simple path holds its parsed steps and no state */
+#define SIMPLE_PATH_BASE_BYTES 256
+
+/* wrapper for filter: without a jq state for a simple path, with a first compiled state otherwise
+   unless the pool of its program has states already. null with err filled if the filter doesn't compile */
+JqFilterWrapper* new_filter_wrapper(const std::string& filter, struct err_data* err) {
+    JqFilterWrapper* wrapper;
+    SimplePath* simple_path = parse_simple_path(filter);
+    if (simple_path != nullptr) {
+        wrapper = new JqFilterWrapper(get_state_pool(filter), filter, simple_path);
+        wrapper->footprint = SIMPLE_PATH_BASE_BYTES + filter.size();
+    } else {
+        std::string shape;
+        std::vector<ShapeLiteral> literals;
+        bool hoisted = literal_hoisting_enabled.load(std::memory_order_relaxed) && filter_shape(filter, &shape, &literals);
+        std::shared_ptr<StatePool> pool = get_state_pool(hoisted ? shape : filter);
+        size_t states, idle;
+        pool->pool_stats(&states, &idle);
+        /* charged for the most states its pool can grow to, or only for its text if it shares the
+           states of a filter compiled before */
+        size_t footprint = SIMPLE_PATH_BASE_BYTES + filter.size();
+        if (states == 0) {
+            jq_state* jq = compile_jq_state(pool->program, err);
+            if (jq == nullptr && hoisted) {
+                /* the filter's own compile error, or the filter as written if only its shape fails */
+                literals.clear();
+                pool = get_state_pool(filter);
+                jq = compile_jq_state(filter, err);
+            }
+            if (jq == nullptr) {
+                return nullptr;
+            }
+            if (!pool->adopt(jq)) {
+                jq_teardown(&jq);
+            }
+            footprint = (JQ_STATE_BASE_BYTES + JQ_STATE_BYTES_PER_CHAR * pool->program.size()) * get_pool_size();
+        }
+        wrapper = new JqFilterWrapper(pool, filter);
+        wrapper->literals = std::move(literals);
+        wrapper->footprint = footprint;
+    }
+    /* the filter is known to be valid by now, the scans don't check it */
+    wrapper->projection = analyze_projection(filter);
+    wrapper->deterministic = filter_is_deterministic(filter);
+    return wrapper;
+}
+
+/* cached wrapper for filter, compiling it on a miss. the caller owns a cache reference to release with dec_refcnt */
+JqFilterWrapper* get_cached_wrapper(const std::string& filter, struct err_data* err) {
+    size_t hash = FilterCache::hash(filter);
+    JqFilterWrapper* wrapper = cache.get(filter, hash);
+    if (wrapper == nullptr) {
+        DEBUG_LOG("Creating new wrapper for filter='%s'", filter.c_str());
+        auto start = std::chrono::steady_clock::now();
+        wrapper = new_filter_wrapper(filter, err);
+        if (wrapper == nullptr) {
+            return nullptr;
+        }
+        wrapper->compile_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        cache.put(hash, wrapper);
+    }
+    return wrapper;
+}
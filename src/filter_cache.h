@@ -0,0 +1,567 @@
+#ifndef SRC_FILTER_CACHE_H_
+#define SRC_FILTER_CACHE_H_
+
+#include "src/binding.h"
+#include "src/stats.h"
+#include "src/filter_analysis.h"
+
+/* compiled filters: the pools of jq states per program and the sharded cache of filters */
+
+extern std::atomic<size_t> global_pool_size;
+size_t get_pool_size();
+jq_state* compile_jq_state(const std::string& filter, struct err_data* err);
+
+class FilterCache;
+
+/* compiled states of one jq program, shared by the cached filters compiled to it (see filter_shape) */
+class StatePool {
+public:
+    const std::string program;
+
+    explicit StatePool(const std::string& program_) : program(program_), total_states(0) {
+        pthread_mutex_init(&pool_mutex, nullptr);
+        pthread_cond_init(&pool_cond, nullptr);
+    }
+
+    /* free all pooled jq states and destroy mutex */
+    ~StatePool() {
+        for (jq_state* jq : idle_states) {
+            WRAPPER_DEBUG_LOG(this, "Tearing down jq state %p", (void*)jq);
+            jq_teardown(&jq);
+        }
+        pthread_cond_destroy(&pool_cond);
+        pthread_mutex_destroy(&pool_mutex);
+    }
+
+    /* take an idle state out of the pool for good, null if none is idle */
+    jq_state* take() {
+        jq_state* jq = nullptr;
+        pthread_mutex_lock(&pool_mutex);
+        if (!idle_states.empty()) {
+            jq = idle_states.back();
+            idle_states.pop_back();
+            total_states--;
+        }
+        pthread_mutex_unlock(&pool_mutex);
+        return jq;
+    }
+
+    /* add a state compiled from the same program to the pool, false if the pool is full */
+    bool adopt(jq_state* jq) {
+        bool adopted = false;
+        pthread_mutex_lock(&pool_mutex);
+        if (total_states < get_pool_size()) {
+            idle_states.push_back(jq);
+            total_states++;
+            adopted = true;
+            pthread_cond_signal(&pool_cond);
+        }
+        pthread_mutex_unlock(&pool_mutex);
+        return adopted;
+    }
+
+    /* check out a compiled state, growing the pool up to get_pool_size() before blocking */
+    jq_state* acquire(){
+        WRAPPER_DEBUG_LOG(this, "Acquiring jq state");
+        /* time blocked on the lock or waiting for an idle state, the clock is only read when blocking */
+        uint64_t waited_ns = 0;
+        if (pthread_mutex_trylock(&pool_mutex) != 0) {
+            uint64_t start = stats_now();
+            pthread_mutex_lock(&pool_mutex);
+            waited_ns += stats_now() - start;
+        }
+        jq_state* jq = nullptr;
+        bool locked = true;
+        while (idle_states.empty()) {
+            if (total_states < get_pool_size()) {
+                total_states++;
+                pthread_mutex_unlock(&pool_mutex);
+                locked = false;
+                struct err_data err;
+                jq = compile_jq_state(program, &err);
+                if (jq != nullptr) {
+                    WRAPPER_DEBUG_LOG(this, "Grew pool with jq state %p", (void*)jq);
+                    break;
+                }
+                /* compiled once already, so this is a resource failure - wait for a state instead */
+                pthread_mutex_lock(&pool_mutex);
+                locked = true;
+                total_states--;
+                if (idle_states.empty() && total_states == 0) {
+                    pthread_mutex_unlock(&pool_mutex);
+                    locked = false;
+                    break;
+                }
+                continue;
+            }
+            WRAPPER_DEBUG_LOG(this, "Pool exhausted (%zu states), waiting", total_states);
+            uint64_t start = stats_now();
+            pthread_cond_wait(&pool_cond, &pool_mutex);
+            waited_ns += stats_now() - start;
+        }
+        if (locked) {
+            jq = idle_states.back();
+            idle_states.pop_back();
+            pthread_mutex_unlock(&pool_mutex);
+            WRAPPER_DEBUG_LOG(this, "Acquired jq state %p", (void*)jq);
+        }
+        if (waited_ns > 0) {
+            stats_record_state_wait(waited_ns);
+        }
+        return jq;
+    }
+
+    /* return a state to the pool, dropping it if the pool was shrunk meanwhile */
+    void release(jq_state* jq){
+        WRAPPER_DEBUG_LOG(this, "Releasing jq state %p", (void*)jq);
+        pthread_mutex_lock(&pool_mutex);
+        if (total_states > get_pool_size()) {
+            total_states--;
+            pthread_mutex_unlock(&pool_mutex);
+            jq_teardown(&jq);
+            return;
+        }
+        idle_states.push_back(jq);
+        pthread_cond_signal(&pool_cond);
+        pthread_mutex_unlock(&pool_mutex);
+    }
+
+    void pool_stats(size_t* states, size_t* idle){
+        pthread_mutex_lock(&pool_mutex);
+        *states = total_states;
+        *idle = idle_states.size();
+        pthread_mutex_unlock(&pool_mutex);
+    }
+private:
+    std::vector<jq_state*> idle_states;
+    size_t total_states;
+    pthread_mutex_t pool_mutex;
+    pthread_cond_t pool_cond;
+};
+
+extern std::atomic<uint64_t> next_wrapper_id;
+
+struct JqFilterWrapper {
+    friend class FilterCache;
+public:
+    std::string filter_name;
+    /* what recompiling the filter would cost and what a cached entry holds, see get_cached_wrapper */
+    double compile_us;
+    size_t footprint;
+    std::multimap<double, JqFilterWrapper*>::iterator cache_pos;
+    /* what the filter reads of its input, null for all of it. set by new_filter_wrapper */
+    ProjectionNode* projection;
+    /* states of the program the filter compiles to, and the literals that program takes with the input */
+    std::shared_ptr<StatePool> pool;
+    std::vector<ShapeLiteral> literals;
+    /* results of the filter are memoized by the result cache under id, if it is deterministic */
+    const uint64_t id;
+    bool deterministic;
+    /* set filter_name and the pool, which a simple path only fills if the fast path is turned off */
+    explicit JqFilterWrapper(std::shared_ptr<StatePool> pool_, std::string filter_name_, SimplePath* simple_path_ = nullptr) :
+        filter_name(filter_name_),
+        compile_us(0),
+        footprint(0),
+        projection(nullptr),
+        pool(pool_),
+        id(next_wrapper_id.fetch_add(1, std::memory_order_relaxed)),
+        deterministic(false),
+        simple_path(simple_path_),
+        cache_refs(0),
+        cache_hits(0) {
+        DEBUG_LOG("[WRAPPER:%p] Creating wrapper for filter: %s", (void*)this, filter_name_.c_str());
+    }
+
+    ~JqFilterWrapper() {
+        WRAPPER_DEBUG_LOG(this, "Destroying wrapper: %s", filter_name.c_str());
+        delete simple_path;
+        delete projection;
+    }
+
+    /* the path to run instead of a jq state, null if the filter needs the VM */
+    const SimplePath* fast_path() const {
+        return simple_path != nullptr && fast_path_enabled.load(std::memory_order_relaxed) ? simple_path : nullptr;
+    }
+
+    jq_state* take() {
+        return pool->take();
+    }
+
+    bool adopt(jq_state* jq) {
+        return pool->adopt(jq);
+    }
+
+    jq_state* acquire() {
+        return pool->acquire();
+    }
+
+    void release(jq_state* jq) {
+        pool->release(jq);
+    }
+
+    void pool_stats(size_t* states, size_t* idle) {
+        pool->pool_stats(states, idle);
+    }
+
+    /* run the filter on input with a state of its pool */
+    void start(jq_state* jq, jv input) const {
+        jq_start(jq, bind_literals(literals, input), 0);
+    }
+private:
+    SimplePath* simple_path;
+    /* callers using the wrapper through the cache, it is only evicted at 0. incremented under the
+       lock of its cache shard, decremented without it */
+    std::atomic<size_t> cache_refs;
+    /* hash of filter_name, set when it is cached */
+    size_t cache_hash;
+    /* uses through the cache, the frequency of its eviction priority */
+    size_t cache_hits;
+};
+
+/* filter cache key: the hash is computed once per lookup, the text is the caller's string for lookups
+   and the wrapper's filter_name for stored entries */
+struct FilterKey {
+    const std::string* filter;
+    size_t hash;
+    bool operator==(const FilterKey& other) const {
+        return hash == other.hash && *filter == *other.filter;
+    }
+};
+
+struct FilterKeyHash {
+    size_t operator()(const FilterKey& key) const {
+        return key.hash;
+    }
+};
+
+/* independently locked parts of the cache, a filter lives in shard hash % CACHE_SHARDS */
+#define CACHE_SHARDS 16
+
+/* a cached filter as reported by getStats */
+struct CachedFilterStats {
+    std::string filter;
+    double compile_us;
+    size_t footprint;
+    size_t states;
+    size_t idle;
+};
+
+struct CacheShardStats {
+    size_t entries;
+    size_t bytes;
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+};
+
+/* compiled filters, split in shards so threads running different filters rarely share a lock. the
+   entry count (setCacheSize) and the optional byte budget (setCacheMaxBytes) hold for the whole cache:
+   once over either, the largest shard evicts its idle entry of lowest GreedyDual-Size-Frequency priority
+       clock + uses * compile time / size
+   where size is the footprint with a byte budget and 1 without, and the clock is the priority of the
+   shard's last evicted entry. filters used often or slow to compile outlive one-off filters, and entries
+   left unused age out as the clock moves up. uses saturate at CACHE_MAX_USES so that filters which were
+   hot once don't pin their shard for good. busy entries are skipped */
+#define CACHE_MAX_USES 16
+
+class FilterCache {
+private:
+    /* on separate cache lines, shards are locked from different threads */
+    struct alignas(64) Shard {
+        pthread_mutex_t mutex;
+        /* entries by priority, equal priorities in insertion order */
+        std::multimap<double, JqFilterWrapper*> queue;
+        std::unordered_map<FilterKey, JqFilterWrapper*, FilterKeyHash> item_map;
+        /* priorities weigh entries by footprint, there is a byte budget */
+        bool weighted;
+        /* written under the lock, read without it to pick the shard to evict from */
+        std::atomic<size_t> entries;
+        std::atomic<size_t> bytes;
+        double clock;
+        size_t hits;
+        size_t misses;
+        size_t evictions;
+    };
+    Shard shards[CACHE_SHARDS];
+    std::atomic<size_t> cache_size;
+    std::atomic<size_t> cache_max_bytes;
+    /* sums over the shards */
+    std::atomic<size_t> total_entries;
+    std::atomic<size_t> total_bytes;
+
+    Shard& shard_of(size_t hash) {
+        return shards[hash % CACHE_SHARDS];
+    }
+
+    static double priority(const Shard& shard, const JqFilterWrapper* wrapper) {
+        double size = shard.weighted ? (double)wrapper->footprint : 1.0;
+        return shard.clock + (double)wrapper->cache_hits * wrapper->compile_us / size;
+    }
+
+    /* (re)queue wrapper at its current priority, moving its queue node if it has one */
+    static void enqueue(Shard& shard, JqFilterWrapper* wrapper, bool queued) {
+        if (!queued) {
+            wrapper->cache_pos = shard.queue.emplace(priority(shard, wrapper), wrapper);
+            return;
+        }
+        auto node = shard.queue.extract(wrapper->cache_pos);
+        node.key() = priority(shard, wrapper);
+        wrapper->cache_pos = shard.queue.insert(std::move(node));
+    }
+
+    bool over_entries() {
+        return total_entries.load() > cache_size.load();
+    }
+    bool over_bytes() {
+        size_t max_bytes = cache_max_bytes.load();
+        return max_bytes > 0 && total_bytes.load() > max_bytes;
+    }
+
+    /* drop wrapper from the shard's counters, called with the shard locked */
+    void uncount(Shard& shard, JqFilterWrapper* wrapper) {
+        shard.entries.fetch_sub(1);
+        shard.bytes.fetch_sub(wrapper->footprint);
+        total_entries.fetch_sub(1);
+        total_bytes.fetch_sub(wrapper->footprint);
+    }
+
+    /* evict the idle entry of lowest priority, called with the shard locked. false if all are busy */
+    bool evict(Shard& shard) {
+        for (auto it = shard.queue.begin(); it != shard.queue.end(); ++it) {
+            JqFilterWrapper* wrapper = it->second;
+            if (wrapper->cache_refs.load(std::memory_order_acquire) > 0) {
+                CACHE_DEBUG_LOG((void*)wrapper, "Wrapper is busy, skipping");
+                continue;
+            }
+            shard.clock = it->first;
+            /* a wrapper replaced by a later put is only in the queue */
+            auto found = shard.item_map.find(FilterKey{&wrapper->filter_name, wrapper->cache_hash});
+            if (found != shard.item_map.end() && found->second == wrapper) {
+                shard.item_map.erase(found);
+            }
+            shard.queue.erase(it);
+            uncount(shard, wrapper);
+            shard.evictions++;
+            CACHE_DEBUG_LOG((void*)wrapper, "Deleting wrapper");
+            delete wrapper;
+            return true;
+        }
+        return false;
+    }
+
+    /* evict until the cache fits its budgets, from the largest shards first. called with no shard locked,
+       stops early if every entry left over is busy */
+    void clean() {
+        for (;;) {
+            bool by_bytes = over_bytes();
+            if (!by_bytes && !over_entries()) {
+                return;
+            }
+            size_t order[CACHE_SHARDS];
+            for (size_t i = 0; i < CACHE_SHARDS; i++) {
+                order[i] = i;
+            }
+            std::sort(order, order + CACHE_SHARDS, [&](size_t a, size_t b) {
+                return by_bytes ? shards[a].bytes.load() > shards[b].bytes.load()
+                                : shards[a].entries.load() > shards[b].entries.load();
+            });
+            bool evicted = false;
+            for (size_t i = 0; i < CACHE_SHARDS && !evicted; i++) {
+                Shard& shard = shards[order[i]];
+                pthread_mutex_lock(&shard.mutex);
+                /* another thread may have made room meanwhile */
+                if (!over_bytes() && !over_entries()) {
+                    pthread_mutex_unlock(&shard.mutex);
+                    return;
+                }
+                CACHE_DEBUG_LOG(&shard, "Starting cleanup. Current size=%zu", shard.queue.size());
+                evicted = evict(shard);
+                pthread_mutex_unlock(&shard.mutex);
+            }
+            if (!evicted) {
+                return;
+            }
+        }
+    }
+
+    /* reweigh the shards if the byte budget came or went, then evict down to the budgets */
+    void set_budgets() {
+        bool weighted = cache_max_bytes.load() > 0;
+        for (Shard& shard : shards) {
+            pthread_mutex_lock(&shard.mutex);
+            if (shard.weighted != weighted) {
+                shard.weighted = weighted;
+                /* priorities are in other units now */
+                shard.clock = 0;
+                std::vector<JqFilterWrapper*> wrappers;
+                for (auto& item : shard.queue) {
+                    wrappers.push_back(item.second);
+                }
+                for (JqFilterWrapper* wrapper : wrappers) {
+                    enqueue(shard, wrapper, true);
+                }
+            }
+            pthread_mutex_unlock(&shard.mutex);
+        }
+        clean();
+    }
+
+public:
+    FilterCache(size_t cache_size_) : cache_size(cache_size_), cache_max_bytes(0), total_entries(0), total_bytes(0) {
+        for (Shard& shard : shards) {
+            pthread_mutex_init(&shard.mutex, nullptr);
+            shard.weighted = false;
+            shard.entries = 0;
+            shard.bytes = 0;
+            shard.clock = 0;
+            shard.hits = 0;
+            shard.misses = 0;
+            shard.evictions = 0;
+        }
+        set_budgets();
+        CACHE_DEBUG_LOG(this, "Created cache with size %zu", cache_size_);
+    }
+    ~FilterCache() {
+        for (Shard& shard : shards) {
+            pthread_mutex_destroy(&shard.mutex);
+        }
+    }
+
+    static size_t hash(const std::string& filter) {
+        return std::hash<std::string>()(filter);
+    }
+
+    void dec_refcnt(JqFilterWrapper* val) {
+        CACHE_DEBUG_LOG((void*)val, "Decrementing refcnt for wrapper:%p", (void*)val);
+        val->cache_refs.fetch_sub(1, std::memory_order_release);
+    }
+
+    /* cache val under its filter (hashed to hash), the caller owns a reference to release with dec_refcnt */
+    void put(size_t hash, JqFilterWrapper* val) {
+        CACHE_DEBUG_LOG((void*)val, "Putting key='%s' wrapper:%p", val->filter_name.c_str(), (void*)val);
+        Shard& shard = shard_of(hash);
+        FilterKey key{&val->filter_name, hash};
+        val->cache_hash = hash;
+        val->cache_hits = 1;
+        pthread_mutex_lock(&shard.mutex);
+        val->cache_refs.fetch_add(1, std::memory_order_relaxed);
+        auto it = shard.item_map.find(key);
+        if (it != shard.item_map.end()) {
+            CACHE_DEBUG_LOG((void*)val, "Replacing existing entry, old_ptr=%p , new_ptr=%p", (void*)it->second, (void*)val);
+            shard.item_map.erase(it);
+        }
+        enqueue(shard, val, false);
+        shard.entries.fetch_add(1);
+        shard.bytes.fetch_add(val->footprint);
+        total_entries.fetch_add(1);
+        total_bytes.fetch_add(val->footprint);
+        shard.item_map.emplace(key, val);
+        pthread_mutex_unlock(&shard.mutex);
+        clean();
+    }
+
+    /* cached wrapper of filter (hashed to hash) with a reference for the caller, null on a miss.
+       count_miss is false for a lookup a worker repeats to compile the filter */
+    JqFilterWrapper* get(const std::string& filter, size_t hash, bool count_miss = true) {
+        Shard& shard = shard_of(hash);
+        pthread_mutex_lock(&shard.mutex);
+        auto it = shard.item_map.find(FilterKey{&filter, hash});
+        if (it == shard.item_map.end()) {
+            CACHE_DEBUG_LOG(nullptr, "Cache miss for key='%s'", filter.c_str());
+            if (count_miss) {
+                shard.misses++;
+            }
+            pthread_mutex_unlock(&shard.mutex);
+            return nullptr;
+        }
+        JqFilterWrapper* wrapper = it->second;
+        if (wrapper->cache_hits < CACHE_MAX_USES) {
+            wrapper->cache_hits++;
+        }
+        enqueue(shard, wrapper, true);
+        wrapper->cache_refs.fetch_add(1, std::memory_order_relaxed);
+        shard.hits++;
+        pthread_mutex_unlock(&shard.mutex);
+        CACHE_DEBUG_LOG((void*)wrapper, "Cache hit for jq wrapper,pointer=%p,name=%s", (void*)wrapper, wrapper->filter_name.c_str());
+        return wrapper;
+    }
+
+    JqFilterWrapper* get(const std::string& filter) {
+        return get(filter, hash(filter));
+    }
+
+    /* aggregate pool usage over all cached filters */
+    void pool_stats(size_t* entries, size_t* states, size_t* idle) {
+        *entries = 0;
+        *states = 0;
+        *idle = 0;
+        /* filters sharing a program share its states, count them once */
+        std::unordered_set<StatePool*> seen;
+        for (Shard& shard : shards) {
+            pthread_mutex_lock(&shard.mutex);
+            *entries += shard.queue.size();
+            for (auto& item : shard.queue) {
+                size_t wrapper_states, wrapper_idle;
+                if (!seen.insert(item.second->pool.get()).second) {
+                    continue;
+                }
+                item.second->pool_stats(&wrapper_states, &wrapper_idle);
+                *states += wrapper_states;
+                *idle += wrapper_idle;
+            }
+            pthread_mutex_unlock(&shard.mutex);
+        }
+    }
+
+    void filter_stats(std::vector<CachedFilterStats>& filters) {
+        for (Shard& shard : shards) {
+            pthread_mutex_lock(&shard.mutex);
+            for (auto& item : shard.queue) {
+                JqFilterWrapper* wrapper = item.second;
+                CachedFilterStats stats;
+                stats.filter = wrapper->filter_name;
+                stats.compile_us = wrapper->compile_us;
+                stats.footprint = wrapper->footprint;
+                wrapper->pool_stats(&stats.states, &stats.idle);
+                filters.push_back(std::move(stats));
+            }
+            pthread_mutex_unlock(&shard.mutex);
+        }
+    }
+
+    void shard_stats(CacheShardStats* stats) {
+        for (size_t i = 0; i < CACHE_SHARDS; i++) {
+            Shard& shard = shards[i];
+            pthread_mutex_lock(&shard.mutex);
+            stats[i].entries = shard.queue.size();
+            stats[i].bytes = shard.bytes.load();
+            stats[i].hits = shard.hits;
+            stats[i].misses = shard.misses;
+            stats[i].evictions = shard.evictions;
+            pthread_mutex_unlock(&shard.mutex);
+        }
+    }
+
+    size_t size() {
+        return cache_size.load();
+    }
+    size_t max_bytes() {
+        return cache_max_bytes.load();
+    }
+    void resize(size_t new_size) {
+        CACHE_DEBUG_LOG(this, "Resizing cache from %zu to %zu", cache_size.load(), new_size);
+        cache_size = new_size;
+        set_budgets();
+    }
+    /* 0 for no byte budget */
+    void set_max_bytes(size_t new_max_bytes) {
+        cache_max_bytes = new_max_bytes;
+        set_budgets();
+    }
+};
+
+extern FilterCache cache;
+JqFilterWrapper* new_filter_wrapper(const std::string& filter, struct err_data* err);
+JqFilterWrapper* get_cached_wrapper(const std::string& filter, struct err_data* err);
+
+#endif
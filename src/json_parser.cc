@@ -0,0 +1,567 @@
+#include "src/binding.h"
+#include "src/json_parser.h"
+#include "src/stats.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#endif
+
+std::atomic<int> json_parser(JSON_PARSER_JQ);
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define JSON_PARSER_AVX2 1
+#endif
+
+/* nesting jv_parse surely takes (it counts objects twice), deeper input is left to it */
+#define JSON_MAX_DEPTH 128
+/* distinct keys a parse keeps to reuse */
+#define JSON_MAX_KEYS 1024
+/* blocks scanned at a time, the walk never holds more positions than their bytes */
+#define JSON_SCAN_BLOCKS 16
+
+enum { JSON_QUOTE = 1, JSON_BACKSLASH = 2, JSON_OP = 4, JSON_SPACE = 8 };
+
+static const struct JsonClasses {
+    uint8_t of[256];
+
+    JsonClasses() : of() {
+        of[(uint8_t)'"'] = JSON_QUOTE;
+        of[(uint8_t)'\\'] = JSON_BACKSLASH;
+        for (char c : { ',', ':', '[', ']', '{', '}' }) {
+            of[(uint8_t)c] = JSON_OP;
+        }
+        for (char c : { ' ', '\t', '\n', '\r' }) {
+            of[(uint8_t)c] = JSON_SPACE;
+        }
+    }
+} json_classes;
+
+/* one bit per byte of a 64-byte block */
+struct JsonBlock {
+    uint64_t quote;
+    uint64_t backslash;
+    uint64_t op;
+    uint64_t space;
+};
+
+typedef void (*JsonClassifier)(const uint8_t* block, JsonBlock* bits);
+
+static void json_classify_scalar(const uint8_t* block, JsonBlock* bits) {
+    uint64_t quote = 0, backslash = 0, op = 0, space = 0;
+    for (int i = 0; i < 64; i++) {
+        uint64_t cls = json_classes.of[block[i]];
+        quote |= (cls & 1) << i;
+        backslash |= ((cls >> 1) & 1) << i;
+        op |= ((cls >> 2) & 1) << i;
+        space |= ((cls >> 3) & 1) << i;
+    }
+    *bits = { quote, backslash, op, space };
+}
+
+#ifdef JSON_PARSER_AVX2
+__attribute__((target("avx2")))
+static void json_classify_avx2(const uint8_t* block, JsonBlock* bits) {
+    uint64_t masks[4] = { 0, 0, 0, 0 };
+    for (int half = 0; half < 2; half++) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + half * 32));
+        /* '[' and '{', ']' and '}' differ in bit 0x20 only */
+        __m256i folded = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+        __m256i op = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(folded, _mm256_set1_epi8('{')), _mm256_cmpeq_epi8(folded, _mm256_set1_epi8('}'))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(',')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8(':'))));
+        __m256i space = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))));
+        int shift = half * 32;
+        masks[0] |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"'))) << shift;
+        masks[1] |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))) << shift;
+        masks[2] |= (uint64_t)(uint32_t)_mm256_movemask_epi8(op) << shift;
+        masks[3] |= (uint64_t)(uint32_t)_mm256_movemask_epi8(space) << shift;
+    }
+    *bits = { masks[0], masks[1], masks[2], masks[3] };
+}
+#endif
+
+/* the vector classifier if the cpu has one, checked once */
+static JsonClassifier json_vector_classifier() {
+#ifdef JSON_PARSER_AVX2
+    static const JsonClassifier best = __builtin_cpu_supports("avx2") ? json_classify_avx2 : json_classify_scalar;
+    return best;
+#else
+    return json_classify_scalar;
+#endif
+}
+
+/* xor of each bit with all the bits below it, a string mask from its quotes */
+static inline uint64_t prefix_xor(uint64_t x) {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+/* stage one: positions of the structural characters of the text, in order. these are the operators and
+   the quotes of strings, and the first byte of every other run (numbers and literals) outside strings */
+class JsonStructurals {
+public:
+    JsonStructurals(const char* text, size_t length, JsonClassifier classify)
+        : text(reinterpret_cast<const uint8_t*>(text)), length(length), classify(classify), scanned(0),
+          in_string(0), escape_carry(0), scalar_carry(0), count(0), index(0) {}
+
+    /* next position, false past the last one */
+    bool next(size_t* pos) {
+        if (!peek(pos)) {
+            return false;
+        }
+        index++;
+        return true;
+    }
+
+    bool peek(size_t* pos) {
+        while (index == count) {
+            if (scanned >= length) {
+                return false;
+            }
+            scan();
+        }
+        *pos = positions[index];
+        return true;
+    }
+
+private:
+    const uint8_t* text;
+    size_t length;
+    JsonClassifier classify;
+    size_t scanned;
+    /* state carried from one block to the next */
+    uint64_t in_string;
+    uint64_t escape_carry;
+    uint64_t scalar_carry;
+    size_t positions[JSON_SCAN_BLOCKS * 64];
+    size_t count;
+    size_t index;
+
+    void scan() {
+        count = 0;
+        index = 0;
+        for (int i = 0; i < JSON_SCAN_BLOCKS && scanned < length; i++, scanned += 64) {
+            const uint8_t* block = text + scanned;
+            uint8_t tail[64];
+            if (length - scanned < 64) {
+                /* pad the last block with spaces, they are never structural */
+                memset(tail, ' ', sizeof(tail));
+                memcpy(tail, block, length - scanned);
+                block = tail;
+            }
+            JsonBlock bits;
+            classify(block, &bits);
+
+            /* the byte after each backslash that isn't escaped itself. backslashes are rare, walk them */
+            uint64_t escaped = escape_carry;
+            uint64_t backslash = bits.backslash & ~escape_carry;
+            escape_carry = 0;
+            while (backslash != 0) {
+                int bit = __builtin_ctzll(backslash);
+                if (bit == 63) {
+                    escape_carry = 1;
+                    break;
+                }
+                escaped |= 2ULL << bit;
+                backslash &= ~(3ULL << bit);
+            }
+
+            uint64_t quote = bits.quote & ~escaped;
+            uint64_t string = prefix_xor(quote) ^ in_string;
+            in_string = (uint64_t)((int64_t)string >> 63);
+            uint64_t scalar = ~(bits.op | bits.space | quote);
+            uint64_t starts = scalar & ~((scalar << 1) | scalar_carry);
+            scalar_carry = scalar >> 63;
+
+            uint64_t structural = ((bits.op | starts) & ~string) | quote;
+            while (structural != 0) {
+                positions[count++] = scanned + __builtin_ctzll(structural);
+                structural &= structural - 1;
+            }
+        }
+    }
+};
+
+static const double json_pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+/* a number jq prints as the double it reads, only those are built here. jq keeps the literal of parsed
+   numbers and prints it back as written, so 1.0, 1.50, 1e5 or 9007199254740993 must come from jv_parse
+   to print the same. integers of up to 15 digits are exact and printed whole. fractions print as the
+   shortest digits that read back the same, in fixed notation down to 0.001 */
+static bool json_canonical_number(const char* s, size_t length, double value, int digits, int fraction) {
+    if (fraction == 0) {
+        return digits <= 15;
+    }
+    size_t sign = s[0] == '-';
+    if (length >= sign + 5 && memcmp(s + sign, "0.000", 5) == 0) {
+        return false;
+    }
+    char buf[64];
+    std::to_chars_result printed = std::to_chars(buf, buf + sizeof(buf), value, std::chars_format::fixed);
+    return printed.ec == std::errc() && (size_t)(printed.ptr - buf) == length && memcmp(buf, s, length) == 0;
+}
+
+/* a JSON number, the whole of s. up to 15 significant digits with at most 22 after the point are exact
+   doubles divided by an exact power of ten, which rounds them right. other numbers go through strtod,
+   which rounds them right too. numbers with an exponent, numbers jq would print other than as their
+   double (see json_canonical_number) and the ones strtod can't take (a locale with another decimal
+   point) go to jq's own parser */
+static bool json_number(const char* s, size_t length, jv* out) {
+    size_t i = 0;
+    bool negative = s[0] == '-';
+    if (negative) {
+        i++;
+    }
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int fraction = 0;
+    bool exact = true;
+    auto digit = [&](char c) {
+        /* leading zeros aren't significant */
+        if (mantissa == 0 && c == '0') {
+            return;
+        }
+        if (++digits > 15) {
+            exact = false;
+            return;
+        }
+        mantissa = mantissa * 10 + (c - '0');
+    };
+    if (i == length || s[i] < '0' || s[i] > '9') {
+        return false;
+    }
+    if (s[i] == '0') {
+        i++;
+    } else {
+        for (; i < length && s[i] >= '0' && s[i] <= '9'; i++) {
+            digit(s[i]);
+        }
+    }
+    if (i < length && s[i] == '.') {
+        i++;
+        if (i == length || s[i] < '0' || s[i] > '9') {
+            return false;
+        }
+        for (; i < length && s[i] >= '0' && s[i] <= '9'; i++) {
+            digit(s[i]);
+            fraction++;
+        }
+    }
+    /* only checked, numbers with an exponent are jq's to read */
+    bool has_exponent = i < length && (s[i] == 'e' || s[i] == 'E');
+    if (has_exponent) {
+        i++;
+        if (i < length && (s[i] == '-' || s[i] == '+')) {
+            i++;
+        }
+        if (i == length || s[i] < '0' || s[i] > '9') {
+            return false;
+        }
+        while (i < length && s[i] >= '0' && s[i] <= '9') {
+            i++;
+        }
+    }
+    if (i != length) {
+        return false;
+    }
+    if (exact && !has_exponent && fraction <= 22) {
+        double value = (double)mantissa / json_pow10[fraction];
+        value = negative ? -value : value;
+        if (json_canonical_number(s, length, value, digits, fraction)) {
+            *out = jv_number(value);
+            return true;
+        }
+    } else if (!has_exponent && length < 64) {
+        char digits_buf[64];
+        memcpy(digits_buf, s, length);
+        digits_buf[length] = 0;
+        char* end;
+        errno = 0;
+        double value = strtod(digits_buf, &end);
+        if (end == digits_buf + length && errno == 0 && json_canonical_number(s, length, value, digits, fraction)) {
+            *out = jv_number(value);
+            return true;
+        }
+    }
+    jv number = jv_parse_sized(s, (int)length);
+    if (jv_get_kind(number) != JV_KIND_NUMBER) {
+        jv_free(number);
+        return false;
+    }
+    *out = number;
+    return true;
+}
+
+static bool json_hex4(const char* s, size_t length, unsigned int* out) {
+    if (length < 4) {
+        return false;
+    }
+    unsigned int value = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = s[i];
+        value <<= 4;
+        if (c >= '0' && c <= '9') {
+            value |= c - '0';
+        } else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f') {
+            value |= (c | 0x20) - 'a' + 10;
+        } else {
+            return false;
+        }
+    }
+    *out = value;
+    return true;
+}
+
+/* the content of a JSON string, s is between its quotes. jv_string_sized replaces invalid UTF-8 like jq does */
+static bool json_string(const char* s, size_t length, std::string* scratch, jv* out) {
+    size_t i = 0;
+    while (i < length && (uint8_t)s[i] >= 0x20 && s[i] != '\\') {
+        i++;
+    }
+    if (i == length) {
+        *out = jv_string_sized(s, (int)length);
+        return true;
+    }
+    scratch->assign(s, i);
+    while (i < length) {
+        uint8_t c = s[i];
+        if (c < 0x20) {
+            return false;
+        }
+        if (c != '\\') {
+            scratch->push_back(c);
+            i++;
+            continue;
+        }
+        if (i + 1 == length) {
+            return false;
+        }
+        char escape = s[i + 1];
+        i += 2;
+        switch (escape) {
+            case '"':
+            case '\\':
+            case '/':
+                scratch->push_back(escape);
+                break;
+            case 'b': scratch->push_back('\b'); break;
+            case 'f': scratch->push_back('\f'); break;
+            case 'n': scratch->push_back('\n'); break;
+            case 'r': scratch->push_back('\r'); break;
+            case 't': scratch->push_back('\t'); break;
+            case 'u': {
+                unsigned int codepoint, low;
+                if (!json_hex4(s + i, length - i, &codepoint)) {
+                    return false;
+                }
+                i += 4;
+                if (codepoint >= 0xDC00 && codepoint <= 0xDFFF) {
+                    return false;
+                }
+                if (codepoint >= 0xD800 && codepoint <= 0xDBFF) {
+                    if (length - i < 6 || s[i] != '\\' || s[i + 1] != 'u' || !json_hex4(s + i + 2, length - i - 2, &low) ||
+                        low < 0xDC00 || low > 0xDFFF) {
+                        return false;
+                    }
+                    i += 6;
+                    codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+                }
+                if (codepoint < 0x80) {
+                    scratch->push_back(codepoint);
+                } else if (codepoint < 0x800) {
+                    scratch->push_back(0xC0 | (codepoint >> 6));
+                    scratch->push_back(0x80 | (codepoint & 0x3F));
+                } else if (codepoint < 0x10000) {
+                    scratch->push_back(0xE0 | (codepoint >> 12));
+                    scratch->push_back(0x80 | ((codepoint >> 6) & 0x3F));
+                    scratch->push_back(0x80 | (codepoint & 0x3F));
+                } else {
+                    scratch->push_back(0xF0 | (codepoint >> 18));
+                    scratch->push_back(0x80 | ((codepoint >> 12) & 0x3F));
+                    scratch->push_back(0x80 | ((codepoint >> 6) & 0x3F));
+                    scratch->push_back(0x80 | (codepoint & 0x3F));
+                }
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+    *out = jv_string_sized(scratch->data(), (int)scratch->size());
+    return true;
+}
+
+/* stage two: the values at the structural positions, containers kept on a stack until they close */
+class JsonBuilder {
+public:
+    JsonBuilder(const char* text, size_t length, JsonClassifier classify)
+        : text(text), length(length), structurals(text, length, classify) {}
+
+    ~JsonBuilder() {
+        for (Frame& frame : stack) {
+            jv_free(frame.container);
+            jv_free(frame.key);
+        }
+        for (auto& key : keys) {
+            jv_free(key.second);
+        }
+    }
+
+    /* false if the text isn't plain JSON to it */
+    bool parse(jv* out) {
+        size_t pos;
+        while (true) {
+            jv value;
+            if (!structurals.next(&pos) || !read_value(pos, &value)) {
+                return false;
+            }
+            if (value_is_container) {
+                continue;
+            }
+            /* add the value to its container, closing containers until one takes another value */
+            while (true) {
+                if (stack.empty()) {
+                    if (structurals.next(&pos)) {
+                        jv_free(value);
+                        return false;
+                    }
+                    *out = value;
+                    return true;
+                }
+                Frame& frame = stack.back();
+                if (frame.is_object) {
+                    frame.container = jv_object_set(frame.container, frame.key, value);
+                    frame.key = jv_invalid();
+                } else {
+                    frame.container = jv_array_append(frame.container, value);
+                }
+                if (!structurals.next(&pos)) {
+                    return false;
+                }
+                if (text[pos] == ',') {
+                    if (frame.is_object && !read_key()) {
+                        return false;
+                    }
+                    break;
+                }
+                if (text[pos] != (frame.is_object ? '}' : ']')) {
+                    return false;
+                }
+                value = frame.container;
+                stack.pop_back();
+            }
+        }
+    }
+
+private:
+    struct Frame {
+        jv container;
+        /* key of the value being read, invalid between values */
+        jv key;
+        bool is_object;
+    };
+
+    const char* text;
+    size_t length;
+    JsonStructurals structurals;
+    std::vector<Frame> stack;
+    std::string scratch;
+    /* keys without escapes as written, objects of a kind repeat theirs */
+    std::unordered_map<std::string_view, jv> keys;
+    /* the last read_value opened a non-empty container */
+    bool value_is_container;
+
+    bool read_string(size_t pos, jv* out) {
+        size_t end;
+        /* inside a string only its closing quote is structural */
+        return structurals.next(&end) && json_string(text + pos + 1, end - pos - 1, &scratch, out);
+    }
+
+    bool read_key() {
+        size_t pos, end;
+        Frame& frame = stack.back();
+        if (!structurals.next(&pos) || text[pos] != '"' || !structurals.next(&end)) {
+            return false;
+        }
+        std::string_view name(text + pos + 1, end - pos - 1);
+        auto found = keys.find(name);
+        if (found != keys.end()) {
+            frame.key = jv_copy(found->second);
+        } else {
+            if (!json_string(name.data(), name.size(), &scratch, &frame.key)) {
+                return false;
+            }
+            if (keys.size() < JSON_MAX_KEYS && name.find('\\') == std::string_view::npos) {
+                keys.emplace(name, jv_copy(frame.key));
+            }
+        }
+        return structurals.next(&pos) && text[pos] == ':';
+    }
+
+    bool read_value(size_t pos, jv* out) {
+        value_is_container = false;
+        char c = text[pos];
+        if (c == '[' || c == '{') {
+            size_t next;
+            if (stack.size() >= JSON_MAX_DEPTH || !structurals.peek(&next)) {
+                return false;
+            }
+            if (text[next] == (c == '[' ? ']' : '}')) {
+                structurals.next(&next);
+                *out = c == '[' ? jv_array() : jv_object();
+                return true;
+            }
+            stack.push_back({ c == '[' ? jv_array() : jv_object(), jv_invalid(), c == '{' });
+            value_is_container = true;
+            return c == '[' || read_key();
+        }
+        if (c == '"') {
+            return read_string(pos, out);
+        }
+        if (json_classes.of[(uint8_t)c] != 0) {
+            return false;
+        }
+        /* a number or literal runs up to the next space, operator or quote */
+        size_t end = pos + 1;
+        while (end < length && (json_classes.of[(uint8_t)text[end]] & (JSON_QUOTE | JSON_OP | JSON_SPACE)) == 0) {
+            end++;
+        }
+        size_t run = end - pos;
+        switch (c) {
+            case 't':
+                *out = jv_true();
+                return run == 4 && memcmp(text + pos, "true", 4) == 0;
+            case 'f':
+                *out = jv_false();
+                return run == 5 && memcmp(text + pos, "false", 5) == 0;
+            case 'n':
+                *out = jv_null();
+                return run == 4 && memcmp(text + pos, "null", 4) == 0;
+            default:
+                return json_number(text + pos, run, out);
+        }
+    }
+};
+
+/* parse JSON text with the parser setJsonParser chose, invalid if it isn't valid JSON */
+jv parse_json(const char* text, size_t length) {
+    int parser = json_parser.load(std::memory_order_relaxed);
+    if (parser != JSON_PARSER_JQ) {
+        JsonBuilder builder(text, length, parser == JSON_PARSER_SIMD ? json_vector_classifier() : json_classify_scalar);
+        jv value;
+        if (builder.parse(&value)) {
+            return value;
+        }
+    }
+    return jv_parse_sized(text, length);
+}
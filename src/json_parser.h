@@ -0,0 +1,16 @@
+#ifndef SRC_JSON_PARSER_H_
+#define SRC_JSON_PARSER_H_
+
+#include "src/binding.h"
+
+/* JSON text to jv without jq's parser, setJsonParser('simd'). two stages like simdjson: the first finds
+   the structural characters of 64-byte blocks with vector compares (AVX2 when the cpu has it, a lookup
+   table otherwise) and bit tricks for escapes and strings, the second walks them and builds the jv tree.
+   anything that isn't plain JSON to it (errors, deep nesting, lone surrogates, control characters, numbers
+   jq reads leniently) is left to jv_parse_sized, so are numbers jq would print other than as their double
+   (jq keeps the text of number literals, 1.0 stays 1.0). results and errors are jq's either way */
+enum JsonParser { JSON_PARSER_JQ, JSON_PARSER_SIMD, JSON_PARSER_SCALAR };
+extern std::atomic<int> json_parser;
+jv parse_json(const char* text, size_t length);
+
+#endif
@@ -0,0 +1,111 @@
+#include "src/binding.h"
+#include "src/result_cache.h"
+
+static inline void fingerprint_word(Fingerprint* fp, uint64_t word) {
+    fp->a = rotl64(fp->a ^ word, 27) * 0x9E3779B97F4A7C15ULL;
+    fp->b = rotl64(fp->b + word * 0xC2B2AE3D27D4EB4FULL, 31) * 0x165667B19E3779F9ULL;
+}
+
+static void fingerprint_bytes(Fingerprint* fp, const char* bytes, size_t length) {
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        memcpy(&word, bytes + i, 8);
+        fingerprint_word(fp, word);
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, bytes + i, length - i);
+    fingerprint_word(fp, tail);
+    fingerprint_word(fp, length);
+}
+
+/* fingerprint of v (not consumed), object keys in their order since results keep it */
+static void fingerprint_jv(Fingerprint* fp, jv v) {
+    jv_kind kind = jv_get_kind(v);
+    fingerprint_word(fp, kind);
+    switch (kind) {
+        case JV_KIND_NUMBER: {
+            double number = jv_number_value(v);
+            uint64_t bits;
+            memcpy(&bits, &number, 8);
+            fingerprint_word(fp, bits);
+            break;
+        }
+        case JV_KIND_STRING:
+            fingerprint_bytes(fp, jv_string_value(v), jv_string_length_bytes(jv_copy(v)));
+            break;
+        case JV_KIND_ARRAY: {
+            int len = jv_array_length(jv_copy(v));
+            fingerprint_word(fp, len);
+            for (int i = 0; i < len; i++) {
+                jv item = jv_array_get(jv_copy(v), i);
+                fingerprint_jv(fp, item);
+                jv_free(item);
+            }
+            break;
+        }
+        case JV_KIND_OBJECT: {
+            int iter = jv_object_iter(v);
+            while (jv_object_iter_valid(v, iter)) {
+                jv key = jv_object_iter_key(v, iter);
+                jv value = jv_object_iter_value(v, iter);
+                fingerprint_jv(fp, key);
+                fingerprint_jv(fp, value);
+                jv_free(key);
+                jv_free(value);
+                iter = jv_object_iter_next(v, iter);
+            }
+            fingerprint_word(fp, 0);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+/* fingerprint of the input of a call, JSON text and converted values never match each other */
+Fingerprint input_fingerprint(const char* bytes, size_t length, const jv* value) {
+    Fingerprint fp = { 0x243F6A8885A308D3ULL, 0x13198A2E03707344ULL };
+    if (value != nullptr) {
+        fingerprint_jv(&fp, *value);
+    } else {
+        fingerprint_word(&fp, 1);
+        fingerprint_bytes(&fp, bytes, length);
+    }
+    return fp;
+}
+
+/* approximate memory held by v (not consumed) */
+size_t jv_footprint(jv v) {
+    switch (jv_get_kind(v)) {
+        case JV_KIND_STRING:
+            return 32 + jv_string_length_bytes(jv_copy(v));
+        case JV_KIND_ARRAY: {
+            int len = jv_array_length(jv_copy(v));
+            size_t size = 32;
+            for (int i = 0; i < len; i++) {
+                jv item = jv_array_get(jv_copy(v), i);
+                size += 16 + jv_footprint(item);
+                jv_free(item);
+            }
+            return size;
+        }
+        case JV_KIND_OBJECT: {
+            size_t size = 64;
+            int iter = jv_object_iter(v);
+            while (jv_object_iter_valid(v, iter)) {
+                jv key = jv_object_iter_key(v, iter);
+                jv value = jv_object_iter_value(v, iter);
+                size += 32 + jv_footprint(key) + jv_footprint(value);
+                jv_free(key);
+                jv_free(value);
+                iter = jv_object_iter_next(v, iter);
+            }
+            return size;
+        }
+        default:
+            return 16;
+    }
+}
+
+ResultCache result_cache;
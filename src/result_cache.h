@@ -0,0 +1,173 @@
+#ifndef SRC_RESULT_CACHE_H_
+#define SRC_RESULT_CACHE_H_
+
+#include "src/binding.h"
+#include "src/stats.h"
+#include "src/convert.h"
+
+/* 128-bit fingerprint of an input, the result cache keeps it instead of the input. two independent
+   64-bit streams, fast rather than collision resistant */
+struct Fingerprint {
+    uint64_t a;
+    uint64_t b;
+};
+
+static inline uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+Fingerprint input_fingerprint(const char* bytes, size_t length, const jv* value);
+size_t jv_footprint(jv v);
+
+/* a memoized result: the first output of a filter (by wrapper id) run on an input (by fingerprint)
+   for an output format, undefined if the filter had no output */
+struct ResultEntry {
+    uint64_t filter_id;
+    OutputFormat output;
+    Fingerprint input;
+    bool is_undefined;
+    /* owned by the cache and only touched under its lock, callers get copies */
+    jv value;
+    size_t footprint;
+    uint64_t expires_ns;
+};
+
+#define RESULT_ENTRY_BASE_BYTES 128
+
+/* results of deterministic filters kept by setResultCache, least recently used first out of a byte
+   budget. off (a budget of 0) by default */
+class ResultCache {
+public:
+    ResultCache() : max_bytes(0), ttl_ns(0), bytes(0), hits(0), misses(0), evictions(0), expired(0) {
+        pthread_mutex_init(&mutex, nullptr);
+    }
+
+    bool enabled() const {
+        return max_bytes.load(std::memory_order_relaxed) > 0;
+    }
+
+    /* set the budget and ttl (0 for none), dropping what no longer fits. a budget of 0 empties the cache */
+    void configure(size_t max_bytes_, uint64_t ttl_ns_) {
+        pthread_mutex_lock(&mutex);
+        max_bytes.store(max_bytes_, std::memory_order_relaxed);
+        ttl_ns = ttl_ns_;
+        evict(0);
+        pthread_mutex_unlock(&mutex);
+    }
+
+    /* a copy of the memoized result into result, false on a miss */
+    bool lookup(uint64_t filter_id, OutputFormat output, const Fingerprint& input, FilterResult* result) {
+        uint64_t key = entry_key(filter_id, output, input);
+        pthread_mutex_lock(&mutex);
+        auto found = index.find(key);
+        if (found == index.end() || !matches(*found->second, filter_id, output, input)) {
+            misses++;
+            pthread_mutex_unlock(&mutex);
+            return false;
+        }
+        auto entry = found->second;
+        if (entry->expires_ns != 0 && stats_now() >= entry->expires_ns) {
+            expired++;
+            misses++;
+            drop(entry);
+            pthread_mutex_unlock(&mutex);
+            return false;
+        }
+        hits++;
+        entries.splice(entries.begin(), entries, entry);
+        result->success = true;
+        result->is_undefined = entry->is_undefined;
+        /* a private copy, jv refcounts aren't atomic */
+        result->value = entry->is_undefined ? jv_invalid() : jv_deep_copy(jv_copy(entry->value));
+        pthread_mutex_unlock(&mutex);
+        return true;
+    }
+
+    /* memoize the first output of a run (not consumed, already prepared for output): a value, or an
+       invalid without a message for no output. errors aren't kept, a timeout may not happen next time */
+    void store(uint64_t filter_id, OutputFormat output, const Fingerprint& input, jv value) {
+        bool is_undefined = !jv_is_valid(value);
+        if (is_undefined && jv_invalid_has_msg(jv_copy(value))) {
+            return;
+        }
+        ResultEntry entry;
+        entry.filter_id = filter_id;
+        entry.output = output;
+        entry.input = input;
+        entry.is_undefined = is_undefined;
+        /* copied before taking the lock, the value may share parts with a jq state */
+        entry.value = is_undefined ? jv_invalid() : jv_deep_copy(jv_copy(value));
+        entry.footprint = RESULT_ENTRY_BASE_BYTES + (is_undefined ? 0 : jv_footprint(entry.value));
+        uint64_t key = entry_key(filter_id, output, input);
+        pthread_mutex_lock(&mutex);
+        if (entry.footprint > max_bytes.load(std::memory_order_relaxed)) {
+            pthread_mutex_unlock(&mutex);
+            jv_free(entry.value);
+            return;
+        }
+        uint64_t ttl = ttl_ns;
+        entry.expires_ns = ttl > 0 ? stats_now() + ttl : 0;
+        auto found = index.find(key);
+        if (found != index.end()) {
+            drop(found->second);
+        }
+        evict(entry.footprint);
+        entries.push_front(entry);
+        index[key] = entries.begin();
+        bytes += entry.footprint;
+        pthread_mutex_unlock(&mutex);
+    }
+
+    void stats(size_t* entries_, size_t* bytes_, size_t* max_bytes_, uint64_t* ttl_ns_, uint64_t* hits_,
+               uint64_t* misses_, uint64_t* evictions_, uint64_t* expired_) {
+        pthread_mutex_lock(&mutex);
+        *entries_ = entries.size();
+        *bytes_ = bytes;
+        *max_bytes_ = max_bytes.load(std::memory_order_relaxed);
+        *ttl_ns_ = ttl_ns;
+        *hits_ = hits;
+        *misses_ = misses;
+        *evictions_ = evictions;
+        *expired_ = expired;
+        pthread_mutex_unlock(&mutex);
+    }
+private:
+    std::list<ResultEntry> entries;
+    std::unordered_map<uint64_t, std::list<ResultEntry>::iterator> index;
+    std::atomic<size_t> max_bytes;
+    uint64_t ttl_ns;
+    size_t bytes;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    uint64_t expired;
+    pthread_mutex_t mutex;
+
+    static uint64_t entry_key(uint64_t filter_id, OutputFormat output, const Fingerprint& input) {
+        return input.a ^ rotl64(filter_id * 0x9E3779B97F4A7C15ULL + output, 17);
+    }
+
+    static bool matches(const ResultEntry& entry, uint64_t filter_id, OutputFormat output, const Fingerprint& input) {
+        return entry.filter_id == filter_id && entry.output == output && entry.input.a == input.a && entry.input.b == input.b;
+    }
+
+    void drop(std::list<ResultEntry>::iterator entry) {
+        index.erase(entry_key(entry->filter_id, entry->output, entry->input));
+        bytes -= entry->footprint;
+        jv_free(entry->value);
+        entries.erase(entry);
+    }
+
+    /* make room for incoming bytes, oldest first */
+    void evict(size_t incoming) {
+        size_t budget = max_bytes.load(std::memory_order_relaxed);
+        while (!entries.empty() && bytes + incoming > budget) {
+            drop(std::prev(entries.end()));
+            evictions++;
+        }
+    }
+};
+
+extern ResultCache result_cache;
+
+#endif
@@ -0,0 +1,121 @@
+#include "src/binding.h"
+#include "src/stats.h"
+
+static inline int highest_bit(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return 63 - __builtin_clzll(value);
+#else
+    int bit = 0;
+    while (value >>= 1) {
+        bit++;
+    }
+    return bit;
+#endif
+}
+
+static inline size_t hist_bucket(uint64_t ns) {
+    if (ns < HIST_SUB_BUCKETS) {
+        return ns;
+    }
+    int shift = highest_bit(ns) - HIST_SUB_BITS;
+    return ((size_t)(shift + 1) << HIST_SUB_BITS) + ((ns >> shift) & (HIST_SUB_BUCKETS - 1));
+}
+
+/* single writer increment, no locked instruction */
+static inline void stats_add(std::atomic<uint64_t>& counter, uint64_t value) {
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+/* add the counters of from to into */
+static void stats_merge(ThreadStats& into, const ThreadStats& from) {
+    for (size_t phase = 0; phase < PHASE_COUNT; phase++) {
+        for (size_t bucket = 0; bucket < HIST_BUCKETS; bucket++) {
+            stats_add(into.buckets[phase][bucket], from.buckets[phase][bucket].load(std::memory_order_relaxed));
+        }
+        stats_add(into.total_ns[phase], from.total_ns[phase].load(std::memory_order_relaxed));
+        uint64_t max_ns = from.max_ns[phase].load(std::memory_order_relaxed);
+        if (max_ns > into.max_ns[phase].load(std::memory_order_relaxed)) {
+            into.max_ns[phase].store(max_ns, std::memory_order_relaxed);
+        }
+    }
+    stats_add(into.state_waits, from.state_waits.load(std::memory_order_relaxed));
+    stats_add(into.state_wait_ns, from.state_wait_ns.load(std::memory_order_relaxed));
+}
+
+/* the slot of every live thread that recorded something, and the sum of exited ones. leaked on purpose:
+   slots of threads exiting late, the main thread's at process exit, still reach it after static
+   destructors ran */
+struct StatsRegistry {
+    pthread_mutex_t mutex;
+    std::vector<ThreadStats*> threads;
+    ThreadStats exited;
+
+    StatsRegistry() {
+        pthread_mutex_init(&mutex, nullptr);
+    }
+};
+
+static StatsRegistry& stats_registry() {
+    static StatsRegistry* registry = new StatsRegistry();
+    return *registry;
+}
+
+struct ThreadStatsSlot {
+    ThreadStats* stats = nullptr;
+    ~ThreadStatsSlot() {
+        if (stats == nullptr) {
+            return;
+        }
+        StatsRegistry& registry = stats_registry();
+        pthread_mutex_lock(&registry.mutex);
+        stats_merge(registry.exited, *stats);
+        for (size_t i = 0; i < registry.threads.size(); i++) {
+            if (registry.threads[i] == stats) {
+                registry.threads[i] = registry.threads.back();
+                registry.threads.pop_back();
+                break;
+            }
+        }
+        pthread_mutex_unlock(&registry.mutex);
+        delete stats;
+    }
+};
+static thread_local ThreadStatsSlot stats_slot;
+
+static ThreadStats& thread_stats() {
+    if (stats_slot.stats == nullptr) {
+        stats_slot.stats = new ThreadStats();
+        StatsRegistry& registry = stats_registry();
+        pthread_mutex_lock(&registry.mutex);
+        registry.threads.push_back(stats_slot.stats);
+        pthread_mutex_unlock(&registry.mutex);
+    }
+    return *stats_slot.stats;
+}
+
+/* sum of all threads into total */
+void stats_collect(ThreadStats& total) {
+    StatsRegistry& registry = stats_registry();
+    pthread_mutex_lock(&registry.mutex);
+    stats_merge(total, registry.exited);
+    for (ThreadStats* stats : registry.threads) {
+        stats_merge(total, *stats);
+    }
+    pthread_mutex_unlock(&registry.mutex);
+}
+
+/* record ns spent in phase */
+void stats_record_ns(StatsPhase phase, uint64_t ns) {
+    ThreadStats& stats = thread_stats();
+    stats_add(stats.buckets[phase][hist_bucket(ns)], 1);
+    stats_add(stats.total_ns[phase], ns);
+    if (ns > stats.max_ns[phase].load(std::memory_order_relaxed)) {
+        stats.max_ns[phase].store(ns, std::memory_order_relaxed);
+    }
+}
+
+void stats_record_state_wait(uint64_t ns) {
+    ThreadStats& stats = thread_stats();
+    stats_add(stats.state_waits, 1);
+    stats_add(stats.state_wait_ns, ns);
+}
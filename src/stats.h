@@ -0,0 +1,65 @@
+#ifndef SRC_STATS_H_
+#define SRC_STATS_H_
+
+#include "src/binding.h"
+
+/* latency histograms and counters per phase of a call, kept per thread and summed by getStats */
+
+/* phases of a call timed for getStats */
+enum StatsPhase { PHASE_PARSE, PHASE_EXECUTE, PHASE_SERIALIZE, PHASE_MATERIALIZE, PHASE_COUNT };
+static const char* const phase_names[PHASE_COUNT] = { "parse", "execute", "serialize", "materialize" };
+
+/* log-linear latency buckets like HdrHistogram: values below 8ns have a bucket each, above that every
+   power of two is split in 8 buckets, so a bucket is at most 12.5% wide */
+#define HIST_SUB_BITS 3
+#define HIST_SUB_BUCKETS (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS ((64 - HIST_SUB_BITS + 1) * HIST_SUB_BUCKETS)
+
+/* smallest value counted in bucket */
+static inline uint64_t hist_bucket_start(size_t bucket) {
+    if (bucket < HIST_SUB_BUCKETS) {
+        return bucket;
+    }
+    int shift = (int)(bucket >> HIST_SUB_BITS) - 1;
+    return (uint64_t)(HIST_SUB_BUCKETS + (bucket & (HIST_SUB_BUCKETS - 1))) << shift;
+}
+
+/* counters of one thread. only that thread writes them, so a record is a few uncontended stores.
+   they are relaxed atomics because getStats reads them from the js thread meanwhile */
+struct ThreadStats {
+    std::atomic<uint64_t> buckets[PHASE_COUNT][HIST_BUCKETS];
+    std::atomic<uint64_t> total_ns[PHASE_COUNT];
+    std::atomic<uint64_t> max_ns[PHASE_COUNT];
+    /* acquires of a filter state that had to wait for its lock or for an idle state */
+    std::atomic<uint64_t> state_waits;
+    std::atomic<uint64_t> state_wait_ns;
+
+    ThreadStats() {
+        for (size_t phase = 0; phase < PHASE_COUNT; phase++) {
+            for (size_t bucket = 0; bucket < HIST_BUCKETS; bucket++) {
+                buckets[phase][bucket].store(0, std::memory_order_relaxed);
+            }
+            total_ns[phase].store(0, std::memory_order_relaxed);
+            max_ns[phase].store(0, std::memory_order_relaxed);
+        }
+        state_waits.store(0, std::memory_order_relaxed);
+        state_wait_ns.store(0, std::memory_order_relaxed);
+    }
+};
+
+void stats_collect(ThreadStats& total);
+
+static inline uint64_t stats_now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void stats_record_ns(StatsPhase phase, uint64_t ns);
+
+/* record the time since start (a stats_now()) spent in phase */
+static inline void stats_record(StatsPhase phase, uint64_t start) {
+    stats_record_ns(phase, stats_now() - start);
+}
+
+void stats_record_state_wait(uint64_t ns);
+
+#endif
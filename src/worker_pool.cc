@@ -0,0 +1,126 @@
+#include "src/binding.h"
+#include "src/worker_pool.h"
+
+/* why a queued work did not run, for its complete callback */
+const char* async_status_message(napi_status status) {
+    switch (status) {
+        case napi_queue_full:
+            return "jq worker queue is full";
+        case napi_cancelled:
+            return "jq work waited too long in the worker queue";
+        default:
+            return "Got error from async work";
+    }
+}
+
+/* delete the retired pools whose workers are gone, on the js thread */
+void reap_retired_pools(EnvData* env_state) {
+    std::vector<WorkerPool*>& retired = env_state->retired_pools;
+    for (size_t i = 0; i < retired.size();) {
+        if (retired[i]->stopped()) {
+            delete retired[i];
+            retired[i] = retired.back();
+            retired.pop_back();
+        } else {
+            i++;
+        }
+    }
+}
+
+static void CompletePoolTask(napi_env env, napi_value js_callback, void* context, void* data) {
+    PoolTask* task = static_cast<PoolTask*>(data);
+    EnvData* env_state = static_cast<EnvData*>(context);
+    if (env != nullptr) {
+        task->complete(env, task->status, task->data);
+        if (--env_state->pool_pending == 0) {
+            napi_unref_threadsafe_function(env, env_state->pool_tsfn);
+        }
+        if (!env_state->retired_pools.empty()) {
+            reap_retired_pools(env_state);
+        }
+    }
+    delete task;
+}
+
+/* hand a done (or dropped) task to the js thread of its env */
+void finish_pool_task(PoolTask* task) {
+    if (napi_call_threadsafe_function(task->tsfn, task, napi_tsfn_nonblocking) != napi_ok) {
+        /* the env is going away, the complete callback can't run anymore */
+        delete task;
+    }
+}
+
+static bool submit_pool_task(napi_env env, EnvData* env_state, PoolTask* task) {
+    if (env_state->pool_tsfn == nullptr) {
+        napi_value resource_name;
+        napi_create_string_utf8(env, "JqWorkerPool", NAPI_AUTO_LENGTH, &resource_name);
+        if (napi_create_threadsafe_function(env, nullptr, nullptr, resource_name, 0, 1, nullptr, nullptr, env_state,
+                                            CompletePoolTask, &env_state->pool_tsfn) != napi_ok) {
+            env_state->pool_tsfn = nullptr;
+            return false;
+        }
+        napi_unref_threadsafe_function(env, env_state->pool_tsfn);
+    }
+    if (env_state->pool_pending++ == 0) {
+        napi_ref_threadsafe_function(env, env_state->pool_tsfn);
+    }
+    task->tsfn = env_state->pool_tsfn;
+    PoolTask* dropped = env_state->worker_pool->submit(task);
+    if (dropped != nullptr) {
+        dropped->status = napi_queue_full;
+        finish_pool_task(dropped);
+    }
+    return true;
+}
+
+/* stop the workers of an env that is going away, the tasks still queued can't complete */
+void stop_worker_pool(EnvData* env_state) {
+    if (env_state->worker_pool != nullptr) {
+        global_worker_threads.fetch_sub(env_state->worker_pool->threads());
+        env_state->retired_pools.push_back(env_state->worker_pool);
+        env_state->worker_pool = nullptr;
+    }
+    /* their running tasks complete through the tsfn, so they are waited for before it goes */
+    for (WorkerPool* retired : env_state->retired_pools) {
+        retired->discard_queued();
+        delete retired;
+    }
+    env_state->retired_pools.clear();
+    if (env_state->pool_tsfn != nullptr) {
+        napi_release_threadsafe_function(env_state->pool_tsfn, napi_tsfn_abort);
+        env_state->pool_tsfn = nullptr;
+    }
+}
+
+/* create and queue an async work named name, on the dedicated pool if there is one (async_work is then
+   null) or on the libuv thread pool */
+void queue_async_work(napi_env env, const char* name, napi_async_execute_callback execute,
+                             napi_async_complete_callback complete, void* data, napi_async_work* async_work,
+                             WorkPriority priority) {
+    async_in_flight.fetch_add(1, std::memory_order_relaxed);
+    *async_work = nullptr;
+    EnvData* env_state = env_data(env);
+    if (env_state->worker_pool != nullptr) {
+        PoolTask* task = new PoolTask();
+        task->execute = execute;
+        task->complete = complete;
+        task->data = data;
+        task->priority = priority;
+        if (submit_pool_task(env, env_state, task)) {
+            return;
+        }
+        delete task;
+    }
+    napi_value resource_name;
+    napi_create_string_utf8(env, name, NAPI_AUTO_LENGTH, &resource_name);
+    napi_create_async_work(env, nullptr, resource_name, execute, complete, data, async_work);
+    napi_queue_async_work(env, *async_work);
+}
+
+/* delete a work queued by queue_async_work, from its complete callback */
+void delete_async_work(napi_env env, napi_async_work async_work) {
+    async_in_flight.fetch_sub(1, std::memory_order_relaxed);
+    if (async_work != nullptr) {
+        napi_delete_async_work(env, async_work);
+    }
+}
@@ -0,0 +1,262 @@
+#ifndef SRC_WORKER_POOL_H_
+#define SRC_WORKER_POOL_H_
+
+#include "src/binding.h"
+#include "src/stats.h"
+
+/* an async work run by the dedicated worker pool. its complete callback runs on the js thread through
+   the pool's threadsafe function, with napi_ok if it ran, napi_queue_full if the queue rejected or shed
+   it and napi_cancelled if it waited longer than allowed */
+struct PoolTask {
+    napi_async_execute_callback execute;
+    napi_async_complete_callback complete;
+    void* data;
+    WorkPriority priority;
+    uint64_t queued_ns;
+    napi_status status;
+    /* threadsafe function of the env that queued it */
+    napi_threadsafe_function tsfn;
+};
+
+const char* async_status_message(napi_status status);
+
+void finish_pool_task(PoolTask* task);
+
+#ifndef CPU_SETSIZE
+#define CPU_SETSIZE 1024
+#endif
+
+/* threads owned by the addon for async calls, so jq work doesn't compete with fs/dns/crypto on the
+   libuv pool. every worker has a deque per priority, calls are spread over them round robin and an
+   idle worker steals from the others. a worker takes the highest priority task it finds, its own first.
+   admission: past max_queue tasks a call is rejected, or with shed the oldest queued task of the lowest
+   priority not above the new one is dropped for it. a task that waited longer than max_wait_ns is
+   dropped instead of run */
+class WorkerPool {
+private:
+    struct alignas(64) Worker {
+        WorkerPool* pool;
+        size_t index;
+        pthread_t thread;
+        pthread_mutex_t mutex;
+        std::deque<PoolTask*> tasks[PRIORITY_LEVELS];
+    };
+    std::vector<Worker*> workers;
+    std::vector<int> affinity;
+    size_t max_queue;
+    uint64_t max_wait_ns;
+    bool shed;
+    /* sleeping workers wait on idle_cond for queued to become non zero */
+    pthread_mutex_t idle_mutex;
+    pthread_cond_t idle_cond;
+    std::atomic<size_t> queued;
+    std::atomic<bool> stopping;
+    std::atomic<bool> drain;
+    /* workers that haven't exited yet */
+    std::atomic<size_t> running;
+    /* next worker to queue to, only touched on the js thread */
+    size_t next;
+
+    static void* worker_main(void* arg) {
+        Worker* worker = static_cast<Worker*>(arg);
+        worker->pool->run(worker);
+        worker->pool->running.fetch_sub(1);
+        return nullptr;
+    }
+
+    /* pop the front of worker's deque of priority, own tasks are taken oldest first, stolen ones too */
+    PoolTask* pop(Worker* worker, int priority) {
+        PoolTask* task = nullptr;
+        pthread_mutex_lock(&worker->mutex);
+        if (!worker->tasks[priority].empty()) {
+            task = worker->tasks[priority].front();
+            worker->tasks[priority].pop_front();
+        }
+        pthread_mutex_unlock(&worker->mutex);
+        return task;
+    }
+
+    PoolTask* next_task(Worker* self) {
+        for (int priority = 0; priority < PRIORITY_LEVELS; priority++) {
+            PoolTask* task = pop(self, priority);
+            for (size_t i = 1; task == nullptr && i < workers.size(); i++) {
+                task = pop(workers[(self->index + i) % workers.size()], priority);
+            }
+            if (task != nullptr) {
+                queued.fetch_sub(1, std::memory_order_relaxed);
+                return task;
+            }
+        }
+        return nullptr;
+    }
+
+    void run(Worker* self) {
+        for (;;) {
+            if (stopping.load() && !drain.load()) {
+                return;
+            }
+            PoolTask* task = next_task(self);
+            if (task == nullptr) {
+                pthread_mutex_lock(&idle_mutex);
+                while (queued.load() == 0 && !stopping.load()) {
+                    pthread_cond_wait(&idle_cond, &idle_mutex);
+                }
+                bool stop = stopping.load() && (queued.load() == 0 || !drain);
+                pthread_mutex_unlock(&idle_mutex);
+                if (stop) {
+                    return;
+                }
+                continue;
+            }
+            if (max_wait_ns > 0 && stats_now() - task->queued_ns > max_wait_ns) {
+                task->status = napi_cancelled;
+                shed_wait.fetch_add(1, std::memory_order_relaxed);
+            } else {
+                task->execute(nullptr, task->data);
+                task->status = napi_ok;
+            }
+            finish_pool_task(task);
+        }
+    }
+
+    /* drop the oldest queued task of the lowest priority, as long as it isn't above priority */
+    PoolTask* shed_task(WorkPriority priority) {
+        for (int level = PRIORITY_LEVELS - 1; level >= (int)priority; level--) {
+            /* tasks only leave the deques meanwhile, so retry if the chosen one was taken */
+            for (;;) {
+                Worker* oldest = nullptr;
+                uint64_t oldest_ns = UINT64_MAX;
+                for (Worker* worker : workers) {
+                    pthread_mutex_lock(&worker->mutex);
+                    if (!worker->tasks[level].empty() && worker->tasks[level].front()->queued_ns < oldest_ns) {
+                        oldest = worker;
+                        oldest_ns = worker->tasks[level].front()->queued_ns;
+                    }
+                    pthread_mutex_unlock(&worker->mutex);
+                }
+                if (oldest == nullptr) {
+                    break;
+                }
+                PoolTask* task = nullptr;
+                pthread_mutex_lock(&oldest->mutex);
+                if (!oldest->tasks[level].empty() && oldest->tasks[level].front()->queued_ns == oldest_ns) {
+                    task = oldest->tasks[level].front();
+                    oldest->tasks[level].pop_front();
+                }
+                pthread_mutex_unlock(&oldest->mutex);
+                if (task != nullptr) {
+                    queued.fetch_sub(1, std::memory_order_relaxed);
+                    return task;
+                }
+            }
+        }
+        return nullptr;
+    }
+
+public:
+    std::atomic<uint64_t> rejected;
+    std::atomic<uint64_t> shed_depth;
+    std::atomic<uint64_t> shed_wait;
+
+    WorkerPool(size_t threads, const std::vector<int>& affinity_, size_t max_queue_, uint64_t max_wait_ns_, bool shed_) :
+        affinity(affinity_), max_queue(max_queue_), max_wait_ns(max_wait_ns_), shed(shed_), queued(0), stopping(false),
+        drain(true), running(threads), next(0), rejected(0), shed_depth(0), shed_wait(0) {
+        pthread_mutex_init(&idle_mutex, nullptr);
+        pthread_cond_init(&idle_cond, nullptr);
+        for (size_t i = 0; i < threads; i++) {
+            Worker* worker = new Worker();
+            worker->pool = this;
+            worker->index = i;
+            pthread_mutex_init(&worker->mutex, nullptr);
+            workers.push_back(worker);
+        }
+        for (Worker* worker : workers) {
+            pthread_create(&worker->thread, nullptr, worker_main, worker);
+#ifdef __linux__
+            if (!affinity.empty()) {
+                cpu_set_t cpus;
+                CPU_ZERO(&cpus);
+                CPU_SET(affinity[worker->index % affinity.size()], &cpus);
+                pthread_setaffinity_np(worker->thread, sizeof(cpus), &cpus);
+            }
+#endif
+        }
+    }
+
+    /* stop the workers and wait for them, running what is queued first if drain */
+    ~WorkerPool() {
+        stop();
+        for (Worker* worker : workers) {
+            pthread_join(worker->thread, nullptr);
+        }
+        for (Worker* worker : workers) {
+            for (std::deque<PoolTask*>& tasks : worker->tasks) {
+                for (PoolTask* task : tasks) {
+                    delete task;
+                }
+            }
+            pthread_mutex_destroy(&worker->mutex);
+            delete worker;
+        }
+        pthread_cond_destroy(&idle_cond);
+        pthread_mutex_destroy(&idle_mutex);
+    }
+
+    /* make the destructor drop queued tasks instead of running them, they can't complete anymore */
+    void discard_queued() {
+        drain = false;
+    }
+
+    /* take no more tasks, the workers exit once the queued ones are run (if drain) without being waited for */
+    void stop() {
+        pthread_mutex_lock(&idle_mutex);
+        stopping = true;
+        pthread_cond_broadcast(&idle_cond);
+        pthread_mutex_unlock(&idle_mutex);
+    }
+
+    /* every worker exited after stop, deleting the pool won't block */
+    bool stopped() {
+        return running.load() == 0;
+    }
+
+    size_t threads() {
+        return workers.size();
+    }
+    size_t depth() {
+        return queued.load(std::memory_order_relaxed);
+    }
+
+    /* queue task, on the js thread. a task it rejects or sheds is returned to be failed, otherwise null */
+    PoolTask* submit(PoolTask* task) {
+        task->queued_ns = stats_now();
+        PoolTask* dropped = nullptr;
+        if (max_queue > 0 && queued.load(std::memory_order_relaxed) >= max_queue) {
+            dropped = shed ? shed_task(task->priority) : nullptr;
+            if (dropped == nullptr) {
+                rejected.fetch_add(1, std::memory_order_relaxed);
+                return task;
+            }
+            shed_depth.fetch_add(1, std::memory_order_relaxed);
+        }
+        /* counted first, so a worker popping it never sees the count drop below zero */
+        queued.fetch_add(1);
+        Worker* worker = workers[next++ % workers.size()];
+        pthread_mutex_lock(&worker->mutex);
+        worker->tasks[task->priority].push_back(task);
+        pthread_mutex_unlock(&worker->mutex);
+        pthread_mutex_lock(&idle_mutex);
+        pthread_cond_signal(&idle_cond);
+        pthread_mutex_unlock(&idle_mutex);
+        return dropped;
+    }
+};
+
+void reap_retired_pools(EnvData* env_state);
+void stop_worker_pool(EnvData* env_state);
+void queue_async_work(napi_env env, const char* name, napi_async_execute_callback execute,
+                             napi_async_complete_callback complete, void* data, napi_async_work* async_work,
+                             WorkPriority priority);
+void delete_async_work(napi_env env, napi_async_work async_work);
+
+#endif
@@ -0,0 +1,46 @@
+const jq = require('../lib');
+
+describe('jq - batch', () => {
+    const filter = '.items | map(.value) | add';
+    const inputs = Array.from({ length: 100 }, (_, i) => ({ items: [{ value: i }, { value: 1 }] }));
+    const expected = inputs.map((_, i) => ({ value: i + 1 }));
+
+    it('should run one filter on every input', async () => {
+        expect(jq.execBatch(inputs, filter)).toEqual(expected);
+        expect(await jq.execBatchAsync(inputs, filter)).toEqual(expected);
+    });
+
+    it('should keep the order of the inputs', async () => {
+        for (const count of [0, 1, 15, 16, 17, 63, 1000]) {
+            const items = Array.from({ length: count }, (_, i) => ({ i }));
+            const results = await jq.execBatchAsync(items, '.i * 2');
+
+            expect(results).toEqual(items.map(({ i }) => ({ value: i * 2 })));
+        }
+    });
+
+    it('should report errors per input', async () => {
+        const mixed = [{ a: 1 }, { a: 'x' }, { a: 2 }, { a: 2n }];
+        const results = [
+            { value: 2 },
+            { error: 'jq: error: string ("x") and number (1) cannot be added' },
+            { value: 3 },
+            { error: 'Do not know how to serialize a BigInt' },
+        ];
+
+        expect(jq.execBatch(mixed, '.a + 1')).toEqual(results);
+        expect(await jq.execBatchAsync(mixed, '.a + 1')).toEqual(results);
+    });
+
+    it('should return undefined values for empty results', async () => {
+        expect(jq.execBatch([{}], 'empty')).toEqual([{}]);
+        expect(await jq.execBatchAsync([{}], 'empty')).toEqual([{}]);
+    });
+
+    it('should handle filters that do not compile', async () => {
+        expect(jq.execBatch([{}, {}], '.foo | bar')[1].error).toMatch(/^jq: compile error/);
+        expect((await jq.execBatchAsync([{}, {}], '.foo | bar'))[1].error).toMatch(/^jq: compile error/);
+        expect(() => jq.execBatch([{}], '.foo | bar', { throwOnError: true })).toThrow(jq.JqExecCompileError);
+        await expect(jq.execBatchAsync([{}], '.foo | bar', { throwOnError: true })).rejects.toThrow(jq.JqExecCompileError);
+    });
+});
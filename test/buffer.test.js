@@ -0,0 +1,51 @@
+const jq = require('../lib');
+
+describe('jq - buffer input', () => {
+    const json = { foo: 'bar', items: [1, 2, 3], nested: { ok: true } };
+
+    it('should parse JSON in a Buffer or Uint8Array', async () => {
+        const buffer = Buffer.from(JSON.stringify(json));
+        const bytes = new TextEncoder().encode(JSON.stringify(json));
+
+        for (const input of [buffer, bytes]) {
+            expect(jq.exec(input, '.foo')).toBe('bar');
+            expect(await jq.execAsync(input, '.items | add')).toBe(6);
+            expect(jq.execAll(input, '.items[]')).toEqual([1, 2, 3]);
+            expect(await jq.execAllAsync(input, '.nested')).toEqual([{ ok: true }]);
+            expect(jq.document(input).exec('.nested.ok')).toBe(true);
+            expect(jq.compile('.foo').exec(input)).toBe('bar');
+            expect(await jq.compile('.foo').execAsync(input)).toBe('bar');
+        }
+    });
+
+    it('should parse a slice of a larger buffer', async () => {
+        const pool = Buffer.from(`xxxx${JSON.stringify(json)}yyyy`);
+        const slice = pool.subarray(4, pool.length - 4);
+
+        expect(jq.exec(slice, '.foo')).toBe('bar');
+        expect(await jq.execAsync(slice, '.foo')).toBe('bar');
+    });
+
+    it('should accept buffers in batches and templates', async () => {
+        const inputs = [Buffer.from('{"a":1}'), { a: 2 }, Buffer.from('{"a":')];
+        const results = [{ value: 1 }, { value: 2 }, { error: 'Invalid JSON input' }];
+
+        expect(jq.execBatch(inputs, '.a')).toEqual(results);
+        expect(await jq.execBatchAsync(inputs, '.a')).toEqual(results);
+        expect(jq.renderRecursively(Buffer.from('{"a":1}'), { a: '{{.a}}' })).toEqual({ a: 1 });
+        expect(await jq.renderRecursivelyAsync(Buffer.from('{"a":1}'), { a: 'a={{.a}}' })).toEqual({ a: 'a=1' });
+    });
+
+    it('should keep the buffer alive while async work is pending', async () => {
+        const pending = Array.from({ length: 50 }, (_, i) => jq.execAsync(Buffer.from(JSON.stringify({ i })), '.i'));
+        if (global.gc) global.gc();
+
+        expect(await Promise.all(pending)).toEqual(Array.from({ length: 50 }, (_, i) => i));
+    });
+
+    it('should fail on invalid JSON', async () => {
+        expect(jq.exec(Buffer.from('{"a":'), '.a')).toBe(null);
+        expect(() => jq.exec(Buffer.from('nope'), '.a', { throwOnError: true })).toThrow('Invalid JSON input');
+        await expect(jq.execAsync(Buffer.from(''), '.', { throwOnError: true })).rejects.toThrow(jq.JqExecError);
+    });
+});
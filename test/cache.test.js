@@ -0,0 +1,103 @@
+const jq = require('../lib');
+
+describe('jq - filter cache', () => {
+    it('should count hits and misses', () => {
+        const before = jq.getCacheStats();
+        const filter = `.a + ${Math.random()}`;
+
+        jq.exec({ a: 1 }, filter);
+        jq.exec({ a: 2 }, filter);
+        const after = jq.getCacheStats();
+
+        expect(after.misses).toBeGreaterThan(before.misses);
+        expect(after.hits).toBeGreaterThan(before.hits);
+        expect(after.shards.reduce((sum, shard) => sum + shard.hits, 0)).toBe(after.hits);
+        expect(after.shards.reduce((sum, shard) => sum + shard.entries, 0)).toBe(after.entries);
+    });
+
+    it('should evict down to the cache size', async () => {
+        const previous = jq.getCacheStats().cacheSize;
+        jq.setCacheSize(32);
+        try {
+            const before = jq.getCacheStats().evictions;
+            // Busy filters are skipped by eviction, the sync runs after clean them up
+            const results = await Promise.all(Array.from({ length: 100 }, (_, i) => jq.execAsync({ i }, `.i + ${i}`)));
+            expect(results).toEqual(Array.from({ length: 100 }, (_, i) => 2 * i));
+            for (let i = 0; i < 300; i++) {
+                expect(jq.exec({ i }, `.i * ${i}`)).toBe(i * i);
+            }
+
+            const stats = jq.getCacheStats();
+            expect(stats.cacheSize).toBe(32);
+            expect(stats.entries).toBeLessThanOrEqual(32);
+            expect(stats.evictions - before).toBeGreaterThanOrEqual(300);
+        } finally {
+            jq.setCacheSize(previous);
+        }
+    });
+
+    it('should hold as many filters as the cache size', () => {
+        const previous = jq.getCacheStats().cacheSize;
+        try {
+            for (const count of [8, 100]) {
+                // Room for exactly the filters cached already and count new ones
+                const { entries } = jq.getCacheStats();
+                jq.setCacheSize(entries + count);
+                const filters = Array.from({ length: count }, (_, i) => `.f${count}_${i}_${Math.random().toString().slice(2, 8)}`);
+                for (const filter of filters) {
+                    jq.exec({}, filter);
+                }
+                const before = jq.getCacheStats();
+                for (const filter of filters) {
+                    jq.exec({}, filter);
+                }
+
+                const after = jq.getCacheStats();
+                expect(after.entries).toBe(entries + count);
+                expect(after.misses).toBe(before.misses);
+                expect(after.evictions).toBe(before.evictions);
+            }
+        } finally {
+            jq.setCacheSize(previous);
+        }
+    });
+
+    it('should keep often used filters through a burst of one-off filters', () => {
+        const previous = jq.getCacheStats().cacheSize;
+        jq.setCacheSize(32);
+        try {
+            // Slow to compile, so it also outranks filters left hot by other tests
+            const hot = `{${Array.from({ length: 1000 }, (_, i) => `k${i}: (.a + ${i})`).join(', ')}}`;
+            for (let i = 0; i < 20; i++) {
+                jq.exec({ a: i }, hot);
+            }
+            for (let i = 0; i < 100; i++) {
+                jq.exec({ a: i }, `.a - ${i}`);
+            }
+
+            const { misses } = jq.getCacheStats();
+            expect(jq.exec({ a: 1 }, hot).k99).toBe(100);
+            expect(jq.getCacheStats().misses).toBe(misses);
+        } finally {
+            jq.setCacheSize(previous);
+        }
+    });
+
+    it('should evict down to the byte budget', () => {
+        const maxBytes = 2 * 1024 * 1024;
+
+        expect(jq.setCacheMaxBytes(maxBytes)).toBe(maxBytes);
+        try {
+            for (let i = 0; i < 200; i++) {
+                expect(jq.exec({ a: i }, `[.a, "${'x'.repeat(i * 10)}"] | .[0]`)).toBe(i);
+            }
+            const stats = jq.getCacheStats();
+            expect(stats.maxBytes).toBe(maxBytes);
+            expect(stats.bytes).toBeGreaterThan(0);
+            expect(stats.bytes).toBeLessThanOrEqual(maxBytes);
+        } finally {
+            jq.setCacheMaxBytes(0);
+        }
+        expect(() => jq.setCacheMaxBytes(-1)).toThrow('must not be negative');
+    });
+})
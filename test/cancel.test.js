@@ -0,0 +1,83 @@
+const jq = require('../lib');
+
+// Runs until it is stopped, with an output now and then for the worker to check for aborts
+const endless = 'range(.n) | select(. % 100000 == 0)';
+const last = 'last(range(.n))';
+const forever = { n: 1e15 };
+const sleep = (ms) => new Promise((resolve) => setTimeout(resolve, ms));
+
+describe('jq - cancellation', () => {
+    it('should stop a running filter when its signal aborts', async () => {
+        const controller = new AbortController();
+        const pending = jq.execAllAsync(forever, endless, { signal: controller.signal, throwOnError: true });
+        await sleep(20);
+        const start = Date.now();
+        controller.abort();
+
+        await expect(pending).rejects.toThrow('jq: error: aborted');
+        expect(Date.now() - start).toBeLessThan(1000);
+        expect(await jq.execAsync(forever, endless, { signal: controller.signal })).toBeNull();
+    });
+
+    it('should stop a filter past its deadline', async () => {
+        await expect(jq.execAllAsync(forever, endless, { timeoutMs: 30, throwOnError: true })).rejects.toThrow('jq: error: timeout');
+        await expect(jq.execAllAsync(forever, `1, ${endless}`, { timeoutMs: 30, throwOnError: true })).rejects.toThrow('jq: error: timeout');
+        expect(await jq.execAsync({ n: 10 }, last, { timeoutMs: 1000 })).toBe(9);
+        await expect(jq.execAsync({}, '.', { timeoutMs: -1, throwOnError: true })).rejects.toThrow('Invalid timeoutMs option');
+    });
+
+    it('should drop queued calls without running them', async () => {
+        jq.setWorkerPool({ threads: 1 });
+        try {
+            const blocker = new AbortController();
+            const queued = new AbortController();
+            const executed = jq.getStats().latency.execute.count;
+            const running = jq.execAllAsync(forever, endless, { signal: blocker.signal, throwOnError: true });
+            const dropped = jq.execAsync({ a: 1 }, '.a', { signal: queued.signal, throwOnError: true });
+            queued.abort();
+            await sleep(5);
+            blocker.abort();
+
+            const results = await Promise.allSettled([running, dropped]);
+            expect(results.map((result) => result.reason.message)).toEqual(['jq: error: aborted', 'jq: error: aborted']);
+            expect(jq.getStats().latency.execute.count - executed).toBe(1);
+        } finally {
+            jq.setWorkerPool(null);
+        }
+    });
+
+    it('should hand the state back for the next call', async () => {
+        const previous = jq.getCacheStats().poolSize;
+        jq.setPoolSize(1);
+        try {
+            for (let i = 0; i < 3; i++) {
+                await expect(jq.execAllAsync(forever, endless, { timeoutMs: 10, throwOnError: true })).rejects.toThrow('timeout');
+                expect(await jq.execAsync({ n: 5 }, last)).toBe(4);
+            }
+        } finally {
+            jq.setPoolSize(previous);
+        }
+    });
+
+    it('should cancel every async api', async () => {
+        const controller = new AbortController();
+        controller.abort();
+        const { signal } = controller;
+
+        await expect(jq.execAllAsync({}, '1, 2', { signal, throwOnError: true })).rejects.toThrow('jq: error: aborted');
+        await expect(jq.execBatchAsync([{}, {}], '.', { signal, throwOnError: true })).rejects.toThrow('jq: error: aborted');
+        expect(await jq.execBatchAsync([{}], '.', { signal })).toEqual([{ error: 'jq: error: aborted' }]);
+        expect(await jq.document({ a: 1 }).execManyAsync(['.a'], { signal }).catch((err) => err.message)).toBe('jq: error: aborted');
+        await expect(jq.document({ a: 1 }).execAsync('.a', { signal, throwOnError: true })).rejects.toThrow('jq: error: aborted');
+        await expect(jq.compile('.a', { throwOnError: true }).execAsync({ a: 1 }, { signal })).rejects.toThrow('jq: error: aborted');
+        await expect(jq.renderRecursivelyAsync({ a: 1 }, { a: '{{.a}}' }, { signal, throwOnError: true })).rejects.toThrow('jq: error: aborted');
+        await expect(jq.compileTemplate({ a: '{{.a}}' }, { throwOnError: true }).renderAsync({ a: 1 }, { signal })).rejects.toThrow('jq: error: aborted');
+    });
+
+    it('should not touch calls without a signal or deadline', async () => {
+        const controller = new AbortController();
+        expect(await jq.execAsync({ a: 1 }, '.a', { signal: controller.signal })).toBe(1);
+        controller.abort();
+        expect(await jq.execAsync({ a: 2 }, '.a')).toBe(2);
+    });
+});
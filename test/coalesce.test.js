@@ -0,0 +1,88 @@
+const jq = require('../lib');
+
+const coalesced = () => jq.getStats().asyncCoalesced;
+const executed = () => jq.getStats().latency.execute.count;
+const input = { items: [{ name: 'a', tier: 1 }, { name: 'b', tier: 5 }, { name: 'c', tier: 2 }] };
+const filter = '{names: [.items[] | select(.tier < 3) | .name]}';
+
+// Runs fn with coalescing turned on, it is off by default
+const withCoalescing = async (fn) => {
+    const previous = jq.setAsyncCoalescing(true);
+    try {
+        await fn();
+    } finally {
+        jq.setAsyncCoalescing(previous);
+    }
+};
+
+describe('jq - coalesced async calls', () => {
+    it('should run identical calls in flight once', async () => {
+        await withCoalescing(async () => {
+            const json = Buffer.from(JSON.stringify(input));
+            const before = [coalesced(), executed()];
+            const results = await Promise.all([
+                ...Array.from({ length: 10 }, () => jq.execAsync(input, filter)),
+                ...Array.from({ length: 10 }, () => jq.execAsync(json, filter)),
+            ]);
+
+            expect(results.every((result) => JSON.stringify(result) === '{"names":["a","c"]}')).toBe(true);
+            expect(coalesced() - before[0]).toBe(18);
+            expect(executed() - before[1]).toBe(2);
+            // Every caller gets a result of its own
+            results[0].names.push('d');
+            expect(results[1]).toEqual({ names: ['a', 'c'] });
+        });
+    });
+
+    it('should share errors and missing outputs', async () => {
+        await withCoalescing(async () => {
+            const before = coalesced();
+            const errors = await Promise.allSettled(Array.from({ length: 3 }, () => jq.execAsync(input, '.items | error("boom")', { throwOnError: true })));
+            const empty = await Promise.all(Array.from({ length: 3 }, () => jq.execAsync(input, '.items[] | select(.tier > 9)')));
+
+            expect(errors.map((result) => result.reason.message)).toEqual(Array(3).fill('jq: error: boom'));
+            expect(empty).toEqual([null, null, null]);
+            expect(coalesced() - before).toBe(4);
+        });
+    });
+
+    it('should run calls that differ or can be cancelled on their own', async () => {
+        await withCoalescing(async () => {
+            const before = coalesced();
+            const results = await Promise.all([
+                jq.execAsync(input, filter),
+                jq.execAsync({ ...input, items: input.items.slice(1) }, filter),
+                jq.execAsync(input, filter, { output: 'json' }),
+                jq.execAsync(input, filter, { priority: 'low' }),
+                jq.execAsync(input, filter, { timeoutMs: 1000 }),
+                jq.execAsync(input, filter, { signal: new AbortController().signal }),
+                jq.execAsync(input, `${filter} | .at = (now | type)`),
+                jq.execAsync(input, `${filter} | .at = (now | type)`),
+                jq.execAsync(input, filter, { enableEnv: true }),
+            ]);
+
+            expect(results[1]).toEqual({ names: ['c'] });
+            expect(results[2]).toBe('{"names":["a","c"]}');
+            expect(results[7]).toEqual({ names: ['a', 'c'], at: 'number' });
+            expect(coalesced()).toBe(before);
+            // Done by now, the next call runs again
+            expect(await jq.execAsync(input, filter)).toEqual({ names: ['a', 'c'] });
+            expect(coalesced()).toBe(before);
+        });
+    });
+
+    it('should queue every call unless turned on', async () => {
+        const before = coalesced();
+        await Promise.all([jq.execAsync(input, filter), jq.execAsync(input, filter)]);
+        expect(coalesced()).toBe(before);
+
+        expect(jq.setAsyncCoalescing(true)).toBe(false);
+        try {
+            await Promise.all([jq.execAsync(input, filter), jq.execAsync(input, filter)]);
+            expect(coalesced()).toBe(before + 1);
+        } finally {
+            expect(jq.setAsyncCoalescing(false)).toBe(true);
+        }
+        expect(() => jq.setAsyncCoalescing('yes')).toThrow('Async coalescing flag must be a boolean');
+    });
+});
@@ -0,0 +1,52 @@
+const jq = require('../lib');
+
+describe('jq - compiled filter', () => {
+    it('should exec like exec', async () => {
+        const filter = '.items | map(.value * 2) | add';
+        const compiled = jq.compile(filter);
+        const inputs = [{ items: [{ value: 1 }, { value: 2 }] }, { items: [] }, { foo: 'bar' }];
+
+        for (const input of inputs) {
+            expect(compiled.exec(input)).toEqual(jq.exec(input, filter));
+            expect(await compiled.execAsync(input)).toEqual(await jq.execAsync(input, filter));
+        }
+    });
+
+    it('should not use the filter cache', () => {
+        const before = jq.getCacheStats().entries;
+        const compiled = jq.compile('.foo | ascii_upcase | . + "-compiled-only"');
+
+        expect(compiled.exec({ foo: 'bar' })).toBe('BAR-compiled-only');
+        expect(jq.getCacheStats().entries).toBe(before);
+    });
+
+    it('should format the filter once', () => {
+        expect(jq.compile("'foo'").exec({})).toBe('foo');
+        expect(jq.compile('env | length').exec({})).toBe(0);
+        expect(jq.compile('env | length', { enableEnv: true }).exec({})).toBeGreaterThan(0);
+    });
+
+    it('should return undefined for empty results', () => {
+        expect(jq.compile('empty').exec({})).toBe(undefined);
+    });
+
+    it('should run concurrently', async () => {
+        const compiled = jq.compile('.i + 1');
+        const results = await Promise.all(Array.from({ length: 32 }, (_, i) => compiled.execAsync({ i })));
+
+        expect(results).toEqual(Array.from({ length: 32 }, (_, i) => i + 1));
+    });
+
+    it('should handle errors like exec', async () => {
+        const broken = jq.compile('.foo | bar');
+        const throwing = jq.compile('.foo | bar', { throwOnError: true });
+        const failing = jq.compile('error("boom")', { throwOnError: true });
+
+        expect(broken.exec({})).toBe(null);
+        expect(await broken.execAsync({})).toBe(null);
+        expect(() => throwing.exec({})).toThrow(jq.JqExecCompileError);
+        await expect(throwing.execAsync({})).rejects.toThrow(jq.JqExecCompileError);
+        expect(() => failing.exec({})).toThrow('jq: error: boom');
+        await expect(failing.execAsync({})).rejects.toThrow(jq.JqExecError);
+    });
+});
@@ -0,0 +1,64 @@
+const jq = require('../lib');
+
+const template = {
+    name: '{{.name}}',
+    greeting: 'hello {{.name}}, you are {{.age}}',
+    '{{.keyName}}': '{{.name}}',
+    '{{.missing}}': '{{error("never evaluated")}}',
+    '{{ spreadValue() }}': '{{.extra}}',
+    nested: [{ tags: '{{.tags}}', first: '{{.tags[0]}}' }, 'plain', 3],
+};
+
+describe('compiled template', () => {
+    const inputs = [
+        { name: 'foo', age: 1, keyName: 'k', tags: ['a', 'b'], extra: { x: 1 } },
+        { name: 'bar', age: 2.5, keyName: null, tags: [], extra: {} },
+        { name: null, keyName: 'other', extra: { name: 'overridden' } },
+    ];
+
+    it('should render like renderRecursively', async () => {
+        const compiled = jq.compileTemplate(template);
+        for (const input of inputs) {
+            const expected = jq.renderRecursively(input, template);
+
+            expect(compiled.render(input)).toEqual(expected);
+            expect(await compiled.renderAsync(input)).toEqual(expected);
+            expect(await jq.renderRecursivelyAsync(input, template)).toEqual(expected);
+        }
+    });
+
+    it('should render plain values', async () => {
+        expect(jq.compileTemplate('no braces').render({})).toBe('no braces');
+        expect(jq.compileTemplate(3).render({})).toBe(3);
+        expect(await jq.compileTemplate(null).renderAsync({})).toBe(null);
+    });
+
+    it('should evaluate repeated expressions once per render', () => {
+        const compiled = jq.compileTemplate(['{{.a}}', '{{.a}}', 'x{{.a}}']);
+
+        expect(compiled.render({ a: 1 })).toEqual([1, 1, 'x1']);
+    });
+
+    it('should report errors when rendering', async () => {
+        const compiled = jq.compileTemplate({ broken: '{{1/0 | foo}}' });
+        const throwing = jq.compileTemplate({ broken: '{{1/0 | foo}}' }, { throwOnError: true });
+        const unbalanced = jq.compileTemplate({ broken: '{{.foo' });
+
+        expect(compiled.render({})).toEqual({ broken: null });
+        expect(() => throwing.render({})).toThrow(jq.JqExecCompileError);
+        await expect(throwing.renderAsync({})).rejects.toThrow(jq.JqExecCompileError);
+        expect(() => unbalanced.render({})).toThrow('Found opening double braces in index 0 without closing double braces');
+    });
+
+    it('should only throw for the parts that are rendered', () => {
+        const compiled = jq.compileTemplate({ '{{.key}}': '{{error("boom")}}' }, { throwOnError: true });
+
+        expect(compiled.render({ key: null })).toEqual({});
+        expect(() => compiled.render({ key: 'k' })).toThrow(jq.JqExecError);
+    });
+
+    it('should keep env disabled by default', () => {
+        expect(jq.compileTemplate('{{env | length}}').render({})).toBe(0);
+        expect(jq.compileTemplate('{{env | length}}', { enableEnv: true }).render({})).toBeGreaterThan(0);
+    });
+});
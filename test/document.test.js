@@ -0,0 +1,53 @@
+const jq = require('../lib');
+
+describe('jq - document', () => {
+    const input = {
+        items: Array.from({ length: 50 }, (_, i) => ({ id: `item-${i}`, value: i, tags: ['a', 'b'] })),
+        owner: { name: 'team-a' },
+    };
+
+    it('should exec like exec', async () => {
+        const doc = jq.document(input);
+        const filters = ['.owner', '.items | length', '.items[3]', '[.items[].value] | add', '.missing', 'empty'];
+
+        for (const filter of filters) {
+            expect(doc.exec(filter)).toEqual(jq.exec(input, filter));
+            expect(await doc.execAsync(filter)).toEqual(await jq.execAsync(input, filter));
+        }
+    });
+
+    it('should run many filters', async () => {
+        const doc = jq.document(input);
+        const expected = [{ value: 'team-a' }, { value: 50 }, {}];
+
+        expect(doc.execMany(['.owner.name', '.items | length', 'empty'])).toEqual(expected);
+        expect(await doc.execManyAsync(['.owner.name', '.items | length', 'empty'])).toEqual(expected);
+    });
+
+    it('should not be changed by the filters', async () => {
+        const doc = jq.document(input);
+
+        expect(doc.exec('.owner.name = "changed" | .owner')).toEqual({ name: 'changed' });
+        expect(await doc.execAsync('.items |= map(.value += 1) | .items[0]')).toEqual({ id: 'item-0', value: 1, tags: ['a', 'b'] });
+        expect(doc.exec('.owner.name')).toBe('team-a');
+        expect(await doc.execAsync('.items[0].value')).toBe(0);
+    });
+
+    it('should run concurrently', async () => {
+        const doc = jq.document(input);
+        const runs = Array.from({ length: 64 }, (_, i) => doc.execAsync(`.items[${i % 50}]`));
+        doc.exec('.items[0]');
+
+        expect(await Promise.all(runs)).toEqual(Array.from({ length: 64 }, (_, i) => input.items[i % 50]));
+    });
+
+    it('should handle errors like exec', async () => {
+        const doc = jq.document(input);
+
+        expect(doc.exec('.foo | bar')).toBe(null);
+        expect(() => doc.exec('.foo | bar', { throwOnError: true })).toThrow(jq.JqExecCompileError);
+        await expect(doc.execAsync('error("boom")', { throwOnError: true })).rejects.toThrow('jq: error: boom');
+        expect(doc.execMany(['.owner.name', '.foo | bar'])[1].error).toMatch(/^jq: compile error/);
+        expect(() => jq.document({ big: 1n })).toThrow('Do not know how to serialize a BigInt');
+    });
+});
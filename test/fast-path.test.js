@@ -0,0 +1,168 @@
+const jq = require('../lib');
+
+class Point {
+    constructor() {
+        this.a = 1;
+    }
+}
+
+const hidden = { b: 1 };
+Object.defineProperty(hidden, 'a', { value: 2, enumerable: false });
+const bare = Object.create(null);
+bare.a = { b: 'bare' };
+
+const inputs = [
+    { a: { b: { c: 1 } }, 'a b': 2 },
+    { a: [1, { b: 2 }, 3] },
+    [1, [2, 3], { a: 4 }],
+    5,
+    'str',
+    null,
+    true,
+    { a: null, c: 'c' },
+    { a: false, f: false, n: null, c: 0 },
+    { a: 5 },
+    { a: 's', c: [] },
+    { a: [] },
+    { a: { b: [1] } },
+    { a: 1.5, b: { c: -0 } },
+    { a: { b: NaN, c: Infinity } },
+    { a: undefined, b: () => 1, c: [undefined, null] },
+    { a: new Date(0) },
+    { a: { toJSON: () => ({ b: 'json' }) } },
+    { a: new Point() },
+    JSON.parse('{"__proto__":{"b":1},"a":{"__proto__":2}}'),
+    hidden,
+    bare,
+];
+
+const filters = [
+    '.',
+    '.a',
+    '.a.b',
+    '.a.b.c',
+    '."a b"',
+    '.["a"]',
+    '.a["b"]',
+    '.a."b"',
+    '.a[0]',
+    '.a[1].b',
+    '.a[-1]',
+    '.a[-10]',
+    '.[0]',
+    '.[1][0]',
+    '.[-1]',
+    '.[5]',
+    '.c[0]',
+    '.__proto__',
+    '.__proto__.b',
+    '.toJSON',
+    '.a // "default"',
+    '.missing // "default"',
+    '.a.b // .c // 3',
+    '.f // false',
+    '.n // null',
+    '.a//0',
+    '. // 1',
+    '.a.b // .c',
+    '.a[0] // .a.b // true',
+    // Not simple paths, run on the VM either way
+    '.a?',
+    '.[]',
+    '.a.[0]',
+    '.a | .b',
+    '.a // -1',
+    '.a // 1.50',
+    '.a .b',
+];
+
+const run = (fn) => {
+    try {
+        return { value: fn() };
+    } catch (err) {
+        return { error: err.message };
+    }
+};
+
+const runAsync = async (fn) => {
+    try {
+        return { value: await fn() };
+    } catch (err) {
+        return { error: err.message };
+    }
+};
+
+// Results of fn with the fast path and on the VM
+const differential = async (fn) => {
+    const fast = await fn();
+    jq.setFastPath(false);
+    try {
+        return [fast, await fn()];
+    } finally {
+        jq.setFastPath(true);
+    }
+};
+
+describe('jq - fast path', () => {
+    it('should run simple paths without a jq state', () => {
+        const filter = `.a.b${Math.random().toString().slice(2, 8)}`;
+        jq.exec({ a: {} }, filter);
+        const entry = () => jq.getStats().filters.find((item) => item.filter.endsWith(filter));
+        expect(entry().states).toBe(0);
+
+        expect(jq.setFastPath(false)).toBe(true);
+        try {
+            jq.exec({ a: {} }, filter);
+        } finally {
+            jq.setFastPath(true);
+        }
+        expect(entry().states).toBeGreaterThanOrEqual(1);
+    });
+
+    it('should match jq on js inputs', async () => {
+        for (const filter of filters) {
+            for (const input of inputs) {
+                const [fast, vm] = await differential(() => run(() => jq.exec(input, filter, { throwOnError: true })));
+                expect({ filter, input, result: fast }).toEqual({ filter, input, result: vm });
+            }
+        }
+    });
+
+    it('should match jq on JSON inputs', async () => {
+        for (const filter of filters) {
+            for (const input of inputs) {
+                const json = Buffer.from(JSON.stringify(input) ?? 'null');
+                const [fast, vm] = await differential(() => run(() => jq.exec(json, filter, { throwOnError: true, output: 'json' })));
+                expect({ filter, json: json.toString(), result: fast }).toEqual({ filter, json: json.toString(), result: vm });
+            }
+        }
+    });
+
+    it('should match jq on async and batch calls', async () => {
+        for (const filter of filters) {
+            const [fast, vm] = await differential(async () => [
+                await runAsync(() => jq.execAsync(inputs[1], filter, { throwOnError: true })),
+                await jq.execBatchAsync(inputs, filter),
+                jq.execBatch(inputs, filter),
+            ]);
+            expect({ filter, result: fast }).toEqual({ filter, result: vm });
+        }
+    });
+
+    it('should match jq on templates and compiled filters', async () => {
+        const template = Object.fromEntries(filters.map((filter, i) => [`k${i}`, `{{${filter}}}`]));
+        // Only simple paths, rendered on the JS object without converting it
+        const paths = Object.fromEntries(filters.slice(0, filters.indexOf('.a?')).map((filter, i) => [`k${i}`, `{{${filter}}}`]));
+        for (const input of inputs) {
+            const [fast, vm] = await differential(async () => [
+                run(() => jq.renderRecursively(input, template)),
+                run(() => jq.renderRecursively(input, paths)),
+                run(() => jq.compileTemplate(paths).render(input)),
+                await runAsync(() => jq.renderRecursivelyAsync(input, template)),
+                await runAsync(() => jq.document(input).execManyAsync(filters)),
+                filters.map((filter) => run(() => jq.compile(filter, { throwOnError: true }).exec(input))),
+            ]);
+            expect({ input, result: fast }).toEqual({ input, result: vm });
+        }
+    });
+});
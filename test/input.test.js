@@ -0,0 +1,99 @@
+const jq = require('../lib');
+
+class Point {
+    constructor() {
+        this.x = 1;
+        this.y = 2;
+    }
+}
+
+const circular = { a: 1 };
+circular.self = circular;
+
+const inputs = {
+    'flat object': { foo: 'bar', num: 1.5, bool: true, nil: null },
+    'nested arrays': { items: [[1, 2], [], [{ a: 'b' }]] },
+    'integer keys': { b: 1, 2: 'two', a: 3, 1: 'one' },
+    'unicode': { emoji: '😀', accents: 'héllo', lone: '\ud800', nul: 'a\u0000b' },
+    'special numbers': { nan: NaN, inf: Infinity, negZero: -0, big: 1e300, small: 5e-324 },
+    'undefined members': { a: undefined, b: () => 1, c: [undefined, () => 1, Symbol('s')] },
+    'dates': { at: new Date(0) },
+    'own toJSON': { toJSON: () => ({ replaced: true }) },
+    'class instance': { point: new Point() },
+    'map and set': { map: new Map([['a', 1]]), set: new Set([1]) },
+    'null prototype': Object.assign(Object.create(null), { a: 1 }),
+    'deep arrays': JSON.parse('['.repeat(256) + ']'.repeat(256)),
+    'too deep arrays': JSON.parse('['.repeat(300) + ']'.repeat(300)),
+    'top-level string': 'str',
+    'top-level number': 42,
+    'top-level undefined': undefined,
+    'bigint': { big: BigInt(1) },
+    'circular': circular,
+};
+
+describe('jq - value input', () => {
+    Object.entries(inputs).forEach(([name, input]) => {
+        it(`should match the JSON.stringify path for ${name}`, async () => {
+            const walked = jq.exec(input, '.', { walkLimit: Infinity });
+            const stringified = jq.exec(input, '.', { walkLimit: 0 });
+
+            expect(walked).toStrictEqual(stringified);
+            expect(await jq.execAsync(input, '.', { walkLimit: Infinity })).toStrictEqual(stringified);
+        });
+    });
+
+    it('should fall back once the walk limit is exceeded', () => {
+        const input = { items: Array.from({ length: 100 }, (_, i) => ({ i })) };
+
+        expect(jq.exec(input, '.items | length', { walkLimit: 10 })).toBe(100);
+        expect(jq.exec(input, '.items[99].i', { walkLimit: 10 })).toBe(99);
+    });
+
+    it('should report JSON.stringify errors', () => {
+        expect(() => jq.exec({ big: BigInt(1) }, '.', { throwOnError: true })).toThrow('BigInt');
+        expect(() => jq.exec(circular, '.', { throwOnError: true, walkLimit: Infinity })).toThrow('circular');
+    });
+})
+
+describe('jq - value output', () => {
+    it('should keep __proto__ and NUL keys as own properties', async () => {
+        const json = '{"__proto__": {"polluted": true}, "a\\u0000b": "c\\u0000d"}';
+        const expected = JSON.parse(json);
+
+        for (const result of [jq.exec(Buffer.from(json), '.'), await jq.execAsync(Buffer.from(json), '.')]) {
+            expect(Object.keys(result)).toStrictEqual(['__proto__', 'a\u0000b']);
+            expect(result).toStrictEqual(expected);
+            expect(result.polluted).toBeUndefined();
+        }
+    });
+
+    it('should not set prototypes from __proto__ keys', async () => {
+        const input = Buffer.from('{"a": {"__proto__": {"polluted": true}}, "list": [{"__proto__": null}]}');
+        const check = (value) => {
+            expect(Object.getPrototypeOf(value.a)).toBe(Object.prototype);
+            expect(Object.getOwnPropertyNames(value.a)).toStrictEqual(['__proto__']);
+            expect(Object.getOwnPropertyDescriptor(value.a, '__proto__').value).toStrictEqual({ polluted: true });
+            expect(value.a.polluted).toBeUndefined();
+            expect(Object.getPrototypeOf(value.list[0])).toBe(Object.prototype);
+            expect(Object.getOwnPropertyDescriptor(value.list[0], '__proto__').value).toBeNull();
+        };
+
+        check(jq.exec(input, '.'));
+        check(await jq.execAsync(input, '.'));
+        check(jq.execAll(input, '.')[0]);
+        check(jq.execBatch([input], '.')[0].value);
+        check(jq.document(input).exec('.'));
+        check([...jq.iterate(input, '.')][0]);
+        check(jq.renderRecursively(input, { a: '{{.a}}', list: '{{.list}}' }));
+        // Built from a jq object literal too
+        check(jq.exec({}, '{a: {"__proto__": {polluted: true}}, list: [{"__proto__": null}]}'));
+        expect({}.polluted).toBeUndefined();
+    });
+
+    it('should convert repeated keys across many outputs', () => {
+        const input = Array.from({ length: 50 }, (_, i) => ({ id: i, name: `n${i}`, tags: [i] }));
+
+        expect(jq.execAll(input, '.[]')).toStrictEqual(input);
+        expect(jq.execBatch(input, '.name')).toStrictEqual(input.map(({ name }) => ({ value: name })));
+    });
+})
@@ -0,0 +1,102 @@
+const jq = require('../lib');
+
+describe('jq - all outputs', () => {
+    const input = { items: Array.from({ length: 250 }, (_, i) => ({ id: i, name: `item-${i}` })) };
+
+    it('should return every output', async () => {
+        expect(jq.execAll(input, '.items[].id')).toEqual(input.items.map(({ id }) => id));
+        expect(await jq.execAllAsync(input, '.items[]')).toEqual(input.items);
+        expect(jq.execAll(input, 'empty')).toEqual([]);
+        expect(await jq.execAllAsync(input, '.items[0].id, .items[1].name')).toEqual([0, 'item-1']);
+    });
+
+    it('should handle errors like exec', async () => {
+        expect(jq.execAll(input, '.items[0].id, error("boom")')).toBe(null);
+        expect(() => jq.execAll(input, '1, error("boom")', { throwOnError: true })).toThrow('jq: error: boom');
+        await expect(jq.execAllAsync(input, '.foo | bar', { throwOnError: true })).rejects.toThrow(jq.JqExecCompileError);
+    });
+
+    it('should iterate in batches', async () => {
+        for (const batchSize of [1, 7, 100, 250, 1000]) {
+            expect([...jq.iterate(input, '.items[].id', { batchSize })]).toEqual(input.items.map(({ id }) => id));
+
+            const values = [];
+            for await (const value of jq.iterateAsync(input, '.items[].name', { batchSize })) {
+                values.push(value);
+            }
+            expect(values).toEqual(input.items.map(({ name }) => name));
+        }
+    });
+
+    it('should stop the filter on break', async () => {
+        const values = [];
+        for (const value of jq.iterate({}, 'range(1000000000)', { batchSize: 10 })) {
+            if (value === 25) break;
+            values.push(value);
+        }
+        expect(values).toHaveLength(25);
+
+        for await (const value of jq.iterateAsync({}, 'range(1000000000)')) {
+            if (value === 150) break;
+        }
+        expect(jq.getCacheStats().idleStates).toBe(jq.getCacheStats().states);
+    });
+
+    it('should throw errors after the outputs before them', async () => {
+        const values = [];
+        const run = () => {
+            for (const value of jq.iterate({}, '1, 2, error("boom")', { batchSize: 10 })) {
+                values.push(value);
+            }
+        };
+
+        expect(run).toThrow(jq.JqExecError);
+        expect(values).toEqual([1, 2]);
+
+        const asyncValues = [];
+        const runAsync = async () => {
+            for await (const value of jq.iterateAsync({}, '1, error("boom")')) {
+                asyncValues.push(value);
+            }
+        };
+        await expect(runAsync()).rejects.toThrow(jq.JqExecError);
+        expect(asyncValues).toEqual([1]);
+        expect(() => [...jq.iterate({}, '.foo | bar')]).toThrow(jq.JqExecCompileError);
+    });
+
+    it('should iterate concurrently on one filter', async () => {
+        const collect = async (n) => {
+            const values = [];
+            for await (const value of jq.iterateAsync({ n }, 'range(.n)', { batchSize: 8 })) {
+                values.push(value);
+            }
+            return values;
+        };
+        const results = await Promise.all(Array.from({ length: 12 }, (_, i) => collect(i * 10)));
+
+        expect(results).toEqual(Array.from({ length: 12 }, (_, i) => Array.from({ length: i * 10 }, (_, j) => j)));
+    });
+
+    it('should hand back states only after their last outputs are converted', async () => {
+        // Every output shares a constant of the compiled program with the state
+        const constant = 'c'.repeat(64);
+        const filter = `.[] | "${constant}", {k: "${constant}"}`;
+        const collect = async () => {
+            const values = [];
+            for await (const value of jq.iterateAsync([1, 2], filter, { batchSize: 4 })) {
+                values.push(value);
+            }
+            return values;
+        };
+        const expected = [constant, { k: constant }, constant, { k: constant }];
+        for (let round = 0; round < 20; round++) {
+            const results = await Promise.all([
+                ...Array.from({ length: 4 }, collect),
+                ...Array.from({ length: 4 }, (_, i) => jq.execAsync([i], filter)),
+            ]);
+            expect(results.slice(0, 4)).toEqual(Array(4).fill(expected));
+            expect(results.slice(4)).toEqual(Array(4).fill(constant));
+            expect([...jq.iterate([1, 2], filter)]).toEqual(expected);
+        }
+    });
+});
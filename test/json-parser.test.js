@@ -0,0 +1,101 @@
+const jq = require('../lib');
+
+const numbers = [
+    '0', '-0', '1', '-1', '42', '123456789012345', '1234567890123456', '12345678901234567890',
+    '9007199254740993', '0.1', '-0.5', '1.5', '3.14159', '0.30000000000000004', '1e5', '1E5', '1e+5',
+    '1e-5', '2e22', '2e23', '1.7976931348623157e308', '1e308', '1e309', '-1e400', '5e-324', '1e-400',
+    '0.000001', '100000000000000000000000', '1.0', '1.50', '0e5', '123.456e-7',
+    '0.001', '-0.001', '0.0001', '0.00001', '-0.0', '1e0', '100', '0.5e1', '123456789012345.5', '0.1000',
+    // Not JSON numbers, jq reads some of them anyway
+    '01', '00', '-01', '+1', '.5', '1.', '1.e5', '1e', '1e+', '-', '--1', '0x10', '1_000', 'nan', 'NaN',
+    'Infinity', '-Infinity', 'infinity', '1.5.3', '1e5e5',
+];
+
+const strings = [
+    '""', '"a"', '"\xc3\xa9"', '"\\u00e9"', '"\\u0000"', '"\\u001f"', '"\\uD83D\\uDE00"', '"\\ud83d\\ude00"',
+    '"😀"', '"\\"\\\\\\/\\b\\f\\n\\r\\t"', '"a\\u0041b"', '"\\u20AC"', '"\\uFFFF"', '"\\uffff"',
+    // Invalid escapes and surrogates
+    '"\\ud83d"', '"\\ude00"', '"\\ud83d\\u0041"', '"\\ud83dx"', '"\\u12"', '"\\u12G4"', '"\\x41"', '"\\a"',
+    '"\\"', '"\\\\"', '"\\\\\\"', '"a', '"\\u"',
+    // Raw control characters and invalid UTF-8
+    '"\u0001"', '"\u001e"', '"\u001f"', '"\u0000"', '"\t"', '"\n"', '"\x7f"', '"\xff"', '"\xc3"', '"\xed\xa0\x80"',
+];
+
+const documents = [
+    '', ' ', 'null', 'true', 'false', ' true ', 'tru', 'truex', 'nul', 'nulll', 'True', '[]', '{}', '[ ]', '{ }',
+    '[1,2,3]', '[1, [2, [3, []]], {}]', '{"a":1}', '{"a":1,"a":2}', '{"b":1,"a":{"c":[true,null]}}',
+    ' \t\r\n{ "a" : [ 1 , "x" ] }\n', '[1,]', '[,1]', '[1 2]', '{"a"}', '{"a":}', '{"a" 1}', '{"a":1,}',
+    '{1:2}', '{"a":1 "b":2}', '[1}', '{"a":1]', '[', '{', ']', '}', '[[[', '1 2', '1 1', '"a" "b"', '[] []',
+    '{"a":1}x', '1x', 'x1', ':', ',', '\u001e1', '[1]\u001e', '\xef\xbb\xbf1', '/* c */ 1', '1 // c', "'a'",
+    '[1,"\\u00e9",{"k\\n":"v"}]', '{"\\u0061":1,"a":2}', '{"":""}', '["a\\\\"]', '["\\\\\\""]',
+];
+
+const parsers = ['jq', 'simd', 'scalar'];
+
+// What jq gives for text, by each parser. \xNN escapes are raw bytes, other characters UTF-8
+const results = (text, filter) => parsers.map((parser) => {
+    jq.setJsonParser(parser);
+    try {
+        return jq.exec(Buffer.from(text, /[^\x00-\xff]/.test(text) ? 'utf8' : 'latin1'), filter, { output: 'json', throwOnError: true });
+    } catch (err) {
+        return `error: ${err.message}`;
+    } finally {
+        jq.setJsonParser('jq');
+    }
+});
+
+const expectSame = (texts, filter = '.') => {
+    for (const text of texts) {
+        const [base, ...others] = results(text, filter);
+        for (const [i, result] of others.entries()) {
+            expect({ text, parser: parsers[i + 1], result }).toEqual({ text, parser: parsers[i + 1], result: base });
+        }
+    }
+};
+
+describe('jq - json parser', () => {
+    it('should read numbers like jv_parse', () => {
+        expectSame(numbers);
+        expectSame(numbers.map((number) => `[${number}, {"n": ${number}}]`));
+        // jq prints number literals as written, not as their double
+        expectSame(numbers, '[., tojson, tostring]');
+    });
+
+    it('should read strings and escapes like jv_parse', () => {
+        expectSame(strings);
+        expectSame(strings.map((string) => `{${string}: ${string}}`));
+    });
+
+    it('should accept and reject documents like jv_parse', () => {
+        expectSame(documents);
+        expectSame(documents.map((text) => `[${text}]`));
+    });
+
+    it('should read inputs spanning many blocks', () => {
+        const long = 'x'.repeat(63);
+        const texts = [
+            // Escapes, quotes and backslash runs across 64-byte block boundaries
+            ...Array.from({ length: 70 }, (_, i) => `["${'a'.repeat(i)}\\\\\\"${long}", "\\\\", ${i}]`),
+            ...Array.from({ length: 70 }, (_, i) => `${' '.repeat(i)}{"k": "${'\\\\'.repeat(i)}", "n": 123456789}`),
+            `[${Array.from({ length: 2000 }, (_, i) => `{"id": ${i}, "name": "n${i}", "v": ${i / 7}}`).join(',')}]`,
+            `${'['.repeat(100)}1${']'.repeat(100)}`,
+            `${'['.repeat(300)}${']'.repeat(300)}`,
+            `${'{"a":'.repeat(200)}1${'}'.repeat(200)}`,
+            `["${long.repeat(10)}`,
+        ];
+        expectSame(texts);
+    });
+
+    it('should parse inputs of every call with the parser set', async () => {
+        const input = Buffer.from('{"a": [1, 2.5, "\\u00e9"], "b": {"c": null}}');
+        expect(jq.setJsonParser('simd')).toBe('jq');
+        try {
+            expect(jq.exec(input, '.a')).toEqual([1, 2.5, 'é']);
+            expect(await jq.execAsync(input, '.b')).toEqual({ c: null });
+            expect(jq.execBatch([input, Buffer.from('[1')], '.a[0]')).toEqual([{ value: 1 }, { error: 'Invalid JSON input' }]);
+        } finally {
+            expect(jq.setJsonParser('jq')).toBe('simd');
+        }
+        expect(() => jq.setJsonParser('fast')).toThrow("JSON parser must be 'jq', 'simd' or 'scalar'");
+    });
+});
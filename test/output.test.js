@@ -0,0 +1,60 @@
+const jq = require('../lib');
+
+describe('jq - raw JSON output', () => {
+    const json = { foo: 'b"ar', num: 1.5, items: [1, null, { ok: true }], nested: JSON.parse('{"__proto__":1,"a\\u0000b":"c"}') };
+
+    it('should return the JSON of the result as a string or Buffer', async () => {
+        expect(jq.exec(json, '.', { output: 'json' })).toBe(JSON.stringify(json));
+        expect(await jq.execAsync(json, '.items', { output: 'json' })).toBe('[1,null,{"ok":true}]');
+
+        const buffer = await jq.execAsync(json, '.nested', { output: 'buffer' });
+        expect(Buffer.isBuffer(buffer)).toBe(true);
+        expect(JSON.parse(buffer)).toStrictEqual(json.nested);
+        expect(jq.exec(json, '.foo', { output: 'buffer' }).toString()).toBe('"b\\"ar"');
+    });
+
+    it('should hand over large results', async () => {
+        const large = { items: Array.from({ length: 5000 }, (_, i) => ({ i })) };
+
+        expect(JSON.parse(await jq.execAsync(large, '.', { output: 'buffer' }))).toStrictEqual(large);
+        expect(JSON.parse(jq.exec(large, '.items', { output: 'buffer' }))).toStrictEqual(large.items);
+    });
+
+    it('should keep undefined and errors', async () => {
+        expect(jq.exec(json, 'empty', { output: 'json' })).toBeUndefined();
+        expect(await jq.execAsync(json, 'empty', { output: 'buffer' })).toBeUndefined();
+        expect(() => jq.exec(json, 'error("x")', { output: 'json', throwOnError: true })).toThrow('x');
+        expect(() => jq.exec(json, '.', { output: 'xml', throwOnError: true })).toThrow('Invalid output option');
+    });
+
+    it('should apply to batches, all outputs and compiled filters', async () => {
+        const inputs = [{ a: 1 }, { a: 'x' }];
+        const results = [{ value: '2' }, { error: 'jq: error: string ("x") and number (1) cannot be added' }];
+
+        expect(jq.execBatch(inputs, '.a + 1', { output: 'json' })).toEqual(results);
+        expect(await jq.execBatchAsync(inputs, '.a + 1', { output: 'json' })).toEqual(results);
+        expect(jq.execAll(json, '.items[]', { output: 'json' })).toEqual(['1', 'null', '{"ok":true}']);
+        expect(await jq.execAllAsync(json, '.items[]', { output: 'json' })).toEqual(['1', 'null', '{"ok":true}']);
+        expect([...jq.iterate(json, '.items[]', { output: 'json' })]).toEqual(['1', 'null', '{"ok":true}']);
+        expect(jq.compile('.num', { output: 'json' }).exec(json)).toBe('1.5');
+        expect(await jq.document(json).execAsync('.foo', { output: 'json' })).toBe('"b\\"ar"');
+    });
+
+    it('should render templates as JSON', async () => {
+        const template = {
+            id: '{{.num}}',
+            '{{.foo}}': ['{{.items}}', '{{empty}}', 'text'],
+            title: 'n={{.num}}',
+            '{{spreadValue()}}': '{{.items[2]}}',
+            skipped: '{{empty}}',
+        };
+        const expected = JSON.stringify(jq.renderRecursively(json, template));
+
+        expect(jq.renderRecursively(json, template, { output: 'json' })).toBe(expected);
+        expect(await jq.renderRecursivelyAsync(json, template, { output: 'json' })).toBe(expected);
+
+        const compiled = jq.compileTemplate(template, { output: 'buffer' });
+        expect(compiled.render(json).toString()).toBe(expected);
+        expect((await compiled.renderAsync(json)).toString()).toBe(expected);
+    });
+});
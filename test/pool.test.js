@@ -0,0 +1,35 @@
+const jq = require('../lib');
+
+describe('jq - state pool', () => {
+    it('should run one filter concurrently', async () => {
+        const filter = '[.items[] | .value * 2] | add';
+        const inputs = Array.from({ length: 32 }, (_, i) => ({ items: [{ value: i }, { value: 1 }] }));
+        const results = await Promise.all(inputs.map((input) => jq.execAsync(input, filter)));
+
+        expect(results).toEqual(inputs.map((_, i) => i * 2 + 2));
+    });
+
+    it('should keep the pool bounded', async () => {
+        const filter = '.foo | ascii_downcase';
+        await Promise.all(Array.from({ length: 64 }, () => jq.execAsync({ foo: 'BAR' }, filter)));
+        const stats = jq.getCacheStats();
+
+        // Simple paths like .foo run without a state, every other entry holds at least one
+        expect(stats.states).toBeGreaterThanOrEqual(1);
+        expect(stats.states).toBeLessThanOrEqual(stats.entries * stats.poolSize);
+        expect(stats.idleStates).toBe(stats.states);
+    });
+
+    it('should allow changing the pool size', async () => {
+        const previous = jq.getCacheStats().poolSize;
+
+        expect(jq.setPoolSize(1)).toBe(1);
+        const results = await Promise.all(Array.from({ length: 8 }, (_, i) => jq.execAsync({ i }, '.i + 1')));
+        expect(results).toEqual([1, 2, 3, 4, 5, 6, 7, 8]);
+        expect(jq.exec({ i: 1 }, '.i + 1')).toBe(2);
+        expect(jq.getCacheStats().poolSize).toBe(1);
+        expect(() => jq.setPoolSize(0)).toThrow('Pool size must be positive');
+
+        jq.setPoolSize(previous);
+    });
+})
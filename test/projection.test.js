@@ -0,0 +1,189 @@
+const jq = require('../lib');
+
+class Point {
+    constructor() {
+        this.b = 1;
+    }
+}
+
+const hidden = { b: 1 };
+Object.defineProperty(hidden, 'a', { value: { b: 2 }, enumerable: false });
+const bare = Object.create(null);
+bare.a = { b: 'bare', c: [1] };
+
+const inputs = [
+    { a: { b: 1, c: [1, 2, 3] }, x: 2, k: 'x', z: { deep: [1] } },
+    { a: { b: 'str', c: { d: 1 } }, x: 'x', k: 'a' },
+    { a: [1, 2], x: null },
+    { a: null, x: 0 },
+    { x: 1.5, k: 'missing' },
+    [1, { a: 2 }],
+    'str',
+    5,
+    null,
+    { a: { b: undefined, c: NaN }, x: () => 1 },
+    { a: new Date(0), x: 1 },
+    { a: { toJSON: () => ({ b: 'json' }) }, x: 1 },
+    { toJSON: () => ({ a: { b: 'root' } }) },
+    { a: new Point(), x: 1 },
+    JSON.parse('{"__proto__":{"b":1},"a":{"__proto__":2,"b":3}}'),
+    hidden,
+    bare,
+];
+
+const filters = [
+    '.a.b + 1',
+    '.a.b + .x',
+    '{t: .a.b, y: .x}',
+    '{a, x}',
+    '{"a"}',
+    '.a | keys',
+    '.a.c[0], .x',
+    '.a.c[1:]',
+    '.a.c[.x]',
+    '[.a.c[] | . * 2]',
+    '.a.c | length',
+    'if .x then .a.b else .k end',
+    '.a as $v | .x + $v.b',
+    '{(.k): .x}',
+    '.a?.b // .x',
+    '.a."b", .a["b"]',
+    '.a | .b, .c',
+    '.a | to_entries | map(.key)',
+    '.x | tostring | "\\(.)"',
+    '.a | @json "v: \\(.)"',
+    '[.x, .a.b] | add',
+    '.a.c | reduce .[] as $i (0; . + $i)',
+    '$__loc__',
+    '1',
+    // Read the whole input
+    '.',
+    'keys',
+    '.[.k]',
+    '"\\(.x)"',
+    'try .a.b catch .',
+    'map(.)',
+];
+
+const run = (fn) => {
+    try {
+        return { value: fn() };
+    } catch (err) {
+        return { error: err.message };
+    }
+};
+
+const runAsync = async (fn) => {
+    try {
+        return { value: await fn() };
+    } catch (err) {
+        return { error: err.message };
+    }
+};
+
+// An input that records which of its fields were read
+const tracked = () => {
+    const read = new Set();
+    const input = {};
+    const fields = { a: { b: 1, c: [1, 2] }, x: 2, k: 'x', z: { big: 1n } };
+    for (const [key, value] of Object.entries(fields)) {
+        Object.defineProperty(input, key, {
+            enumerable: true,
+            get: () => {
+                read.add(key);
+                return value;
+            },
+        });
+    }
+    return { input, read };
+};
+
+describe('jq - input projection', () => {
+    it('should only convert the fields a filter reads', async () => {
+        const cases = [
+            ['.a.b + .x', ['a', 'x'], 3],
+            ['{title: .a.b, key: .k}', ['a', 'k'], { title: 1, key: 'x' }],
+            ['.a.c | map(. * 2)', ['a'], [2, 4]],
+            ['.x as $x | .a.c[] | . + $x', ['a', 'x'], 3],
+            ['{(.k): .x}', ['k', 'x'], { x: 2 }],
+        ];
+        for (const [filter, fields, expected] of cases) {
+            const sync = tracked();
+            expect(jq.exec(sync.input, filter, { throwOnError: true })).toEqual(expected);
+            expect([...sync.read].sort()).toEqual(fields);
+
+            const compiled = tracked();
+            expect(jq.compile(filter, { throwOnError: true }).exec(compiled.input)).toEqual(expected);
+            expect([...compiled.read].sort()).toEqual(fields);
+
+            // Cached by now, so async calls know what to convert too
+            const async = tracked();
+            expect(await jq.execAsync(async.input, filter, { throwOnError: true })).toEqual(expected);
+            expect([...async.read].sort()).toEqual(fields);
+        }
+
+        const template = tracked();
+        expect(jq.renderRecursively(template.input, { title: '{{.a.b}}', size: '{{.a.c | length}}' })).toEqual({ title: 1, size: 2 });
+        expect([...template.read]).toEqual(['a']);
+
+        const whole = tracked();
+        expect(() => jq.exec(whole.input, 'keys', { throwOnError: true })).toThrow('BigInt');
+        expect(whole.read.size).toBe(4);
+    });
+
+    it('should throw on a cycle in the fields a filter reads', async () => {
+        const input = { a: { b: 1 }, list: [] };
+        input.self = input;
+        input.list.push(input);
+        for (const filter of ['.self.a', '{b: .self.self.a.b}', '.list[0].a', '.self | .a', '[.a.b, .self.a.b]']) {
+            expect(() => jq.exec(input, filter, { throwOnError: true })).toThrow('Converting circular structure to JSON');
+            expect(() => jq.compile(filter, { throwOnError: true }).exec(input)).toThrow('Converting circular structure to JSON');
+            await expect(jq.execAsync(input, filter, { throwOnError: true })).rejects.toThrow('Converting circular structure to JSON');
+        }
+        expect(() => jq.renderRecursively(input, { b: '{{.self.a.b}}' }, { throwOnError: true })).toThrow('Converting circular structure to JSON');
+        // The cycle isn't on the way to .a
+        expect(jq.exec(input, '.a.b', { throwOnError: true })).toBe(1);
+    });
+
+    it('should match jq on the whole input', async () => {
+        for (const filter of filters) {
+            for (const input of inputs) {
+                const json = Buffer.from(JSON.stringify(input) ?? 'null');
+                const projected = [
+                    run(() => jq.exec(input, filter, { throwOnError: true })),
+                    run(() => jq.execAll(input, filter, { throwOnError: true })),
+                    run(() => jq.compile(filter, { throwOnError: true }).exec(input)),
+                    jq.execBatch([input], filter),
+                    await runAsync(() => jq.execAsync(input, filter, { throwOnError: true })),
+                ];
+                const whole = [
+                    run(() => jq.exec(json, filter, { throwOnError: true })),
+                    run(() => jq.execAll(json, filter, { throwOnError: true })),
+                    run(() => jq.compile(filter, { throwOnError: true }).exec(json)),
+                    jq.execBatch([json], filter),
+                    await runAsync(() => jq.execAsync(json, filter, { throwOnError: true })),
+                ];
+                expect({ filter, input, result: projected }).toEqual({ filter, input, result: whole });
+            }
+        }
+    });
+
+    it('should match whole inputs on templates', () => {
+        const template = Object.fromEntries(filters.map((filter, i) => [`k${i}`, `{{${filter}}}`]));
+        const projectable = Object.fromEntries(filters.slice(0, filters.indexOf('.')).map((filter, i) => [`k${i}`, `{{${filter}}}`]));
+        const render = (input) => [
+            run(() => jq.renderRecursively(input, template)),
+            run(() => jq.renderRecursively(input, projectable)),
+            run(() => jq.compileTemplate(projectable).render(input)),
+        ];
+        for (const input of inputs) {
+            const projected = render(input);
+            expect(jq.setInputProjection(false)).toBe(true);
+            try {
+                expect({ input, result: projected }).toEqual({ input, result: render(input) });
+            } finally {
+                jq.setInputProjection(true);
+            }
+        }
+    });
+});
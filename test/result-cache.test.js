@@ -0,0 +1,115 @@
+const jq = require('../lib');
+
+const sleep = (ms) => new Promise((resolve) => setTimeout(resolve, ms));
+const memo = () => jq.getStats().resultCache;
+
+// Runs fn with the result cache on, it is off by default
+const withResultCache = async (options, fn) => {
+    jq.setResultCache(options);
+    try {
+        await fn();
+    } finally {
+        jq.setResultCache(null);
+    }
+};
+
+describe('jq - result cache', () => {
+    it('should memoize results by filter and input', () => withResultCache({ maxBytes: 1 << 20 }, async () => {
+        const filter = '[.items[] | select(.tier < 3) | .name] | join(",")';
+        const input = { items: [{ name: 'a', tier: 1 }, { name: 'b', tier: 5 }, { name: 'c', tier: 2 }] };
+        const before = memo();
+
+        expect(jq.exec(input, filter)).toBe('a,c');
+        expect(jq.exec(input, filter)).toBe('a,c');
+        expect(jq.exec({ items: [{ name: 'd', tier: 0 }] }, filter)).toBe('d');
+        expect(jq.exec({ items: [...input.items] }, filter)).toBe('a,c');
+        expect(memo().hits - before.hits).toBe(2);
+        expect(memo().misses - before.misses).toBe(2);
+        expect(memo().entries).toBe(before.entries + 2);
+    }));
+
+    it('should hand out a copy of every result', () => withResultCache({ maxBytes: 1 << 20 }, async () => {
+        const filter = '{a: .a, b: [.b]}';
+        const first = jq.exec({ a: 1, b: 2 }, filter);
+        first.b.push(3);
+
+        expect(jq.exec({ a: 1, b: 2 }, filter)).toEqual({ a: 1, b: [2] });
+        expect(jq.exec({ a: 1, b: 2 }, filter, { output: 'json' })).toBe('{"a":1,"b":[2]}');
+        expect(jq.exec({ a: 1, b: 2 }, filter, { output: 'json' })).toBe('{"a":1,"b":[2]}');
+        expect(jq.exec({ a: 1, b: 2 }, '.c | values')).toBe(undefined);
+        expect(jq.exec({ a: 1, b: 2 }, '.c | values')).toBe(undefined);
+    }));
+
+    it('should skip parsing JSON inputs it has seen', () => withResultCache({ maxBytes: 1 << 20 }, async () => {
+        const json = Buffer.from('{"a":{"b":[1,2,3]}}');
+        const parses = () => jq.getStats().latency.parse.count;
+        expect(jq.exec(json, '.a.b | add')).toBe(6);
+        const before = parses();
+
+        expect(jq.exec(json, '.a.b | add')).toBe(6);
+        expect(jq.exec(Buffer.from('{"a":{"b":[1]}}'), '.a.b | add')).toBe(1);
+        expect(parses() - before).toBeLessThanOrEqual(1);
+    }));
+
+    it('should not memoize non-deterministic filters or errors', () => withResultCache({ maxBytes: 1 << 20 }, async () => {
+        const filters = ['now | type', '$__loc__ | .line', '"at \\(now | floor | type)"', 'try input catch "none"'];
+        const before = memo();
+        for (const filter of filters) {
+            jq.exec({}, filter);
+            jq.exec({}, filter);
+        }
+        jq.exec({}, '$ENV | type', { enableEnv: true });
+        jq.exec({}, '$ENV | type', { enableEnv: true });
+        expect(() => jq.exec({ a: 1 }, '.a | error("boom")', { throwOnError: true })).toThrow('boom');
+        expect(() => jq.exec({ a: 1 }, '.a | error("boom")', { throwOnError: true })).toThrow('boom');
+
+        expect(memo().hits).toBe(before.hits);
+        // $ENV is hidden without enableEnv
+        jq.exec({}, '$ENV | type');
+        expect(jq.exec({}, '$ENV | type')).toBe('object');
+        expect(memo().hits).toBe(before.hits + 1);
+    }));
+
+    it('should drop results past their ttl', () => withResultCache({ maxBytes: 1 << 20 }, async () => {
+        jq.setResultCache({ maxBytes: 1 << 20, ttlMs: 20 });
+        const before = memo();
+        expect(jq.exec({ a: 1 }, '.a + 1')).toBe(2);
+        expect(jq.exec({ a: 1 }, '.a + 1')).toBe(2);
+        await sleep(40);
+        expect(jq.exec({ a: 1 }, '.a + 1')).toBe(2);
+
+        expect(memo().hits - before.hits).toBe(1);
+        expect(memo().expired - before.expired).toBe(1);
+        expect(memo().ttlMs).toBe(20);
+    }));
+
+    it('should keep within its byte budget', () => withResultCache({ maxBytes: 1 << 20 }, async () => {
+        expect(jq.setResultCache({ maxBytes: 4096 })).toBe(4096);
+        for (let i = 0; i < 100; i++) {
+            jq.exec({ i }, '[range(.i)]');
+        }
+        const stats = memo();
+        expect(stats.bytes).toBeLessThanOrEqual(4096);
+        expect(stats.evictions).toBeGreaterThan(0);
+
+        jq.setResultCache(null);
+        expect([memo().entries, memo().bytes, memo().maxBytes]).toEqual([0, 0, 0]);
+        expect(() => jq.setResultCache({ maxBytes: -1 })).toThrow('Invalid maxBytes option');
+    }));
+
+    it('should memoize templates and compiled filters', () => withResultCache({ maxBytes: 1 << 20 }, async () => {
+        const template = { id: '{{.identifier}}', title: '{{.title | ascii_upcase}}', size: '{{.tags | length}}' };
+        const input = { identifier: 'svc', title: 'service', tags: ['a', 'b'] };
+        const compiled = jq.compileTemplate(template);
+        const filter = jq.compile('.tags | map(. + "!")');
+        const before = memo();
+
+        for (let i = 0; i < 2; i++) {
+            expect(jq.renderRecursively(input, template)).toEqual({ id: 'svc', title: 'SERVICE', size: 2 });
+            expect(compiled.render(input)).toEqual({ id: 'svc', title: 'SERVICE', size: 2 });
+            expect(filter.exec(input)).toEqual(['a!', 'b!']);
+        }
+        expect(memo().hits).toBeGreaterThan(before.hits);
+        expect(compiled.render({ ...input, title: 'other' })).toEqual({ id: 'svc', title: 'OTHER', size: 2 });
+    }));
+});
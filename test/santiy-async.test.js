@@ -168,6 +168,17 @@ describe('jq - async', () => {
         await expect(jq.execAsync({foo: "bar"}, '.foo + 1', {throwOnError: true})).rejects.toThrow("jq: error: string (\"bar\") and number (1) cannot be added");
     })
 
+    it('should return large results', async () => {
+        const json = { items: Array.from({ length: 1000 }, (_, i) => ({ id: `id-${i}`, tags: ['a', 'b'], nested: { i } })) };
+        const result = await jq.execAsync(json, '.items');
+
+        expect(result).toEqual(json.items);
+    });
+
+    it('should return nan and infinite like a JSON round trip', async () => {
+        expect(await jq.execAsync({}, '[nan, infinite, -infinite]')).toEqual([null, 1.7976931348623157e+308, -1.7976931348623157e+308]);
+    });
+
     it('throw after timeout', async () => {
       await expect(jq.execAsync({}, '[range(infinite)]', { timeoutSec: 1, throwOnError: true })).rejects.toThrow('timeout');
     });
@@ -0,0 +1,136 @@
+const { Readable } = require('stream');
+const jq = require('../lib');
+
+const inputs = [
+    { a: 1, c: [1, 2, 3], k: 'key' },
+    { a: 'x', b: 'y' },
+    { a: 2, c: [] },
+    [1, 2],
+    null,
+    'str',
+];
+
+const filters = [
+    '.a == "x"',
+    '.a + 1',
+    '[.a, "s", 3]',
+    '{a: "v", b: 2}',
+    '{"k": 1, n: "x"}',
+    '{a, "b"}',
+    '{(.k): "v"}',
+    'if .a == 1 then "one" elif .a == 2 then "two" else "other" end',
+    '.a // "default"',
+    '.b // "d" | ascii_upcase',
+    '.["a"]',
+    '."a", .a."b"',
+    '@base64 "x\\(.a)"',
+    '"x\\(.a)y"',
+    '.a as $v | "x" as $w | [$v, $w]',
+    'reduce range(3) as $i (10; . + $i)',
+    'def f: "in def"; [f, 1]',
+    '[limit(2; range(10))]',
+    '.c[1:2], .c[0], .c[-1]',
+    'select(.a == 1) | "yes"',
+    '.a and "x" or 0',
+    '[.c[] | tostring | ltrimstr("1")]',
+    'error("boom")',
+    'try error("boom") catch "caught: " + .',
+    '. as [$a, $b] | [$a, "x"]',
+    '. as {a: $x} | [$x, 1]',
+    '$__loc__',
+    '"a" | test("a")',
+    'path(.a, .["b"])',
+    'del(.["a"])',
+    '.a = "set"',
+    'getpath(["a"])',
+    '1e3, 1.5, 007, 123456789012345678',
+    '"tab\\there", "é", -1',
+    '[.c[]? | . - 1]',
+    'label $out | 1, break $out',
+    '"a" as $__jq0 | $__jq0',
+    '"s" # "comment"\n, 2',
+    // Compile errors
+    '{"a" 1}',
+    '. as [$a, 1] | $a',
+    '{1: 2}',
+    '"a" "b"',
+    '.a | "x" |',
+];
+
+const run = (fn) => {
+    try {
+        return { value: fn() };
+    } catch (err) {
+        return { error: err.message };
+    }
+};
+
+const runAsync = async (fn) => {
+    try {
+        return { value: await fn() };
+    } catch (err) {
+        return { error: err.message };
+    }
+};
+
+const collect = async (stream) => {
+    const values = [];
+    for await (const batch of stream) {
+        values.push(...batch);
+    }
+    return values;
+};
+
+const results = async (filter) => {
+    const rows = [];
+    for (const input of inputs) {
+        rows.push([
+            run(() => jq.exec(input, filter, { throwOnError: true })),
+            run(() => jq.execAll(input, filter, { throwOnError: true })),
+            await runAsync(() => jq.execAsync(input, filter, { throwOnError: true })),
+            run(() => jq.compile(filter, { throwOnError: true }).exec(input)),
+            run(() => [...jq.iterate(input, filter)]),
+        ]);
+    }
+    rows.push(jq.execBatch(inputs, filter), await jq.execBatchAsync(inputs, filter));
+    const ndjson = inputs.map((input) => JSON.stringify(input)).join('\n');
+    rows.push(await runAsync(() => collect(Readable.from([Buffer.from(ndjson)]).pipe(jq.createFilterStream(filter)))));
+    return rows;
+};
+
+describe('jq - shared compilation', () => {
+    it('should compile filters differing in literals once', () => {
+        const id = Math.random().toString().slice(2, 8);
+        const first = `.items[] | select(.id == "a${id}") | .value + 1`;
+        const second = `.items[] | select(.id == "b${id}") | .value + 2`;
+        const input = { items: [{ id: `a${id}`, value: 1 }, { id: `b${id}`, value: 2 }] };
+
+        expect(jq.exec(input, first)).toBe(2);
+        expect(jq.exec(input, second)).toBe(4);
+        const entry = (filter) => jq.getStats().filters.find((item) => item.filter.endsWith(filter));
+        // The second filter shares the states of the first, it is only charged for its text
+        expect(entry(second).bytes).toBeLessThan(entry(first).bytes);
+        expect(entry(second).states).toBe(entry(first).states);
+    });
+
+    it('should match filters compiled as written', async () => {
+        for (const filter of filters) {
+            const hoisted = await results(filter);
+            expect(jq.setLiteralHoisting(false)).toBe(true);
+            try {
+                // A leading space keeps the cached entries apart
+                const written = await results(` ${filter}`);
+                expect({ filter, result: hoisted }).toEqual({ filter, result: written });
+            } finally {
+                jq.setLiteralHoisting(true);
+            }
+        }
+    });
+
+    it('should share states with templates and documents', () => {
+        const template = { a: '{{.a == "one"}}', b: '{{.a == "two"}}', c: '{{[.a, "three"]}}' };
+        expect(jq.renderRecursively({ a: 'two' }, template)).toEqual({ a: false, b: true, c: ['two', 'three'] });
+        expect(jq.compileTemplate(template).render({ a: 'one' })).toEqual({ a: true, b: false, c: ['one', 'three'] });
+        expect(jq.document({ a: 'two' }).execMany(['.a == "one"', '.a == "two"'])).toEqual([{ value: false }, { value: true }]);
+    });
+});
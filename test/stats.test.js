@@ -0,0 +1,54 @@
+const jq = require('../lib');
+
+const phases = ['parse', 'execute', 'serialize', 'materialize'];
+
+describe('jq - stats', () => {
+    it('should time every phase', async () => {
+        const before = jq.getStats();
+        const input = Buffer.from(JSON.stringify({ items: [1, 2, 3] }));
+
+        expect(jq.exec(input, '.items | add')).toBe(6);
+        expect(await jq.execAsync(input, '.items', { output: 'json' })).toBe('[1,2,3]');
+        const after = jq.getStats();
+
+        for (const phase of phases) {
+            const histogram = after.latency[phase];
+            expect(histogram.count).toBeGreaterThan(before.latency[phase].count);
+            expect(histogram.buckets.reduce((sum, bucket) => sum + bucket.count, 0)).toBe(histogram.count);
+            expect(histogram.totalUs).toBeGreaterThan(0);
+            expect(histogram.p50Us).toBeLessThanOrEqual(histogram.p99Us);
+            expect(histogram.p99Us).toBeLessThanOrEqual(histogram.maxUs);
+        }
+    });
+
+    it('should report cached filters with their compile time', () => {
+        const filter = `.a * ${Math.random()}`;
+        jq.exec({ a: 1 }, filter);
+        const { cache, filters } = jq.getStats();
+
+        const entry = filters.find((item) => item.filter.endsWith(filter));
+        expect(entry.compileUs).toBeGreaterThan(0);
+        expect(entry.bytes).toBeGreaterThan(0);
+        expect(entry.states).toBeGreaterThanOrEqual(1);
+        expect(filters.length).toBe(cache.entries);
+    });
+
+    it('should count async work in flight and waits for filter states', async () => {
+        const previous = jq.getCacheStats().poolSize;
+        jq.setPoolSize(1);
+        try {
+            const waits = jq.getStats().stateWaits.count;
+            const filter = '[range(20000)] | length';
+            // Distinct inputs, identical calls would wait on one another instead of queueing
+            const pending = Promise.all(Array.from({ length: 8 }, (_, i) => jq.execAsync({ i }, filter)));
+
+            expect(jq.getStats().asyncInFlight).toBe(8);
+            expect(await pending).toEqual(Array(8).fill(20000));
+            const { asyncInFlight, stateWaits } = jq.getStats();
+            expect(asyncInFlight).toBe(0);
+            expect(stateWaits.count).toBeGreaterThan(waits);
+        } finally {
+            jq.setPoolSize(previous);
+        }
+    });
+});
@@ -0,0 +1,56 @@
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+const { Readable } = require('stream');
+const jq = require('../lib');
+
+const collect = async (stream) => {
+    const values = [];
+    for await (const batch of stream) {
+        values.push(...batch);
+    }
+    return values;
+};
+
+const records = Array.from({ length: 500 }, (_, i) => ({ id: i, name: `item-${i}`, tags: ['a'] }));
+const ndjson = records.map((record) => JSON.stringify(record)).join('\n') + '\n';
+
+describe('jq - streams', () => {
+    it('should filter every value of NDJSON input', async () => {
+        const chunks = [];
+        for (let i = 0; i < ndjson.length; i += 37) {
+            chunks.push(Buffer.from(ndjson.slice(i, i + 37)));
+        }
+        const values = await collect(Readable.from(chunks).pipe(jq.createFilterStream('.id')));
+
+        expect(values).toEqual(records.map(({ id }) => id));
+    });
+
+    it('should emit every output, null included', async () => {
+        const input = Readable.from([Buffer.from('{"a":[1,null]} {"a":[]}\n{"a":[3]}')]);
+
+        expect(await collect(input.pipe(jq.createFilterStream('.a[]')))).toEqual([1, null, 3]);
+    });
+
+    it('should read files by path and descriptor', async () => {
+        const file = path.join(os.tmpdir(), `jq-stream-${process.pid}.ndjson`);
+        fs.writeFileSync(file, ndjson);
+        try {
+            const names = await collect(jq.streamFile(file, '.name', { highWaterMark: 1024 }));
+            expect(names).toEqual(records.map(({ name }) => name));
+
+            const fd = fs.openSync(file, 'r');
+            const ids = await collect(jq.streamFile(fd, 'select(.id % 100 == 0) | .id'));
+            expect(ids).toEqual([0, 100, 200, 300, 400]);
+        } finally {
+            fs.unlinkSync(file);
+        }
+    });
+
+    it('should fail on invalid input and errors', async () => {
+        await expect(collect(Readable.from([Buffer.from('{"a":1}\n{"a":')]).pipe(jq.createFilterStream('.a')))).rejects.toThrow(jq.JqExecError);
+        await expect(collect(Readable.from([Buffer.from('1 2 x')]).pipe(jq.createFilterStream('.')))).rejects.toThrow('Invalid JSON input');
+        await expect(collect(Readable.from([Buffer.from('1 "x"')]).pipe(jq.createFilterStream('. + 1')))).rejects.toThrow('jq: error');
+        expect(() => jq.createFilterStream('.foo | bar')).toThrow(jq.JqExecCompileError);
+    });
+});
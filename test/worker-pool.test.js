@@ -0,0 +1,97 @@
+const jq = require('../lib');
+
+const slow = '[range(30000)] | length';
+const sleep = (ms) => new Promise((resolve) => setTimeout(resolve, ms));
+
+// Run fn with a dedicated worker pool, going back to the libuv pool after it
+const withPool = async (options, fn) => {
+    jq.setWorkerPool(options);
+    try {
+        await fn();
+    } finally {
+        jq.setWorkerPool(null);
+    }
+};
+
+describe('jq - worker pool', () => {
+    it('should run async calls on its own threads', () => withPool({ threads: 2 }, async () => {
+        expect(await jq.execAsync({ a: 1 }, '.a + 1')).toBe(2);
+        expect(await jq.execAllAsync({ a: [1, 2] }, '.a[]')).toEqual([1, 2]);
+        expect(await jq.execBatchAsync([{ a: 1 }, { a: 2 }], '.a')).toEqual([{ value: 1 }, { value: 2 }]);
+        expect(await jq.document({ a: 3 }).execAsync('.a')).toBe(3);
+        const values = [];
+        for await (const value of jq.iterateAsync({ a: [1, 2, 3] }, '.a[]', { batchSize: 2 })) {
+            values.push(value);
+        }
+        expect(values).toEqual([1, 2, 3]);
+
+        const { workerPool, asyncInFlight } = jq.getStats();
+        expect(workerPool).toEqual({ threads: 2, queued: 0, rejected: 0, shed: 0, expired: 0 });
+        expect(asyncInFlight).toBe(0);
+    }));
+
+    it('should run high priority calls first', () => withPool({ threads: 1 }, async () => {
+        const order = [];
+        const run = (name, priority) => jq.execAsync({ name }, slow, { priority }).then(() => order.push(name));
+
+        const first = run('first');
+        // Let the worker start on it, the others queue up behind it
+        await sleep(5);
+        await Promise.all([first, run('low', 'low'), run('normal'), run('high', 'high')]);
+        expect(order).toEqual(['first', 'high', 'normal', 'low']);
+    }));
+
+    it('should reject calls over the queue limit', () => withPool({ threads: 1, maxQueue: 2 }, async () => {
+        const results = await Promise.allSettled(Array.from({ length: 6 }, (_, i) => jq.execAsync({ i }, slow, { throwOnError: true })));
+
+        const rejected = results.filter((result) => result.status === 'rejected');
+        expect(rejected.length).toBeGreaterThanOrEqual(3);
+        expect(rejected[0].reason.message).toBe('jq worker queue is full');
+        expect(jq.getStats().workerPool.rejected).toBe(rejected.length);
+    }));
+
+    it('should shed the oldest call of a lower priority for a new one', () => withPool({ threads: 1, maxQueue: 1, overflow: 'shed' }, async () => {
+        const first = jq.execAsync({}, slow);
+        await sleep(5);
+        const low = jq.execAsync({}, '1', { priority: 'low', throwOnError: true });
+        const high = jq.execAsync({}, '2', { priority: 'high', throwOnError: true });
+
+        await expect(low).rejects.toThrow('jq worker queue is full');
+        expect(await high).toBe(2);
+        expect(await first).toBe(30000);
+        expect(jq.getStats().workerPool.shed).toBe(1);
+    }));
+
+    it('should drop calls that waited too long', () => withPool({ threads: 1, maxWaitMs: 20 }, async () => {
+        const results = await Promise.allSettled([
+            jq.execAsync({}, '[range(100000)] | length'),
+            jq.execAsync({}, slow, { throwOnError: true }),
+        ]);
+
+        expect(results[1].reason.message).toBe('jq work waited too long in the worker queue');
+        expect(jq.getStats().workerPool.expired).toBeGreaterThanOrEqual(1);
+    }));
+
+    it('should replace a busy pool without waiting for it', () => withPool({ threads: 1 }, async () => {
+        const busy = '[range(300000)] | length';
+        const queued = Array.from({ length: 4 }, (_, i) => jq.execAsync({ i }, busy));
+        await sleep(5);
+
+        const start = process.hrtime.bigint();
+        jq.setWorkerPool({ threads: 2 });
+        const ms = Number(process.hrtime.bigint() - start) / 1e6;
+        expect(await jq.execAsync({ a: 1 }, '.a')).toBe(1);
+        // The calls queued on the old pool still run there
+        expect(await Promise.all(queued)).toEqual(Array(4).fill(300000));
+        expect(ms).toBeLessThan(50);
+        expect(jq.getStats().workerPool.threads).toBe(2);
+    }));
+
+    it('should validate its options', async () => {
+        expect(() => jq.setWorkerPool({ threads: -1 })).toThrow('Invalid threads option');
+        expect(() => jq.setWorkerPool({ threads: 1, overflow: 'drop' })).toThrow('Invalid overflow option');
+        expect(() => jq.setWorkerPool({ threads: 1, affinity: [-1] })).toThrow('Invalid affinity option');
+        await expect(jq.execAsync({}, '.', { priority: 'urgent', throwOnError: true })).rejects.toThrow('Invalid priority option');
+        expect(jq.getStats().workerPool).toBeNull();
+    });
+});
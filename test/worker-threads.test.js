@@ -0,0 +1,71 @@
+const path = require('path');
+const { Worker } = require('worker_threads');
+const jq = require('../lib');
+
+// Runs code in a worker_thread with jq loaded, resolving to what it posts back
+const inWorker = (code, workerData) => new Promise((resolve, reject) => {
+    const worker = new Worker(`
+        const { parentPort, workerData } = require('worker_threads');
+        const jq = require(${JSON.stringify(path.resolve(__dirname, '../lib'))});
+        (async () => { ${code} })().then((value) => parentPort.postMessage(value), (err) => parentPort.postMessage({ error: err.message }));
+    `, { eval: true, workerData });
+    let result;
+    worker.on('message', (value) => { result = value; });
+    worker.on('error', reject);
+    worker.on('exit', () => resolve(result));
+});
+
+describe('jq - worker threads', () => {
+    it('should share compiled filters with workers', async () => {
+        const field = `f${Math.random().toString().slice(2, 10)}`;
+        const filter = `[.items[] | .${field}] | add`;
+        const input = { items: [{ [field]: 1 }, { [field]: 2 }] };
+        const before = jq.getCacheStats().misses;
+
+        const results = [];
+        for (let i = 0; i < 3; i++) {
+            results.push(await inWorker('return jq.exec(workerData.input, workerData.filter)', { input, filter }));
+        }
+        expect(results).toEqual([3, 3, 3]);
+        expect(jq.exec(input, filter)).toBe(3);
+        expect(jq.getCacheStats().misses - before).toBe(1);
+        expect(jq.getStats().filters.filter((item) => item.filter.endsWith(filter)).length).toBe(1);
+    });
+
+    it('should give every worker its own classes and pool', async () => {
+        const result = await inWorker(`
+            jq.setWorkerPool({ threads: 1 });
+            const cancel = new AbortController();
+            const values = [
+                await jq.execAsync({ a: 1 }, '.a + 1'),
+                jq.document({ a: [1, 2] }).exec('.a | length'),
+                [...jq.iterate({ a: [1, 2, 3] }, '.a[]')],
+                await jq.execAsync({ a: 2 }, '.a', { signal: cancel.signal }),
+                jq.getStats().workerPool.threads,
+            ];
+            // Exits with its pool still set
+            return values;
+        `);
+        expect(result).toEqual([2, 2, [1, 2, 3], 2, 1]);
+    });
+
+    it('should keep the pool of the main thread when a worker exits', async () => {
+        jq.setWorkerPool({ threads: 2 });
+        try {
+            await inWorker('jq.setWorkerPool({ threads: 3 }); return jq.execAsync({ a: 1 }, ".a")');
+            expect(jq.getStats().workerPool.threads).toBe(2);
+            expect(await jq.execAsync({ a: 5 }, '.a * 2')).toBe(10);
+            expect(await jq.document({ a: 1 }).execAsync('.a')).toBe(1);
+        } finally {
+            jq.setWorkerPool(null);
+        }
+    });
+
+    it('should run async calls of many workers at once', async () => {
+        const results = await Promise.all(Array.from({ length: 4 }, (_, i) => inWorker(`
+            const results = await Promise.all(Array.from({ length: 20 }, (_, j) => jq.execAsync({ i: workerData, j }, '.i * 100 + .j')));
+            return results.reduce((a, b) => a + b, 0);
+        `, i)));
+        expect(results).toEqual(Array.from({ length: 4 }, (_, i) => i * 2000 + 190));
+    });
+});